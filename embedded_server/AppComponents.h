@@ -9,14 +9,17 @@
 
 #include <oatpp/parser/json/mapping/ObjectMapper.hpp>
 
+#include <oatpp/core/async/Executor.hpp>
 #include <oatpp/network/tcp/server/ConnectionProvider.hpp>
+#include <oatpp/web/server/AsyncHttpConnectionHandler.hpp>
 #include <oatpp/web/server/HttpConnectionHandler.hpp>
 
 #include <oatpp/core/macro/component.hpp>
 
-#include "ListenerConfig.h"
+#include "include/sdb/ListenerConfig.h"
 #include "RequestErrorHandler.h"
 #include "SwaggerComponent.h"
+#include "WorkerPool.h"
 #include "websocket/WSListener.h"
 
 namespace sdb {
@@ -30,6 +33,9 @@ struct AppComponents {
       : swaggerComponent(std::make_shared<SwaggerComponent>(config))
       , serverConnectionProvider(oatpp::network::tcp::server::ConnectionProvider::createShared(
                 {config.hostName.c_str(), config.port, oatpp::network::Address::IP_4}))
+      , asyncExecutor(CreateAsyncExecutor(config))
+      , asyncWorkers(CreateAsyncWorkers(config))
+      , httpConnectionHandler(CreateHttpConnectionHandler(asyncExecutor))
       , webSocketInstanceListener(CreateWebSocketInstanceListener())
       , webSocketConnectionHandler(CreateWebSocketConnectionHandler(webSocketInstanceListener.getObject()))
 
@@ -44,6 +50,40 @@ struct AppComponents {
             "websocket" /* qualifier */, connectionHandler);
   }
 
+  // Null unless the connection mode is Async
+  static std::shared_ptr<oatpp::async::Executor> CreateAsyncExecutor(const ListenerConfig& config)
+  {
+    if (config.connectionMode != ListenerConfig::ConnectionMode::Async) {
+      return nullptr;
+    }
+    return std::make_shared<oatpp::async::Executor>(
+            config.asyncDataProcessingThreads, config.asyncIoThreads, config.asyncTimerThreads);
+  }
+
+  // Null unless the connection mode is Async
+  static std::shared_ptr<WorkerPool> CreateAsyncWorkers(const ListenerConfig& config)
+  {
+    if (config.connectionMode != ListenerConfig::ConnectionMode::Async) {
+      return nullptr;
+    }
+    return std::make_shared<WorkerPool>(config.asyncWorkerThreads, config.asyncMaxQueuedWorkerRequests);
+  }
+
+  static oatpp::base::Environment::Component<std::shared_ptr<oatpp::network::ConnectionHandler>>
+  CreateHttpConnectionHandler(const std::shared_ptr<oatpp::async::Executor>& executor)
+  {
+    OATPP_COMPONENT(std::shared_ptr<oatpp::web::server::HttpRouter>, router);
+    std::shared_ptr<oatpp::network::ConnectionHandler> connectionHandler;
+    if (executor != nullptr) {
+      connectionHandler = oatpp::web::server::AsyncHttpConnectionHandler::createShared(router, executor);
+    }
+    else {
+      connectionHandler = oatpp::web::server::HttpConnectionHandler::createShared(router);
+    }
+    return oatpp::base::Environment::Component<std::shared_ptr<oatpp::network::ConnectionHandler>>(
+            "http" /* qualifier */, connectionHandler);
+  }
+
   static std::shared_ptr<WSInstanceListener> CreateWebSocketInstanceListener()
   {
     return std::make_shared<WSInstanceListener>();
@@ -75,13 +115,19 @@ struct AppComponents {
   ([] { return oatpp::web::server::HttpRouter::createShared(); }());
 
   /*
-   *  Create http ConnectionHandler
+   *  Runs the http ConnectionHandler's coroutines, when the connection mode is Async
    */
-  OATPP_CREATE_COMPONENT(std::shared_ptr<oatpp::network::ConnectionHandler>, httpConnectionHandler)
-  ("http" /* qualifier */, [] {
-    OATPP_COMPONENT(std::shared_ptr<oatpp::web::server::HttpRouter>, router);// get Router component
-    return oatpp::web::server::HttpConnectionHandler::createShared(router);
-  }());
+  std::shared_ptr<oatpp::async::Executor> asyncExecutor;
+
+  /*
+   *  Runs the requests that walk the VM, when the connection mode is Async
+   */
+  std::shared_ptr<WorkerPool> asyncWorkers;
+
+  /*
+   *  Create http ConnectionHandler; either thread per connection, or async depending on the connection mode
+   */
+  oatpp::base::Environment::Component<std::shared_ptr<oatpp::network::ConnectionHandler>> httpConnectionHandler;
 
   /*
    * Create ObjectMapper component to serialize/deserialize DTOs in Controller's API
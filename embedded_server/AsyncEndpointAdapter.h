@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef SDB_ASYNC_ENDPOINT_ADAPTER_H
+#define SDB_ASYNC_ENDPOINT_ADAPTER_H
+
+#include <oatpp/core/async/Coroutine.hpp>
+#include <oatpp/core/data/stream/BufferStream.hpp>
+#include <oatpp/core/utils/ConversionUtils.hpp>
+#include <oatpp/web/server/HttpRequestHandler.hpp>
+#include <oatpp/web/server/HttpRouter.hpp>
+#include <oatpp/web/server/api/ApiController.hpp>
+
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+
+namespace sdb {
+
+// Serves an endpoint of a synchronous ApiController from an AsyncHttpConnectionHandler.
+// The request body is read by a coroutine, without holding a thread, and the endpoint is then called with a copy of the
+// request that reads the body from memory. Most endpoints only wait briefly (for the VM to reach a safe point), so run
+// on an executor data processing thread; this keeps the number of threads fixed without every endpoint needing a
+// coroutine of its own. Endpoints that may walk large parts of the VM are run on a WorkerPool instead, while the
+// coroutine waits for them, so that they can't hold up every other request. If the pool's queue is full they are
+// answered with 503 Service Unavailable.
+class AsyncEndpointAdapter : public oatpp::web::server::HttpRequestHandler {
+ public:
+  using Endpoint = oatpp::web::server::api::ApiController::Endpoint;
+  using IsWorkerEndpointFn = std::function<bool(const Endpoint::Info& info)>;
+
+  // workers may be null, to run the endpoint on the executor.
+  AsyncEndpointAdapter(std::shared_ptr<HttpRequestHandler> handler, std::shared_ptr<WorkerPool> workers)
+      : handler_(std::move(handler))
+      , workers_(std::move(workers))
+  {}
+
+  // Routes every endpoint of the controller through an adapter, in place of ApiController::addEndpointsToRouter.
+  // Those that isWorkerEndpoint returns true for are run on workers.
+  static void AddEndpointsToRouter(
+          const std::shared_ptr<oatpp::web::server::api::ApiController>& controller,
+          const std::shared_ptr<oatpp::web::server::HttpRouter>& router, const std::shared_ptr<WorkerPool>& workers,
+          const IsWorkerEndpointFn& isWorkerEndpoint)
+  {
+    controller->getEndpoints()->forEach(
+            [&router, &workers, &isWorkerEndpoint](const std::shared_ptr<Endpoint>& endpoint) {
+              const auto& info = endpoint->info();
+              router->route(
+                      info->method, info->path,
+                      std::make_shared<AsyncEndpointAdapter>(
+                              endpoint->handler, isWorkerEndpoint(*info) ? workers : nullptr));
+            });
+  }
+
+  std::shared_ptr<OutgoingResponse> handle(const std::shared_ptr<IncomingRequest>& request) override
+  {
+    return handler_->handle(request);
+  }
+
+  oatpp::async::CoroutineStarterForResult<const std::shared_ptr<OutgoingResponse>&>
+  handleAsync(const std::shared_ptr<IncomingRequest>& request) override
+  {
+    return HandleCoroutine::startForResult(handler_, workers_, request);
+  }
+
+ private:
+  class HandleCoroutine
+      : public oatpp::async::CoroutineWithResult<HandleCoroutine, const std::shared_ptr<OutgoingResponse>&> {
+   public:
+    HandleCoroutine(
+            std::shared_ptr<HttpRequestHandler> handler, std::shared_ptr<WorkerPool> workers,
+            std::shared_ptr<IncomingRequest> request)
+        : handler_(std::move(handler))
+        , workers_(std::move(workers))
+        , request_(std::move(request))
+    {}
+
+    Action act() override
+    {
+      return request_->readBodyToStringAsync().callbackTo(&HandleCoroutine::onBodyRead);
+    }
+
+    Action onBodyRead(const oatpp::String& body)
+    {
+      const auto bodyData = body != nullptr ? body : oatpp::String("");
+
+      // The body has already been decoded, so describe it to the endpoint as exactly that many plain bytes.
+      auto headers = request_->getHeaders();
+      headers.putOrReplace(Header::CONTENT_LENGTH, oatpp::utils::conversion::int64ToStr(bodyData->getSize()));
+      if (request_->getHeader(Header::TRANSFER_ENCODING) != nullptr) {
+        headers.putOrReplace(Header::TRANSFER_ENCODING, "identity");
+      }
+
+      const auto bufferedRequest = IncomingRequest::createShared(
+              request_->getConnection(), request_->getStartingLine(), headers,
+              std::make_shared<oatpp::data::stream::BufferInputStream>(bodyData), request_->getBodyDecoder());
+      bufferedRequest->setPathVariables(request_->getPathVariables());
+      if (workers_ == nullptr) {
+        return _return(handler_->handle(bufferedRequest));
+      }
+
+      pending_ = std::make_shared<PendingResponse>();
+      const bool isSubmitted = workers_->TrySubmit([handler = handler_, bufferedRequest, pending = pending_]() {
+        try {
+          pending->response = handler->handle(bufferedRequest);
+        }
+        catch (...) {
+          pending->exception = std::current_exception();
+        }
+        pending->isDone.store(true, std::memory_order_release);
+      });
+      if (!isSubmitted) {
+        return _return(OutgoingResponse::createShared(oatpp::web::protocol::http::Status::CODE_503, nullptr));
+      }
+      return yieldTo(&HandleCoroutine::onWorkerPoll);
+    }
+
+    // Polled on a timer, rather than being woken by the worker, as these endpoints take a while anyway.
+    Action onWorkerPoll()
+    {
+      if (!pending_->isDone.load(std::memory_order_acquire)) {
+        return waitRepeat(kWorkerPollInterval);
+      }
+      if (pending_->exception != nullptr) {
+        // As if the endpoint had thrown here, so that it's handled the same way as those run on the executor
+        std::rethrow_exception(pending_->exception);
+      }
+      return _return(pending_->response);
+    }
+
+   private:
+    using Header = oatpp::web::protocol::http::Header;
+
+    // Written by the worker before it sets isDone.
+    struct PendingResponse {
+      std::shared_ptr<OutgoingResponse> response;
+      std::exception_ptr exception;
+      std::atomic<bool> isDone{false};
+    };
+
+    static constexpr std::chrono::milliseconds kWorkerPollInterval{1};
+
+    std::shared_ptr<HttpRequestHandler> handler_;
+    std::shared_ptr<WorkerPool> workers_;
+    std::shared_ptr<IncomingRequest> request_;
+    std::shared_ptr<PendingResponse> pending_;
+  };
+
+  std::shared_ptr<HttpRequestHandler> handler_;
+  std::shared_ptr<WorkerPool> workers_;
+};
+
+}// namespace sdb
+
+#endif// SDB_ASYNC_ENDPOINT_ADAPTER_H
@@ -0,0 +1,117 @@
+#pragma once
+
+#ifndef SDB_BOUNDED_QUEUE_H
+#define SDB_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sdb {
+
+// Fixed capacity, lock-free multi-producer multi-consumer queue (after Dmitry Vyukov's bounded MPMC queue).
+// Each cell carries a sequence number that tells producers and consumers whether it is free or full for the lap of the
+// ring they are on, so a push or pop is a single compare-exchange on the shared position plus one store, and never
+// blocks. Capacity is rounded up to a power of two.
+template<typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(const size_t capacity)
+  {
+    size_t roundedCapacity = 2;
+    while (roundedCapacity < capacity) {
+      roundedCapacity *= 2;
+    }
+    mask_ = roundedCapacity - 1;
+    cells_ = std::make_unique<Cell[]>(roundedCapacity);
+    for (size_t i = 0; i < roundedCapacity; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Deleted methods
+  BoundedQueue(const BoundedQueue& other) = delete;
+  BoundedQueue(const BoundedQueue&& other) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(BoundedQueue&&) = delete;
+
+  // Returns false, leaving value untouched, if the queue is full.
+  [[nodiscard]] bool TryPush(T&& value)
+  {
+    Cell* cell = nullptr;
+    auto pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      const auto sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty.
+  [[nodiscard]] bool TryPop(T& value)
+  {
+    Cell* cell = nullptr;
+    auto pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      const auto sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    value = std::move(cell->value);
+    // Leave the moved-from value in the cell; it is overwritten by the next push to it.
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only a hint while other threads are pushing or popping.
+  [[nodiscard]] bool IsEmpty() const
+  {
+    return enqueuePos_.load(std::memory_order_acquire) == dequeuePos_.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    T value;
+  };
+
+  static constexpr size_t kCacheLineSize = 64;
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_ = 0;
+  // Kept on separate cache lines so that producers and consumers don't contend
+  alignas(kCacheLineSize) std::atomic<size_t> enqueuePos_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> dequeuePos_{0};
+};
+
+}// namespace sdb
+
+#endif// SDB_BOUNDED_QUEUE_H
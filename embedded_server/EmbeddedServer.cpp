@@ -2,7 +2,12 @@
 // Created by Lewis weaver on 5/30/2021.
 //
 
+#include "AsyncEndpointAdapter.h"
+#include "BoundedQueue.h"
 #include "ForwardingLogger.h"
+#include "MsgPackEventEncoder.h"
+#include "OutputChannel.h"
+#include "OutputHistory.h"
 #include "include/sdb/EmbeddedServer.h"
 #include "dto/EventDto.h"
 
@@ -18,11 +23,20 @@
 #include <oatpp-swagger/Controller.hpp>
 #endif
 
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 #include "controller/DebugCommandController.h"
 #include "controller/StaticController.h"
 #include "controller/WebsocketController.h"
+#include "websocket/WSCommandHandler.h"
 #include "websocket/WSListener.h"
 
 #include "AppComponents.h"
@@ -33,55 +47,292 @@ using oatpp::data::mapping::type::String;
 
 namespace sdb {
 
+// Events are passed from the VM thread to a dedicated sender thread through a lock-free queue, so that serialization
+// and (blocking) websocket sends never stall script execution, however slow the clients are. Output lines go through
+// the OutputChannel instead, and are sent in output_lines batches (or as an output_line event per line, to clients
+// that didn't ask for batches). Each event is only encoded in the formats that connected clients asked for.
 class OatMessageEventInterface : public MessageEventInterface {
  public:
-  explicit OatMessageEventInterface(std::shared_ptr<WSInstanceListener> webSocketInstanceListener)
-      : webSocketInstanceListener_(std::move(webSocketInstanceListener)) {}
+  OatMessageEventInterface(
+          std::shared_ptr<WSInstanceListener> webSocketInstanceListener, std::shared_ptr<OutputChannel> outputChannel,
+          std::shared_ptr<OutputHistory> outputHistory)
+      : webSocketInstanceListener_(std::move(webSocketInstanceListener))
+      , outputChannel_(std::move(outputChannel))
+      , outputHistory_(std::move(outputHistory))
+      , queue_(kQueueCapacity)
+      , senderThread_([this]() { RunSender(); })
+  {}
+
+  ~OatMessageEventInterface() override
+  {
+    {
+      std::lock_guard lock(wakeMutex_);
+      stopping_ = true;
+      wakeCv_.notify_one();
+      spaceCv_.notify_all();
+    }
+    senderThread_.join();
+  }
+
+  // Deleted methods
+  OatMessageEventInterface(const OatMessageEventInterface& other) = delete;
+  OatMessageEventInterface(const OatMessageEventInterface&& other) = delete;
+  OatMessageEventInterface& operator=(const OatMessageEventInterface&) = delete;
+  OatMessageEventInterface& operator=(OatMessageEventInterface&&) = delete;
+
+  void HandleStatusChanged(const data::Status& status) override
+  {
+    Enqueue(QueuedEvent(status));
+  }
+
+  void HandleOutputLine(const data::OutputLine& outputLine) override
+  {
+    if (outputChannel_->Push(outputLine)) {
+      WakeSender();
+    }
+  }
+
+  void HandlePauseBundle(const data::PauseBundle& pauseBundle) override
+  {
+    Enqueue(QueuedEvent(pauseBundle));
+  }
+
+ private:
+  using QueuedEvent = std::variant<std::monostate, data::Status, data::PauseBundle>;
+
+  static constexpr size_t kQueueCapacity = 4096;
+  // Maximum number of events serialized before they are sent, so that a burst of events doesn't delay everything.
+  static constexpr size_t kMaxBatchSize = 256;
+  // The sender checks what there is to do with wakeMutex_ held, and producers take it to notify, so that a notification
+  // can't fall between the check and the wait.
+  void WakeSender()
+  {
+    std::lock_guard lock(wakeMutex_);
+    wakeCv_.notify_one();
+  }
+
+  // State changes are never dropped, so the producer blocks until there is space if the queue is full; that only
+  // happens if kQueueCapacity events are already waiting to be sent.
+  void Enqueue(QueuedEvent&& event)
+  {
+    if (!queue_.TryPush(std::move(event))) {
+      std::unique_lock lock(wakeMutex_);
+      spaceCv_.wait(lock, [this, &event]() { return stopping_ || queue_.TryPush(std::move(event)); });
+    }
+    WakeSender();
+  }
+
+  void RunSender()
+  {
+    QueuedEvent event;
+    for (;;) {
+      {
+        // Sleeps until there is an event, or until pending output is due to be sent.
+        std::unique_lock lock(wakeMutex_);
+        while (!stopping_ && queue_.IsEmpty() && !outputChannel_->IsFlushDue(std::chrono::steady_clock::now())) {
+          const auto flushDeadline = outputChannel_->GetFlushDeadline();
+          if (flushDeadline.has_value()) {
+            wakeCv_.wait_until(lock, *flushDeadline);
+          }
+          else {
+            wakeCv_.wait(lock);
+          }
+        }
+        if (stopping_) {
+          return;
+        }
+      }
+
+      isJsonUsed_ = webSocketInstanceListener_->hasConnections(EventEncoding::Json);
+      isJsonLineOutputUsed_ = webSocketInstanceListener_->hasConnections(EventEncoding::Json, OutputFormat::Line);
+      isJsonBatchedOutputUsed_ =
+              webSocketInstanceListener_->hasConnections(EventEncoding::Json, OutputFormat::Batched);
+      isMsgPackUsed_ = webSocketInstanceListener_->hasConnections(EventEncoding::MsgPack);
+      size_t eventCount = 0;
+      for (; eventCount < kMaxBatchSize && queue_.TryPop(event); ++eventCount) {
+        // Output written before the state changed is sent first, so that clients see it in the order it happened.
+        AppendOutputLines();
+        std::visit([this](const auto& queued) { AppendEvent(queued); }, event);
+      }
+      if (eventCount == kMaxBatchSize) {
+        // The VM thread only waits for space when the queue is full, in which case a full batch has just been taken.
+        std::lock_guard lock(wakeMutex_);
+        spaceCv_.notify_one();
+      }
+      if (outputChannel_->IsFlushDue(std::chrono::steady_clock::now())) {
+        AppendOutputLines();
+      }
+
+      if (!jsonMessages_.empty()) {
+        webSocketInstanceListener_->broadcastMessages(EventEncoding::Json, jsonMessages_);
+        jsonMessages_.clear();
+      }
+      if (!msgPackMessages_.empty()) {
+        webSocketInstanceListener_->broadcastMessages(EventEncoding::MsgPack, msgPackMessages_);
+        msgPackMessages_.clear();
+      }
+    }
+  }
+
+  template<typename TEvent>
+  void AppendEvent(const TEvent& event)
+  {
+    if constexpr (!std::is_same_v<TEvent, std::monostate>) {
+      if (isJsonUsed_) {
+        jsonMessages_.push_back({Serialize(event)});
+      }
+      if (isMsgPackUsed_) {
+        msgPackMessages_.push_back({msgPackEncoder_.Encode(event)});
+      }
+    }
+  }
+
+  // Statuses carry a copy of the status with them, so that each connection can send a status_delta instead.
+  void AppendEvent(const data::Status& status)
+  {
+    const auto sequence = ++statusSequence_;
+    const auto sharedStatus = std::make_shared<const data::Status>(status);
+    if (isJsonUsed_) {
+      jsonMessages_.push_back({Serialize(status, sequence), sharedStatus, sequence});
+    }
+    if (isMsgPackUsed_) {
+      msgPackMessages_.push_back({msgPackEncoder_.Encode(status, sequence), sharedStatus, sequence});
+    }
+  }
 
-  void HandleStatusChanged(const data::Status& status) override {
+  [[nodiscard]] oatpp::String Serialize(const data::Status& status, const uint64_t sequence) const
+  {
     const auto statusDto = dto::Status::createShared();
+    statusDto->sequence = sequence;
     statusDto->runstate = static_cast<sdb::dto::RunState>(status.runState);
     statusDto->stack = oatpp::List<oatpp::Object<dto::StackEntry>>::createShared();
     for (const auto& stackEntry : status.stack) {
-      const auto stackEntryDto = dto::StackEntry::createShared();
-      stackEntryDto->file = stackEntry.file.c_str();
-      stackEntryDto->line = stackEntry.line;
-      stackEntryDto->function = stackEntry.function.c_str();
-      statusDto->stack->push_back(stackEntryDto);
+      statusDto->stack->push_back(DebugCommandController::CreateStackEntry(stackEntry));
     }
+    statusDto->stackDepth = status.stackDepth;
     statusDto->pausedAtBreakpointId = status.pausedAtBreakpointId;
+    statusDto->pausedAtDataBreakpointId = status.pausedAtDataBreakpointId;
+    statusDto->watches = oatpp::List<oatpp::Object<dto::WatchResult>>::createShared();
+    for (const auto& watchResult : status.watches) {
+      statusDto->watches->push_back(DebugCommandController::CreateWatchResult(watchResult));
+    }
 
     const auto wrapper = dto::EventMessageWrapper<dto::Status>::createShared();
     wrapper->type = dto::EventMessageType::Status;
     wrapper->message = statusDto;
+    return mapper_->writeToString(wrapper);
+  }
 
-    webSocketInstanceListener_->broadcastMessage(mapper_->writeToString(wrapper));
+  // Drains the OutputChannel into the history, and a single output_lines message (plus an output_line message per line,
+  // if any clients want them), if there is anything to send.
+  void AppendOutputLines()
+  {
+    const auto droppedLineCount = outputChannel_->Drain(outputLines_);
+    if (outputLines_.empty() && droppedLineCount == 0) {
+      return;
+    }
+    if (droppedLineCount > 0) {
+      OATPP_LOGD(kTag, "Output was written faster than it could be sent, dropped %u lines", droppedLineCount)
+    }
+
+    const auto firstSequence = outputHistory_->Append(outputLines_);
+    if (isJsonBatchedOutputUsed_) {
+      jsonMessages_.push_back(
+              {SerializeOutputLines(firstSequence, droppedLineCount), nullptr, 0U, OutputFormat::Batched});
+    }
+    if (isJsonLineOutputUsed_) {
+      for (const auto& outputLine : outputLines_) {
+        jsonMessages_.push_back({Serialize(outputLine), nullptr, 0U, OutputFormat::Line});
+      }
+    }
+    if (isMsgPackUsed_) {
+      msgPackMessages_.push_back(
+              {msgPackEncoder_.EncodeOutputLines(outputLines_, firstSequence, droppedLineCount), nullptr, 0U,
+               OutputFormat::Batched});
+    }
   }
 
-  void HandleOutputLine(const data::OutputLine& outputLine) override
+  [[nodiscard]] static oatpp::Object<dto::OutputLine> CreateOutputLine(const OutputChannel::Line& outputLine)
   {
     const auto outputLineDto = dto::OutputLine::createShared();
     outputLineDto->output = String(outputLine.output.data(), static_cast<v_buff_size>(outputLine.output.size()), false);
     outputLineDto->isErr = outputLine.isErr;
-    outputLineDto->file = String(outputLine.fileName.data(), static_cast<v_buff_size>(outputLine.fileName.size()), false);
+    outputLineDto->file =
+            String(outputLine.fileName.data(), static_cast<v_buff_size>(outputLine.fileName.size()), false);
     outputLineDto->line = outputLine.line;
-    
+    return outputLineDto;
+  }
+
+  [[nodiscard]] oatpp::String Serialize(const OutputChannel::Line& outputLine) const
+  {
     const auto wrapper = dto::EventMessageWrapper<dto::OutputLine>::createShared();
     wrapper->type = dto::EventMessageType::OutputLine;
-    wrapper->message = outputLineDto;
+    wrapper->message = CreateOutputLine(outputLine);
+    return mapper_->writeToString(wrapper);
+  }
+
+  [[nodiscard]] oatpp::String SerializeOutputLines(const uint64_t firstSequence, const uint32_t droppedLineCount) const
+  {
+    const auto batchDto = dto::OutputLineBatch::createShared();
+    batchDto->firstSequence = firstSequence;
+    batchDto->lines = oatpp::List<oatpp::Object<dto::OutputLine>>::createShared();
+    for (const auto& outputLine : outputLines_) {
+      batchDto->lines->push_back(CreateOutputLine(outputLine));
+    }
+    batchDto->droppedLineCount = droppedLineCount;
 
-    webSocketInstanceListener_->broadcastMessage(mapper_->writeToString(wrapper));
+    const auto wrapper = dto::EventMessageWrapper<dto::OutputLineBatch>::createShared();
+    wrapper->type = dto::EventMessageType::OutputLines;
+    wrapper->message = batchDto;
+    return mapper_->writeToString(wrapper);
   }
 
- private:
+  [[nodiscard]] oatpp::String Serialize(const data::PauseBundle& pauseBundle) const
+  {
+    const auto pauseBundleDto = dto::PauseBundle::createShared();
+    pauseBundleDto->locals = DebugCommandController::CreateVariablesList(pauseBundle.locals);
+    pauseBundleDto->globals = DebugCommandController::CreateVariablesList(pauseBundle.globals);
+
+    const auto wrapper = dto::EventMessageWrapper<dto::PauseBundle>::createShared();
+    wrapper->type = dto::EventMessageType::PauseBundle;
+    wrapper->message = pauseBundleDto;
+    return mapper_->writeToString(wrapper);
+  }
+
+  static constexpr const char* kTag = "OatMessageEventInterface";
+
   std::shared_ptr<ObjectMapper> mapper_ = ObjectMapper::createShared();
   std::shared_ptr<WSInstanceListener> webSocketInstanceListener_;
+
+  std::shared_ptr<OutputChannel> outputChannel_;
+  std::shared_ptr<OutputHistory> outputHistory_;
+  // Only used by the sender thread; kept between batches so that the strings are reused.
+  std::vector<OutputChannel::Line> outputLines_;
+  MsgPackEventEncoder msgPackEncoder_;
+  bool isJsonUsed_ = false;
+  bool isJsonLineOutputUsed_ = false;
+  bool isJsonBatchedOutputUsed_ = false;
+  bool isMsgPackUsed_ = false;
+  uint64_t statusSequence_ = 0;
+  std::vector<WSEvent> jsonMessages_;
+  std::vector<WSEvent> msgPackMessages_;
+
+  BoundedQueue<QueuedEvent> queue_;
+  // Guards stopping_, and orders notifications of wakeCv_ and spaceCv_ against their waits.
+  std::mutex wakeMutex_;
+  std::condition_variable wakeCv_;
+  // Notified when the sender makes room in a queue that may have been full.
+  std::condition_variable spaceCv_;
+  bool stopping_ = false;
+  // Declared last, so that everything it uses is constructed before it starts
+  std::thread senderThread_;
 };
 
 class EndpointImpl : public EmbeddedServer {
 
  public:
   explicit EndpointImpl(const ListenerConfig& config)
+      : config_(config)
   {
     appComponents_ = std::make_shared<AppComponents>(config);
   }
@@ -94,18 +345,21 @@ class EndpointImpl : public EmbeddedServer {
 
     // Controllers
 
-    auto debugCommandController = DebugCommandController::CreateShared(messageCommandInterface);
-    debugCommandController->addEndpointsToRouter(router);
+    auto outputChannel = std::make_shared<OutputChannel>();
+    auto outputHistory = std::make_shared<OutputHistory>();
+    auto debugCommandController = DebugCommandController::CreateShared(
+            messageCommandInterface, outputChannel, outputHistory, config_);
+    AddEndpointsToRouter(debugCommandController, router);
     debugCommandController->setErrorHandler(errorHandler);
     controllers_.push_back(debugCommandController);
 
     auto staticController = StaticController::CreateShared();
-    staticController->addEndpointsToRouter(router);
+    AddEndpointsToRouter(staticController, router);
     staticController->setErrorHandler(errorHandler);
     controllers_.push_back(staticController);
 
     auto websocketController = WebsocketController::CreateShared();
-    websocketController->addEndpointsToRouter(router);
+    AddEndpointsToRouter(websocketController, router);
     websocketController->setErrorHandler(errorHandler);
     controllers_.push_back(websocketController);
 
@@ -116,11 +370,13 @@ class EndpointImpl : public EmbeddedServer {
     docEndpoints->pushBackAll(staticController->getEndpoints());
     docEndpoints->pushBackAll(websocketController->getEndpoints());
     swaggerController_ = oatpp::swagger::Controller::createShared(docEndpoints);
-    swaggerController_->addEndpointsToRouter(router);
+    AddEndpointsToRouter(swaggerController_, router);
 #endif
 
     OATPP_COMPONENT(std::shared_ptr<WSInstanceListener>, webSocketInstanceListener);
-    eventInterface_ = std::make_shared<OatMessageEventInterface>(webSocketInstanceListener);
+    webSocketInstanceListener->setCommandHandler(std::make_shared<WSCommandHandler>(messageCommandInterface));
+    eventInterface_ =
+            std::make_shared<OatMessageEventInterface>(webSocketInstanceListener, outputChannel, outputHistory);
   }
 
   [[nodiscard]] std::shared_ptr<MessageEventInterface> GetEventInterface() const override {
@@ -151,12 +407,36 @@ class EndpointImpl : public EmbeddedServer {
     *stopping_ = true;
     if (join) {
       worker_.join();
+      if (appComponents_->asyncExecutor != nullptr) {
+        appComponents_->asyncExecutor->stop();
+        appComponents_->asyncExecutor->join();
+      }
     }
   }
 
 private:
+  // Endpoints that may walk large parts of the VM, which are run on the async workers.
+  static bool IsWorkerEndpoint(const AsyncEndpointAdapter::Endpoint::Info& info)
+  {
+    return std::string_view(info.path->c_str()).find("Variables/") != std::string_view::npos;
+  }
+
+  // The endpoints of the (synchronous) controllers are adapted to be served by coroutines in Async mode.
+  void AddEndpointsToRouter(
+          const std::shared_ptr<oatpp::web::server::api::ApiController>& controller,
+          const std::shared_ptr<oatpp::web::server::HttpRouter>& router) const
+  {
+    if (appComponents_->asyncExecutor != nullptr) {
+      AsyncEndpointAdapter::AddEndpointsToRouter(controller, router, appComponents_->asyncWorkers, IsWorkerEndpoint);
+    }
+    else {
+      controller->addEndpointsToRouter(router);
+    }
+  }
+
   std::shared_ptr<OatMessageEventInterface> eventInterface_;
   std::shared_ptr<AppComponents> appComponents_;
+  ListenerConfig config_;
 
   // Need to keep a reference to the controllers so they aren't deleted.
   std::vector<std::shared_ptr<oatpp::web::server::api::ApiController>> controllers_;
@@ -177,6 +457,11 @@ EmbeddedServer* EmbeddedServer::Create(const uint16_t port)
   return new EndpointImpl(config);
 }
 
+EmbeddedServer* EmbeddedServer::Create(const ListenerConfig& config)
+{
+  return new EndpointImpl(config);
+}
+
 void EmbeddedServer::InitEnvironment() {
   oatpp::base::Environment::init();
   oatpp::base::Environment::setLogger(std::make_shared<ForwardingLogger>());
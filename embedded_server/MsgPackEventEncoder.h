@@ -0,0 +1,275 @@
+#pragma once
+
+#ifndef SDB_MSG_PACK_EVENT_ENCODER_H
+#define SDB_MSG_PACK_EVENT_ENCODER_H
+
+#include "MsgPackWriter.h"
+#include "OutputChannel.h"
+#include "StatusDeltaTracker.h"
+#include "dto/EventDto.h"
+
+#include <sdb/MessageInterface.h>
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace sdb {
+
+// Encodes events as MessagePack, for websocket connections that ask for it. The structure, field names and enum names
+// are the same as the JSON that the DTOs in EventDto.h are written as, so clients can decode either the same way, but
+// the events are written straight from the data types without building DTOs.
+// Each thread that encodes events needs its own encoder, as the writer's buffer is reused between events.
+class MsgPackEventEncoder {
+ public:
+  [[nodiscard]] oatpp::String Encode(const data::Status& status, const uint64_t sequence)
+  {
+    BeginEvent(dto::EventMessageType::Status);
+    writer_.WriteMapHeader(7);
+    WriteKey("sequence");
+    writer_.WriteUInt(sequence);
+    WriteKey("runstate");
+    WriteEnum(static_cast<dto::RunState>(status.runState));
+    WriteKey("stack");
+    writer_.WriteArrayHeader(static_cast<uint32_t>(status.stack.size()));
+    for (const auto& stackEntry : status.stack) {
+      writer_.WriteMapHeader(3);
+      WriteKey("file");
+      writer_.WriteString(stackEntry.file);
+      WriteKey("line");
+      writer_.WriteUInt(stackEntry.line);
+      WriteKey("function");
+      writer_.WriteString(stackEntry.function);
+    }
+    WriteKey("stackDepth");
+    writer_.WriteUInt(status.stackDepth);
+    WriteStatusFooter(status);
+    return EndEvent();
+  }
+
+  // The stack is taken from delta; everything else from status.
+  [[nodiscard]] oatpp::String EncodeStatusDelta(const StatusDelta& delta, const data::Status& status)
+  {
+    BeginEvent(dto::EventMessageType::StatusDelta);
+    writer_.WriteMapHeader(11);
+    WriteKey("sequence");
+    writer_.WriteUInt(delta.sequence);
+    WriteKey("baseSequence");
+    writer_.WriteUInt(delta.baseSequence);
+    WriteKey("runstate");
+    WriteEnum(static_cast<dto::RunState>(status.runState));
+    WriteKey("names");
+    writer_.WriteArrayHeader(static_cast<uint32_t>(delta.names.size()));
+    for (const auto& [id, name] : delta.names) {
+      writer_.WriteMapHeader(2);
+      WriteKey("id");
+      writer_.WriteUInt(id);
+      WriteKey("name");
+      writer_.WriteString(name);
+    }
+    WriteKey("unchangedFrameCount");
+    writer_.WriteUInt(delta.unchangedFrameCount);
+    WriteKey("frames");
+    WriteStackEntryRefs(delta.frames);
+    WriteKey("bottomFrames");
+    WriteStackEntryRefs(delta.bottomFrames);
+    WriteKey("stackDepth");
+    writer_.WriteUInt(status.stackDepth);
+    WriteStatusFooter(status);
+    return EndEvent();
+  }
+
+  [[nodiscard]] oatpp::String Encode(const data::PauseBundle& pauseBundle)
+  {
+    BeginEvent(dto::EventMessageType::PauseBundle);
+    writer_.WriteMapHeader(2);
+    WriteKey("locals");
+    WriteVariables(pauseBundle.locals);
+    WriteKey("globals");
+    WriteVariables(pauseBundle.globals);
+    return EndEvent();
+  }
+
+  [[nodiscard]] oatpp::String EncodeOutputLines(
+          const std::vector<OutputChannel::Line>& lines, const uint64_t firstSequence, const uint32_t droppedLineCount)
+  {
+    BeginEvent(dto::EventMessageType::OutputLines);
+    writer_.WriteMapHeader(3);
+    WriteKey("lines");
+    writer_.WriteArrayHeader(static_cast<uint32_t>(lines.size()));
+    for (const auto& line : lines) {
+      writer_.WriteMapHeader(4);
+      WriteKey("output");
+      writer_.WriteString(line.output);
+      WriteKey("isErr");
+      writer_.WriteBool(line.isErr);
+      WriteKey("file");
+      writer_.WriteString(line.fileName);
+      WriteKey("line");
+      writer_.WriteUInt(line.line);
+    }
+    WriteKey("firstSequence");
+    writer_.WriteUInt(firstSequence);
+    WriteKey("droppedLineCount");
+    writer_.WriteUInt(droppedLineCount);
+    return EndEvent();
+  }
+
+  // variables is null for commands that don't list variables, and nextCursor is written as nil when empty.
+  [[nodiscard]] oatpp::String EncodeCommandResult(
+          const std::optional<uint64_t>& id, const data::ReturnCode code, const std::vector<data::Variable>* variables,
+          const std::string_view nextCursor)
+  {
+    BeginEvent(dto::EventMessageType::CommandResponse);
+    writer_.WriteMapHeader(4);
+    WriteKey("code");
+    writer_.WriteInt(static_cast<int32_t>(code));
+    WriteKey("id");
+    if (id.has_value()) {
+      writer_.WriteUInt(*id);
+    }
+    else {
+      writer_.WriteNil();
+    }
+    WriteKey("variables");
+    if (variables != nullptr) {
+      WriteVariables(*variables);
+    }
+    else {
+      writer_.WriteNil();
+    }
+    WriteKey("nextCursor");
+    if (!nextCursor.empty()) {
+      writer_.WriteString(nextCursor);
+    }
+    else {
+      writer_.WriteNil();
+    }
+    return EndEvent();
+  }
+
+ private:
+  template<typename TEnum>
+  void WriteEnum(const TEnum value)
+  {
+    const auto& name = oatpp::Enum<TEnum>::getEntryByValue(value).name;
+    writer_.WriteString(
+            std::string_view(reinterpret_cast<const char*>(name.getData()), static_cast<size_t>(name.getSize())));
+  }
+
+  void WriteKey(const std::string_view key)
+  {
+    writer_.WriteString(key);
+  }
+
+  // Writes the start of an EventMessageWrapper; the message should be written next.
+  void BeginEvent(const dto::EventMessageType type)
+  {
+    writer_.Clear();
+    writer_.WriteMapHeader(2);
+    WriteKey("type");
+    WriteEnum(type);
+    WriteKey("message");
+  }
+
+  [[nodiscard]] oatpp::String EndEvent() const
+  {
+    const auto& buffer = writer_.GetBuffer();
+    return oatpp::String(buffer.data(), static_cast<v_buff_size>(buffer.size()), true);
+  }
+
+  // The fields that follow the stack in both status and status_delta events.
+  void WriteStatusFooter(const data::Status& status)
+  {
+    WriteKey("pausedAtBreakpointId");
+    writer_.WriteUInt(status.pausedAtBreakpointId);
+    WriteKey("pausedAtDataBreakpointId");
+    writer_.WriteUInt(status.pausedAtDataBreakpointId);
+    WriteKey("watches");
+    writer_.WriteArrayHeader(static_cast<uint32_t>(status.watches.size()));
+    for (const auto& watchResult : status.watches) {
+      WriteWatchResult(watchResult);
+    }
+  }
+
+  void WriteStackEntryRefs(const std::vector<StatusDelta::Frame>& frames)
+  {
+    writer_.WriteArrayHeader(static_cast<uint32_t>(frames.size()));
+    for (const auto& frame : frames) {
+      writer_.WriteMapHeader(3);
+      WriteKey("fileId");
+      writer_.WriteUInt(frame.fileId);
+      WriteKey("line");
+      writer_.WriteUInt(frame.line);
+      WriteKey("functionId");
+      writer_.WriteUInt(frame.functionId);
+    }
+  }
+
+  void WriteWatchResult(const data::WatchResult& watchResult)
+  {
+    writer_.WriteMapHeader(4);
+    WriteKey("id");
+    writer_.WriteUInt(watchResult.id);
+    WriteKey("watch");
+    writer_.WriteString(watchResult.watch);
+    WriteKey("code");
+    writer_.WriteInt(static_cast<int32_t>(watchResult.code));
+    WriteKey("value");
+    if (watchResult.code != data::ReturnCode::Success) {
+      writer_.WriteNil();
+      return;
+    }
+
+    const auto& value = watchResult.value;
+    writer_.WriteMapHeader(3);
+    WriteKey("variable");
+    WriteVariable(value.variable);
+    WriteKey("variableScope");
+    WriteEnum(static_cast<dto::VariableScope>(value.scope));
+    WriteKey("iteratorPath");
+    writer_.WriteArrayHeader(static_cast<uint32_t>(value.iteratorPath.size()));
+    for (const auto iterator : value.iteratorPath) {
+      writer_.WriteUInt(iterator);
+    }
+  }
+
+  void WriteVariables(const std::vector<data::Variable>& variables)
+  {
+    writer_.WriteArrayHeader(static_cast<uint32_t>(variables.size()));
+    for (const auto& variable : variables) {
+      WriteVariable(variable);
+    }
+  }
+
+  void WriteVariable(const data::Variable& variable)
+  {
+    writer_.WriteMapHeader(10);
+    WriteKey("pathIterator");
+    writer_.WriteUInt(variable.pathIterator);
+    WriteKey("pathUiString");
+    writer_.WriteString(variable.pathUiString);
+    WriteKey("pathTableKeyType");
+    WriteEnum(static_cast<dto::VariableType>(variable.pathTableKeyType));
+    WriteKey("valueType");
+    WriteEnum(static_cast<dto::VariableType>(variable.valueType));
+    WriteKey("value");
+    writer_.WriteString(variable.value);
+    WriteKey("valueRawAddress");
+    writer_.WriteUInt(variable.valueRawAddress);
+    WriteKey("childCount");
+    writer_.WriteUInt(variable.childCount);
+    WriteKey("instanceClassName");
+    writer_.WriteString(variable.instanceClassName);
+    WriteKey("editable");
+    writer_.WriteBool(variable.editable);
+    WriteKey("parentIndex");
+    writer_.WriteInt(variable.parentIndex);
+  }
+
+  MsgPackWriter writer_;
+};
+
+}// namespace sdb
+
+#endif// SDB_MSG_PACK_EVENT_ENCODER_H
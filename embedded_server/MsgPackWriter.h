@@ -0,0 +1,134 @@
+#pragma once
+
+#ifndef SDB_MSG_PACK_WRITER_H
+#define SDB_MSG_PACK_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sdb {
+
+// Appends MessagePack (https://github.com/msgpack/msgpack/blob/master/spec.md) encoded values to a buffer, using the
+// smallest encoding of each. Maps and arrays are written as a header giving their size, followed by their elements
+// (for maps, alternating keys and values).
+class MsgPackWriter {
+ public:
+  void WriteNil()
+  {
+    buffer_.push_back(static_cast<char>(0xC0U));
+  }
+
+  void WriteBool(const bool value)
+  {
+    buffer_.push_back(static_cast<char>(value ? 0xC3U : 0xC2U));
+  }
+
+  void WriteUInt(const uint64_t value)
+  {
+    if (value < 0x80U) {
+      buffer_.push_back(static_cast<char>(value));
+    }
+    else if (value <= UINT8_MAX) {
+      WriteHeader(0xCCU, value, 1);
+    }
+    else if (value <= UINT16_MAX) {
+      WriteHeader(0xCDU, value, 2);
+    }
+    else if (value <= UINT32_MAX) {
+      WriteHeader(0xCEU, value, 4);
+    }
+    else {
+      WriteHeader(0xCFU, value, 8);
+    }
+  }
+
+  void WriteInt(const int64_t value)
+  {
+    if (value >= 0) {
+      WriteUInt(static_cast<uint64_t>(value));
+    }
+    else if (value >= -32) {
+      buffer_.push_back(static_cast<char>(value));
+    }
+    else if (value >= INT8_MIN) {
+      WriteHeader(0xD0U, static_cast<uint64_t>(value), 1);
+    }
+    else if (value >= INT16_MIN) {
+      WriteHeader(0xD1U, static_cast<uint64_t>(value), 2);
+    }
+    else if (value >= INT32_MIN) {
+      WriteHeader(0xD2U, static_cast<uint64_t>(value), 4);
+    }
+    else {
+      WriteHeader(0xD3U, static_cast<uint64_t>(value), 8);
+    }
+  }
+
+  void WriteString(const std::string_view str)
+  {
+    if (str.size() < 32U) {
+      buffer_.push_back(static_cast<char>(0xA0U | str.size()));
+    }
+    else if (str.size() <= UINT8_MAX) {
+      WriteHeader(0xD9U, str.size(), 1);
+    }
+    else if (str.size() <= UINT16_MAX) {
+      WriteHeader(0xDAU, str.size(), 2);
+    }
+    else {
+      WriteHeader(0xDBU, str.size(), 4);
+    }
+    buffer_.append(str);
+  }
+
+  void WriteArrayHeader(const uint32_t size)
+  {
+    WriteContainerHeader(0x90U, 0xDCU, size);
+  }
+
+  void WriteMapHeader(const uint32_t size)
+  {
+    WriteContainerHeader(0x80U, 0xDEU, size);
+  }
+
+  [[nodiscard]] const std::string& GetBuffer() const
+  {
+    return buffer_;
+  }
+
+  void Clear()
+  {
+    buffer_.clear();
+  }
+
+ private:
+  // fixType is the tag of the 'fix' form, which holds sizes below 16; the 16 bit form follows on from largeType.
+  void WriteContainerHeader(const uint8_t fixType, const uint8_t largeType, const uint32_t size)
+  {
+    if (size < 16U) {
+      buffer_.push_back(static_cast<char>(fixType | size));
+    }
+    else if (size <= UINT16_MAX) {
+      WriteHeader(largeType, size, 2);
+    }
+    else {
+      WriteHeader(largeType + 1U, size, 4);
+    }
+  }
+
+  // Writes the type tag, followed by the low byteCount bytes of value in big endian order.
+  void WriteHeader(const uint8_t type, const uint64_t value, const int byteCount)
+  {
+    buffer_.push_back(static_cast<char>(type));
+    for (int i = byteCount - 1; i >= 0; --i) {
+      buffer_.push_back(static_cast<char>((value >> (8U * static_cast<unsigned>(i))) & 0xFFU));
+    }
+  }
+
+  std::string buffer_;
+};
+
+}// namespace sdb
+
+#endif// SDB_MSG_PACK_WRITER_H
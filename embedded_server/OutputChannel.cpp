@@ -0,0 +1,107 @@
+#include "OutputChannel.h"
+
+namespace sdb {
+
+OutputChannel::OutputChannel()
+    : ring_(kRingCapacity)
+{}
+
+bool OutputChannel::Push(const data::OutputLine& outputLine)
+{
+  std::lock_guard lock(mutex_);
+
+  auto counterPos = counters_.find(outputLine.fileName);
+  if (counterPos == counters_.end()) {
+    counterPos = counters_.emplace(std::string(outputLine.fileName), std::array<SourceCounters, 2>()).first;
+    for (size_t i = 0; i < counterPos->second.size(); ++i) {
+      counterPos->second[i].fileName = counterPos->first;
+      counterPos->second[i].isErr = i != 0;
+    }
+  }
+  auto& counters = counterPos->second[outputLine.isErr ? 1 : 0];
+  ++counters.lineCount;
+  counters.byteCount += outputLine.output.size();
+
+  const auto output = outputLine.output.substr(0, kMaxPendingBytes);
+  // Once a line has been dropped, so are the rest until the next drain; a smaller line that would still fit would
+  // otherwise leave a second gap that the batch can't report.
+  if (droppedSinceDrain_ > 0 || count_ == ring_.size() || pendingBytes_ + output.size() > kMaxPendingBytes) {
+    ++counters.droppedLineCount;
+    ++droppedSinceDrain_;
+    return droppedSinceDrain_ == 1;
+  }
+
+  if (count_ == 0) {
+    oldestPendingTime_ = std::chrono::steady_clock::now();
+  }
+  auto& slot = ring_[(head_ + count_) % ring_.size()];
+  slot.output.assign(output);
+  slot.isErr = outputLine.isErr;
+  slot.fileName.assign(outputLine.fileName);
+  slot.line = outputLine.line;
+  const bool wasFlushDue = pendingBytes_ >= kFlushBytes;
+  ++count_;
+  pendingBytes_ += output.size();
+  return count_ == 1 || (!wasFlushDue && pendingBytes_ >= kFlushBytes);
+}
+
+bool OutputChannel::IsFlushDue(const std::chrono::steady_clock::time_point now) const
+{
+  std::lock_guard lock(mutex_);
+  if (droppedSinceDrain_ > 0 || pendingBytes_ >= kFlushBytes) {
+    return true;
+  }
+  return count_ > 0 && now - oldestPendingTime_ >= kFlushInterval;
+}
+
+std::optional<std::chrono::steady_clock::time_point> OutputChannel::GetFlushDeadline() const
+{
+  std::lock_guard lock(mutex_);
+  if (count_ == 0) {
+    return std::nullopt;
+  }
+  return oldestPendingTime_ + kFlushInterval;
+}
+
+bool OutputChannel::IsEmpty() const
+{
+  std::lock_guard lock(mutex_);
+  return count_ == 0 && droppedSinceDrain_ == 0;
+}
+
+uint32_t OutputChannel::Drain(std::vector<Line>& lines)
+{
+  std::lock_guard lock(mutex_);
+  lines.resize(count_);
+  for (size_t i = 0; i < count_; ++i) {
+    auto& slot = ring_[(head_ + i) % ring_.size()];
+    auto& line = lines[i];
+    line.output.swap(slot.output);
+    line.isErr = slot.isErr;
+    line.fileName.swap(slot.fileName);
+    line.line = slot.line;
+  }
+
+  head_ = (head_ + count_) % ring_.size();
+  count_ = 0;
+  pendingBytes_ = 0;
+  const auto dropped = droppedSinceDrain_;
+  droppedSinceDrain_ = 0;
+  return dropped;
+}
+
+std::vector<OutputChannel::SourceCounters> OutputChannel::GetCounters() const
+{
+  std::lock_guard lock(mutex_);
+  std::vector<SourceCounters> result;
+  for (const auto& [fileName, fileCounters] : counters_) {
+    for (const auto& counters : fileCounters) {
+      if (counters.lineCount > 0) {
+        result.push_back(counters);
+      }
+    }
+  }
+  return result;
+}
+
+}// namespace sdb
@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef SDB_OUTPUT_CHANNEL_H
+#define SDB_OUTPUT_CHANNEL_H
+
+#include <sdb/MessageInterface.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sdb {
+
+// Collects the output of the script so that it can be sent in batches, rather than as a frame per line.
+// Lines are held in a fixed ring whose slots (and their strings) are reused, bounded both by line count and by bytes.
+// When either bound is reached, new lines are dropped and counted until the ring is next drained; older lines are kept
+// so that the output the client sees has a single gap, which the batch reports. Lines longer than kMaxPendingBytes are
+// truncated to it, so that they fit once the ring is drained. Pushing only ever copies the line under an uncontended
+// mutex, so neither the ring filling up nor a slow client can hold up the VM thread.
+class OutputChannel {
+ public:
+  struct Line {
+    std::string output;
+    bool isErr = false;
+    std::string fileName;
+    uint32_t line = 0;
+  };
+
+  // Totals since the channel was created, for a single file and stream (stdout or stderr).
+  struct SourceCounters {
+    std::string fileName;
+    bool isErr = false;
+    uint64_t lineCount = 0;
+    uint64_t byteCount = 0;
+    uint64_t droppedLineCount = 0;
+  };
+
+  static constexpr size_t kRingCapacity = 4096;
+  static constexpr size_t kMaxPendingBytes = 1024U * 1024U;
+  // Pending output is sent once there is this much of it, or once the oldest line has waited kFlushInterval.
+  static constexpr size_t kFlushBytes = 64U * 1024U;
+  static constexpr std::chrono::milliseconds kFlushInterval{10};
+
+  OutputChannel();
+
+  // Returns true if the sender should be woken: either this line starts the flush interval, or enough output is now
+  // pending (or dropped) that it should be sent straight away.
+  bool Push(const data::OutputLine& outputLine);
+
+  [[nodiscard]] bool IsFlushDue(std::chrono::steady_clock::time_point now) const;
+  // When the oldest pending line is due to be sent, or nullopt if there are none.
+  [[nodiscard]] std::optional<std::chrono::steady_clock::time_point> GetFlushDeadline() const;
+  [[nodiscard]] bool IsEmpty() const;
+
+  // Moves every pending line into lines, which is resized to fit; the strings of its elements are swapped with those
+  // in the ring so that neither side reallocates once warmed up. Returns the number of lines that were dropped after
+  // the last of them.
+  uint32_t Drain(std::vector<Line>& lines);
+
+  [[nodiscard]] std::vector<SourceCounters> GetCounters() const;
+
+ private:
+  mutable std::mutex mutex_;
+
+  std::vector<Line> ring_;
+  // Index of the oldest pending line
+  size_t head_ = 0;
+  size_t count_ = 0;
+  size_t pendingBytes_ = 0;
+  uint32_t droppedSinceDrain_ = 0;
+  std::chrono::steady_clock::time_point oldestPendingTime_;
+
+  // Indexed by isErr. The comparator allows lookups by string_view, so that counting doesn't allocate.
+  std::map<std::string, std::array<SourceCounters, 2>, std::less<>> counters_;
+};
+
+}// namespace sdb
+
+#endif// SDB_OUTPUT_CHANNEL_H
@@ -0,0 +1,135 @@
+#include "OutputHistory.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sdb {
+
+uint64_t OutputHistory::Append(const std::vector<OutputChannel::Line>& lines)
+{
+  std::lock_guard lock(mutex_);
+  const auto firstSequence = nextSequence_;
+  for (const auto& line : lines) {
+    const auto outputSize = std::min(line.output.size(), kChunkSize - sizeof(RecordHeader));
+    Reserve(sizeof(RecordHeader) + outputSize);
+
+    const RecordHeader header = {
+            nextSequence_, InternFileName(line.fileName), line.line, static_cast<uint32_t>(outputSize), line.isErr};
+    auto& chunk = chunks_.back();
+    std::memcpy(chunk.data.get() + chunk.size, &header, sizeof(RecordHeader));
+    std::memcpy(chunk.data.get() + chunk.size + sizeof(RecordHeader), line.output.data(), outputSize);
+    chunk.size += sizeof(RecordHeader) + outputSize;
+    chunk.endSequence = ++nextSequence_;
+
+    const auto sourceKey = SourceKey(header.fileIndex, header.isErr);
+    if (std::find(chunk.sources.begin(), chunk.sources.end(), sourceKey) == chunk.sources.end()) {
+      chunk.sources.push_back(sourceKey);
+    }
+  }
+  return firstSequence;
+}
+
+OutputHistory::QueryResult OutputHistory::Find(const Query& query) const
+{
+  std::lock_guard lock(mutex_);
+  QueryResult result;
+  result.firstSequence = chunks_.empty() ? nextSequence_ : chunks_.front().firstSequence;
+  result.nextSequence = std::min(std::max(query.beginSequence, result.firstSequence), nextSequence_);
+
+  std::optional<uint32_t> fileIndex;
+  if (query.fileName.has_value()) {
+    const auto fileIndexPos = fileIndices_.find(*query.fileName);
+    if (fileIndexPos == fileIndices_.end()) {
+      result.nextSequence = std::min(query.endSequence, nextSequence_);
+      return result;
+    }
+    fileIndex = fileIndexPos->second;
+  }
+  const auto hasSource = [&](const Chunk& chunk) {
+    if (!fileIndex.has_value()) {
+      return !query.isErr.has_value() || std::any_of(chunk.sources.begin(), chunk.sources.end(), [&](uint32_t key) {
+        return (key % 2U == 1U) == *query.isErr;
+      });
+    }
+    const auto containsSource = [&](const bool isErr) {
+      return std::find(chunk.sources.begin(), chunk.sources.end(), SourceKey(*fileIndex, isErr)) != chunk.sources.end();
+    };
+    return query.isErr.has_value() ? containsSource(*query.isErr) : (containsSource(false) || containsSource(true));
+  };
+
+  for (const auto& chunk : chunks_) {
+    if (chunk.endSequence <= query.beginSequence || !hasSource(chunk)) {
+      continue;
+    }
+    if (chunk.firstSequence >= query.endSequence) {
+      break;
+    }
+
+    for (size_t offset = 0; offset < chunk.size;) {
+      RecordHeader header = {};
+      std::memcpy(&header, chunk.data.get() + offset, sizeof(RecordHeader));
+      const std::string_view output(chunk.data.get() + offset + sizeof(RecordHeader), header.outputSize);
+      offset += sizeof(RecordHeader) + header.outputSize;
+
+      if (header.sequence < query.beginSequence) {
+        continue;
+      }
+      if (header.sequence >= query.endSequence) {
+        break;
+      }
+      if (result.records.size() == query.maxCount) {
+        result.nextSequence = header.sequence;
+        return result;
+      }
+      if ((fileIndex.has_value() && header.fileIndex != *fileIndex) ||
+          (query.isErr.has_value() && header.isErr != *query.isErr) ||
+          (!query.contains.empty() && output.find(query.contains) == std::string_view::npos))
+      {
+        continue;
+      }
+
+      auto& record = result.records.emplace_back();
+      record.sequence = header.sequence;
+      record.line.output.assign(output);
+      record.line.isErr = header.isErr;
+      record.line.fileName = fileNames_[header.fileIndex];
+      record.line.line = header.line;
+    }
+  }
+
+  result.nextSequence = std::max(result.nextSequence, std::min(query.endSequence, nextSequence_));
+  return result;
+}
+
+uint32_t OutputHistory::InternFileName(const std::string& fileName)
+{
+  auto fileIndexPos = fileIndices_.find(fileName);
+  if (fileIndexPos == fileIndices_.end()) {
+    fileIndexPos = fileIndices_.emplace(fileName, static_cast<uint32_t>(fileNames_.size())).first;
+    fileNames_.push_back(fileName);
+  }
+  return fileIndexPos->second;
+}
+
+void OutputHistory::Reserve(const size_t size)
+{
+  if (!chunks_.empty() && chunks_.back().size + size <= kChunkSize) {
+    return;
+  }
+
+  Chunk chunk;
+  if (chunks_.size() == kMaxChunks) {
+    chunk.data = std::move(chunks_.front().data);
+    chunk.sources = std::move(chunks_.front().sources);
+    chunk.sources.clear();
+    chunks_.pop_front();
+  }
+  else {
+    chunk.data = std::make_unique<char[]>(kChunkSize);
+  }
+  chunk.firstSequence = nextSequence_;
+  chunk.endSequence = nextSequence_;
+  chunks_.push_back(std::move(chunk));
+}
+
+}// namespace sdb
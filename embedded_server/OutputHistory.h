@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef SDB_OUTPUT_HISTORY_H
+#define SDB_OUTPUT_HISTORY_H
+
+#include "OutputChannel.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sdb {
+
+// Keeps the most recent output of the script, so that clients which connect late (or reconnect) can catch up on what
+// was sent before. Each line is given a sequence number, which is also sent with output_lines events.
+// Lines are appended to fixed size chunks, which are recycled oldest first once kMaxChunks are in use, so memory is
+// bounded and nothing is allocated per line. Each chunk records which file and stream pairs it contains, so that
+// queries filtered by those skip chunks without looking at their lines.
+class OutputHistory {
+ public:
+  static constexpr size_t kChunkSize = 256U * 1024U;
+  static constexpr size_t kMaxChunks = 32U;
+
+  struct Query {
+    // Range of sequence numbers to search, end exclusive.
+    uint64_t beginSequence = 0;
+    uint64_t endSequence = UINT64_MAX;
+    uint32_t maxCount = 1000;
+    std::optional<std::string> fileName;
+    std::optional<bool> isErr;
+    // Only return lines whose output contains this, if not empty.
+    std::string contains;
+  };
+
+  struct Record {
+    uint64_t sequence = 0;
+    OutputChannel::Line line;
+  };
+
+  struct QueryResult {
+    std::vector<Record> records;
+    // Sequence number of the oldest line still held.
+    uint64_t firstSequence = 0;
+    // Pass as the beginSequence of the next query to continue from where this one stopped.
+    uint64_t nextSequence = 0;
+  };
+
+  // Returns the sequence number given to the first of the lines. Lines longer than a chunk are truncated.
+  uint64_t Append(const std::vector<OutputChannel::Line>& lines);
+
+  [[nodiscard]] QueryResult Find(const Query& query) const;
+
+ private:
+  // Stored at the start of each record, followed by the output. Copied in and out, as records are only byte aligned.
+  struct RecordHeader {
+    uint64_t sequence;
+    uint32_t fileIndex;
+    uint32_t line;
+    uint32_t outputSize;
+    bool isErr;
+  };
+
+  struct Chunk {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+    uint64_t firstSequence = 0;
+    uint64_t endSequence = 0;
+    // SourceKey of each file and stream pair that has a line in the chunk
+    std::vector<uint32_t> sources;
+  };
+
+  [[nodiscard]] static uint32_t SourceKey(const uint32_t fileIndex, const bool isErr)
+  {
+    return fileIndex * 2U + (isErr ? 1U : 0U);
+  }
+
+  [[nodiscard]] uint32_t InternFileName(const std::string& fileName);
+  // Makes sure the last chunk has room for size more bytes
+  void Reserve(size_t size);
+
+  mutable std::mutex mutex_;
+  std::deque<Chunk> chunks_;
+  uint64_t nextSequence_ = 0;
+
+  std::vector<std::string> fileNames_;
+  std::map<std::string, uint32_t, std::less<>> fileIndices_;
+};
+
+}// namespace sdb
+
+#endif// SDB_OUTPUT_HISTORY_H
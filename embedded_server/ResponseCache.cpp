@@ -0,0 +1,101 @@
+#include "ResponseCache.h"
+
+namespace sdb {
+
+uint64_t ResponseCache::GetVersion(const uint32_t pauseEpoch) const
+{
+  std::lock_guard lock(mutex_);
+  return (static_cast<uint64_t>(pauseEpoch) << 32U) | editCount_;
+}
+
+void ResponseCache::Invalidate()
+{
+  std::lock_guard lock(mutex_);
+  ++editCount_;
+}
+
+oatpp::String ResponseCache::Find(const uint64_t version, const std::string& key)
+{
+  std::lock_guard lock(mutex_);
+  if (!UpdateVersion(version)) {
+    return nullptr;
+  }
+
+  const auto pos = entriesByKey_.find(key);
+  if (pos == entriesByKey_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, pos->second);
+  return pos->second->body;
+}
+
+void ResponseCache::Insert(const uint64_t version, const std::string& key, const oatpp::String& body)
+{
+  const auto entryBytes = key.size() + static_cast<size_t>(body->getSize());
+  if (entryBytes > kMaxEntryBytes) {
+    return;
+  }
+
+  std::lock_guard lock(mutex_);
+  if (!UpdateVersion(version) || entriesByKey_.find(key) != entriesByKey_.end()) {
+    return;
+  }
+
+  while (!entries_.empty() && byteCount_ + entryBytes > kMaxBytes) {
+    const auto& oldest = entries_.back();
+    byteCount_ -= oldest.key.size() + static_cast<size_t>(oldest.body->getSize());
+    entriesByKey_.erase(oldest.key);
+    entries_.pop_back();
+  }
+
+  entries_.push_front({key, body});
+  entriesByKey_.emplace(entries_.front().key, entries_.begin());
+  byteCount_ += entryBytes;
+}
+
+std::string ResponseCache::FormatETag(const uint64_t version)
+{
+  return "\"" + std::to_string(version >> 32U) + "." + std::to_string(version & UINT32_MAX) + "\"";
+}
+
+bool ResponseCache::IsETagMatch(const std::string_view ifNoneMatch, const std::string_view etag)
+{
+  // A comma separated list of ETags, or *
+  size_t begin = 0;
+  while (begin < ifNoneMatch.size()) {
+    auto end = ifNoneMatch.find(',', begin);
+    if (end == std::string_view::npos) {
+      end = ifNoneMatch.size();
+    }
+
+    auto candidate = ifNoneMatch.substr(begin, end - begin);
+    const auto first = candidate.find_first_not_of(' ');
+    const auto last = candidate.find_last_not_of(' ');
+    candidate = first == std::string_view::npos ? std::string_view() : candidate.substr(first, last - first + 1);
+    // Weak comparison, as used for If-None-Match
+    if (candidate.substr(0, 2) == "W/") {
+      candidate.remove_prefix(2);
+    }
+    if (candidate == "*" || candidate == etag) {
+      return true;
+    }
+    begin = end + 1;
+  }
+  return false;
+}
+
+bool ResponseCache::UpdateVersion(const uint64_t version)
+{
+  if (version < version_) {
+    return false;
+  }
+  if (version > version_) {
+    version_ = version;
+    entriesByKey_.clear();
+    entries_.clear();
+    byteCount_ = 0;
+  }
+  return true;
+}
+
+}// namespace sdb
@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef SDB_RESPONSE_CACHE_H
+#define SDB_RESPONSE_CACHE_H
+
+#include <oatpp/core/Types.hpp>
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace sdb {
+
+// Caches serialized responses for requests that read the state of a paused program, keyed by the request URI.
+// Entries are tagged with a version made from the pause epoch and a count of edits; once a newer version is seen every
+// older entry is discarded, as the program has resumed (or a value was edited) since. The version is also sent as the
+// response's ETag, so clients that already have the response are sent 304 Not Modified instead.
+// Called from the HTTP connection threads.
+class ResponseCache {
+ public:
+  static constexpr size_t kMaxBytes = 8U * 1024U * 1024U;
+  // Larger responses aren't cached, so that one of them can't push out everything else.
+  static constexpr size_t kMaxEntryBytes = kMaxBytes / 8U;
+
+  // Must be read before the state that the response is built from, so that a response is never tagged with a newer
+  // version than it reflects.
+  [[nodiscard]] uint64_t GetVersion(uint32_t pauseEpoch) const;
+
+  // Call after editing the program's state (ie. setting a variable's value) to invalidate every response.
+  void Invalidate();
+
+  // Returns null if there is no response for the key with this version.
+  [[nodiscard]] oatpp::String Find(uint64_t version, const std::string& key);
+  void Insert(uint64_t version, const std::string& key, const oatpp::String& body);
+
+  [[nodiscard]] static std::string FormatETag(uint64_t version);
+  // True if the value of an If-None-Match header matches the ETag.
+  [[nodiscard]] static bool IsETagMatch(std::string_view ifNoneMatch, std::string_view etag);
+
+ private:
+  struct Entry {
+    std::string key;
+    oatpp::String body;
+  };
+
+  // Discards everything from older versions. Returns false if version is older than the current one.
+  bool UpdateVersion(uint64_t version);
+
+  mutable std::mutex mutex_;
+  uint32_t editCount_ = 0;
+  uint64_t version_ = 0;
+  size_t byteCount_ = 0;
+  // Most recently used first
+  std::list<Entry> entries_;
+  std::unordered_map<std::string_view, std::list<Entry>::iterator> entriesByKey_;
+};
+
+}// namespace sdb
+
+#endif// SDB_RESPONSE_CACHE_H
@@ -0,0 +1,121 @@
+#include "StatusDeltaTracker.h"
+
+#include <algorithm>
+
+namespace sdb {
+
+void StatusDeltaTracker::AddFullStatus(const uint64_t sequence, const data::Status& status)
+{
+  std::lock_guard lock(mutex_);
+
+  std::vector<StatusDelta::Frame> frames;
+  if (InternFrames(status, frames)) {
+    AddSentStatus(sequence, status.stackDepth, std::move(frames));
+  }
+}
+
+bool StatusDeltaTracker::TryCreateDelta(const uint64_t sequence, const data::Status& status, StatusDelta& delta)
+{
+  std::lock_guard lock(mutex_);
+  if (!acknowledged_.has_value()) {
+    return false;
+  }
+
+  std::vector<StatusDelta::Frame> frames;
+  if (!InternFrames(status, frames)) {
+    return false;
+  }
+
+  // Frames are aligned by their depth from the bottom of the whole stack, as deep stacks only hold their top frames.
+  // Frame i of a stack is at depth stackDepth - 1 - i.
+  const auto& base = *acknowledged_;
+  const size_t frameCount = frames.size();
+  const size_t bottomDepth = status.stackDepth - frameCount;
+  const size_t baseBottomDepth = base.stackDepth - base.frames.size();
+  const auto isSameFrame = [](const StatusDelta::Frame& lhs, const StatusDelta::Frame& rhs) {
+    return lhs.fileId == rhs.fileId && lhs.line == rhs.line && lhs.functionId == rhs.functionId;
+  };
+
+  // Frames below the bottom of the base's stack are unknown to the client, the ones above those are unchanged for as
+  // long as they match the base's frame at the same depth.
+  const auto bottomFrameCount = std::min(frameCount, baseBottomDepth - std::min(baseBottomDepth, bottomDepth));
+  size_t unchangedFrameCount = 0;
+  for (auto depth = bottomDepth + bottomFrameCount; depth < status.stackDepth && depth < base.stackDepth; ++depth) {
+    if (!isSameFrame(frames[status.stackDepth - 1U - depth], base.frames[base.stackDepth - 1U - depth])) {
+      break;
+    }
+    ++unchangedFrameCount;
+  }
+  const auto topFrameCount = frameCount - bottomFrameCount - unchangedFrameCount;
+
+  delta.sequence = sequence;
+  delta.baseSequence = base.sequence;
+  delta.unchangedFrameCount = static_cast<uint32_t>(unchangedFrameCount);
+  delta.frames.assign(frames.begin(), frames.begin() + static_cast<std::ptrdiff_t>(topFrameCount));
+  delta.bottomFrames.assign(frames.end() - static_cast<std::ptrdiff_t>(bottomFrameCount), frames.end());
+  delta.names.clear();
+  const auto addName = [this, &delta](const uint32_t id, const std::string& name) {
+    if (!isNameSent_[id]) {
+      isNameSent_[id] = true;
+      delta.names.emplace_back(id, name);
+    }
+  };
+  for (size_t i = 0; i < frameCount; ++i) {
+    if (i < topFrameCount || i >= frameCount - bottomFrameCount) {
+      addName(frames[i].fileId, status.stack[i].file);
+      addName(frames[i].functionId, status.stack[i].function);
+    }
+  }
+
+  AddSentStatus(sequence, status.stackDepth, std::move(frames));
+  return true;
+}
+
+bool StatusDeltaTracker::Acknowledge(const uint64_t sequence)
+{
+  std::lock_guard lock(mutex_);
+
+  const auto pos = std::find_if(
+          sent_.begin(), sent_.end(), [sequence](const SentStatus& sent) { return sent.sequence == sequence; });
+  if (pos == sent_.end()) {
+    return false;
+  }
+
+  // Deltas are only ever created against the latest acknowledged status, so earlier ones are no longer needed.
+  acknowledged_ = std::move(*pos);
+  sent_.erase(sent_.begin(), pos + 1);
+  return true;
+}
+
+bool StatusDeltaTracker::InternFrames(const data::Status& status, std::vector<StatusDelta::Frame>& frames)
+{
+  if (nameIds_.size() + 2 * status.stack.size() > kMaxNames) {
+    return false;
+  }
+
+  frames.reserve(status.stack.size());
+  for (const auto& stackEntry : status.stack) {
+    frames.push_back({InternName(stackEntry.file), stackEntry.line, InternName(stackEntry.function)});
+  }
+  return true;
+}
+
+uint32_t StatusDeltaTracker::InternName(const std::string& name)
+{
+  const auto [pos, isNew] = nameIds_.emplace(name, static_cast<uint32_t>(nameIds_.size()));
+  if (isNew) {
+    isNameSent_.push_back(false);
+  }
+  return pos->second;
+}
+
+void StatusDeltaTracker::AddSentStatus(
+        const uint64_t sequence, const uint32_t stackDepth, std::vector<StatusDelta::Frame>&& frames)
+{
+  if (sent_.size() == kMaxUnacknowledged) {
+    sent_.pop_front();
+  }
+  sent_.push_back({sequence, stackDepth, std::move(frames)});
+}
+
+}// namespace sdb
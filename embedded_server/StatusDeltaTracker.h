@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef SDB_STATUS_DELTA_TRACKER_H
+#define SDB_STATUS_DELTA_TRACKER_H
+
+#include <sdb/MessageInterface.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sdb {
+
+// A status, described relative to an earlier one that the client has acknowledged. Stacks are ordered top frame
+// first, so the frames that are unchanged while stepping are those at the bottom. Statuses only hold the top of deep
+// stacks, so frames are matched by their depth from the bottom of the whole stack (the status's stackDepth): the new
+// stack is the given frames, followed by unchangedFrameCount frames of the base status's stack at the same depths,
+// followed by bottomFrames. bottomFrames only holds frames below the bottom of the base's stack, eg. after stepping out
+// of a deep recursion.
+struct StatusDelta {
+  struct Frame {
+    uint32_t fileId = 0;
+    uint32_t line = 0;
+    uint32_t functionId = 0;
+  };
+
+  uint64_t sequence = 0;
+  uint64_t baseSequence = 0;
+  // File and function names used by frames for the first time on this connection; later deltas refer to them by id.
+  std::vector<std::pair<uint32_t, std::string_view>> names;
+  uint32_t unchangedFrameCount = 0;
+  std::vector<Frame> frames;
+  std::vector<Frame> bottomFrames;
+};
+
+// Remembers the stacks of the statuses sent to one connection, so that once the client acknowledges one of them the
+// following statuses can be sent as a StatusDelta against it. Clients that never acknowledge a status are always sent
+// them in full.
+// Acknowledge is called from the connection's own thread, and the other methods from its writer thread.
+class StatusDeltaTracker {
+ public:
+  // Statuses that haven't been acknowledged are forgotten beyond this many, oldest first.
+  static constexpr size_t kMaxUnacknowledged = 32;
+  // Once this many names have been interned, statuses are sent in full rather than growing the table further.
+  static constexpr size_t kMaxNames = 64U * 1024U;
+
+  // Records a status that was sent in full.
+  void AddFullStatus(uint64_t sequence, const data::Status& status);
+
+  // If the client has acknowledged an earlier status, fills delta against it (its names point into status), records the
+  // status as sent and returns true. Otherwise the status should be sent in full.
+  [[nodiscard]] bool TryCreateDelta(uint64_t sequence, const data::Status& status, StatusDelta& delta);
+
+  // Returns false if the sequence isn't that of a status that was sent, or it has since been forgotten.
+  [[nodiscard]] bool Acknowledge(uint64_t sequence);
+
+ private:
+  struct SentStatus {
+    uint64_t sequence = 0;
+    uint32_t stackDepth = 0;
+    std::vector<StatusDelta::Frame> frames;
+  };
+
+  // Returns false if the name table is full.
+  bool InternFrames(const data::Status& status, std::vector<StatusDelta::Frame>& frames);
+  uint32_t InternName(const std::string& name);
+  void AddSentStatus(uint64_t sequence, uint32_t stackDepth, std::vector<StatusDelta::Frame>&& frames);
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, uint32_t> nameIds_;
+  // Indexed by id; whether the client has been told the name yet.
+  std::vector<bool> isNameSent_;
+  std::deque<SentStatus> sent_;
+  std::optional<SentStatus> acknowledged_;
+};
+
+}// namespace sdb
+
+#endif// SDB_STATUS_DELTA_TRACKER_H
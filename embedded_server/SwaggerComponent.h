@@ -12,7 +12,7 @@
 
 #include "oatpp/core/macro/component.hpp"
 
-#include "ListenerConfig.h"
+#include "include/sdb/ListenerConfig.h"
 
 namespace sdb {
 #ifdef SDB_ENABLE_OATPP_SWAGGER
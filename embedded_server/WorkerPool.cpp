@@ -0,0 +1,55 @@
+#include "WorkerPool.h"
+
+namespace sdb {
+
+WorkerPool::WorkerPool(const uint32_t threadCount, const size_t maxQueuedTasks)
+    : maxQueuedTasks_(maxQueuedTasks)
+{
+  threads_.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; ++i) {
+    threads_.emplace_back([this]() { Run(); });
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+    tasks_.clear();
+    taskCv_.notify_all();
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+bool WorkerPool::TrySubmit(std::function<void()> task)
+{
+  std::lock_guard lock(mutex_);
+  if (stopping_ || tasks_.size() >= maxQueuedTasks_) {
+    return false;
+  }
+  tasks_.emplace_back(std::move(task));
+  taskCv_.notify_one();
+  return true;
+}
+
+void WorkerPool::Run()
+{
+  std::unique_lock lock(mutex_);
+  while (true) {
+    taskCv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+    if (stopping_) {
+      return;
+    }
+
+    auto task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+}// namespace sdb
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef SDB_WORKER_POOL_H
+#define SDB_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sdb {
+
+// A fixed set of threads that run tasks in the order they were submitted, with a bounded number of tasks waiting.
+// Used in Async mode to run the endpoints that may walk large parts of the VM, so that they don't hold up the executor
+// threads that every other request is served on.
+class WorkerPool {
+ public:
+  WorkerPool(uint32_t threadCount, size_t maxQueuedTasks);
+  // Tasks that haven't started are discarded; waits for those that have to finish.
+  ~WorkerPool();
+
+  // Deleted methods
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool(WorkerPool&&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+  WorkerPool& operator=(WorkerPool&&) = delete;
+
+  // Returns false, without running the task, if maxQueuedTasks tasks are already waiting. Tasks must not throw.
+  [[nodiscard]] bool TrySubmit(std::function<void()> task);
+
+ private:
+  void Run();
+
+  const size_t maxQueuedTasks_;
+  std::mutex mutex_;
+  std::condition_variable taskCv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  // Declared last, so that everything they use is constructed before they start
+  std::vector<std::thread> threads_;
+};
+
+}// namespace sdb
+
+#endif// SDB_WORKER_POOL_H
@@ -11,35 +11,70 @@
 #include <oatpp-websocket/Handshaker.hpp>
 #include <oatpp/core/macro/codegen.hpp>
 #include <oatpp/core/macro/component.hpp>
+#include <oatpp/encoding/Base64.hpp>
 #include <oatpp/parser/json/mapping/ObjectMapper.hpp>
+#include <oatpp/web/protocol/http/outgoing/StreamingBody.hpp>
 #include <oatpp/web/server/api/ApiController.hpp>
 #include <utility>
 
+#include "../OutputChannel.h"
+#include "../OutputHistory.h"
+#include "../ResponseCache.h"
 #include "../dto/EventDto.h"
+#include "../include/sdb/ListenerConfig.h"
+#include "VariableListWriter.h"
+#include "VariableStreamCallback.h"
 
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
 #include <sstream>
+#include <type_traits>
 
 #include OATPP_CODEGEN_BEGIN(ApiController)
 
 namespace sdb {
 class DebugCommandController final : public oatpp::web::server::api::ApiController {
-  using VariablesCallback = std::function<std::tuple<data::ReturnCode, std::vector<data::Variable>>(
-          const data::PaginationInfo& pagination)>;
+  // May be called after the endpoint has returned when the response is streamed, so must not capture by reference.
+  using VariablesCallback = VariableStreamCallback::FetchPageFn;
+
+  static constexpr uint32_t kMaxExpandDepth = 16U;
+  static constexpr uint32_t kMaxExpandNodes = 10000U;
+  static constexpr uint32_t kMaxArraySliceCount = 1000000U;
+  static constexpr uint32_t kMaxHistogramBins = 1024U;
+  // The export recurses once per level of nesting
+  static constexpr uint32_t kMaxExportDepth = 256U;
+  // Exports returned as the response body are built in memory first, so are limited to far less than those written to
+  // files.
+  static constexpr uint32_t kDefaultExportBodyBytes = 4U * 1024U * 1024U;
+  static constexpr uint32_t kMaxExportBodyBytes = 16U * 1024U * 1024U;
+  static constexpr uint32_t kMaxOutputHistoryCount = 10000U;
+  static constexpr uint32_t kMaxStackCount = 1000U;
 
  public:
   DebugCommandController(
           std::shared_ptr<MessageCommandInterface> messageCommandInterface,
-          const std::shared_ptr<ObjectMapper>& objectMapper)
+          std::shared_ptr<OutputChannel> outputChannel, std::shared_ptr<OutputHistory> outputHistory,
+          const ListenerConfig& config, const std::shared_ptr<ObjectMapper>& objectMapper)
       : ApiController(objectMapper, "DebugCommand/")
       , messageCommandInterface_(std::move(messageCommandInterface))
+      , outputChannel_(std::move(outputChannel))
+      , outputHistory_(std::move(outputHistory))
+      , exportDirectory_(config.exportDirectory)
+      , isAsync_(config.connectionMode == ListenerConfig::ConnectionMode::Async)
       , commandOkResponse_(CreateCommandOkResponse())
   {}
 
   static std::shared_ptr<DebugCommandController> CreateShared(
           std::shared_ptr<MessageCommandInterface> messageCommandInterface,
-          OATPP_COMPONENT(std::shared_ptr<ObjectMapper>, objectMapper))
+          std::shared_ptr<OutputChannel> outputChannel, std::shared_ptr<OutputHistory> outputHistory,
+          const ListenerConfig& config, OATPP_COMPONENT(std::shared_ptr<ObjectMapper>, objectMapper))
   {
-    return std::make_shared<DebugCommandController>(std::move(messageCommandInterface), objectMapper);
+    return std::make_shared<DebugCommandController>(
+            std::move(messageCommandInterface), std::move(outputChannel), std::move(outputHistory), config,
+            objectMapper);
   }
 
 
@@ -97,21 +132,86 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
     info->addResponse<Object<dto::CommandMessageResponse>>(Status::CODE_200, "application/json");
   }
 
+  ENDPOINT("GET", "Stack", Stack, QUERIES(QueryParams, queryParams))
+  {
+    data::PaginationInfo range = {};
+    const bool validParams = ParseQueryParamWithDefault(queryParams, "beginIterator", 0U, range.beginIterator) &&
+                             ParseQueryParamWithDefault(queryParams, "count", kMaxStackCount, range.count) &&
+                             range.count <= kMaxStackCount;
+    if (!validParams) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    std::vector<data::StackEntry> stack;
+    uint32_t stackDepth = 0;
+    const auto ret = messageCommandInterface_->GetStack(range, stack, stackDepth);
+    if (ret != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(ret);
+    }
+
+    const auto stackDto = dto::StackResponse::createShared();
+    stackDto->stack = List<Object<dto::StackEntry>>::createShared();
+    for (const auto& stackEntry : stack) {
+      stackDto->stack->push_back(CreateStackEntry(stackEntry));
+    }
+    stackDto->stackDepth = stackDepth;
+    stackDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    return createDtoResponse(Status::CODE_200, stackDto);
+  }
+  ENDPOINT_INFO(Stack)
+  {
+    info->description =
+            "Reads a range of the stack frames, innermost first, for stacks deeper than the status event holds.";
+    info->addResponse<Object<dto::StackResponse>>(Status::CODE_200, "application/json");
+
+    auto& beginIteratorParam = info->queryParams.add<UInt32>("beginIterator");
+    beginIteratorParam.required = false;
+    beginIteratorParam.description = "Index of the first frame to read; 0 (the default) is the innermost.";
+
+    auto& countParam = info->queryParams.add<UInt32>("count");
+    countParam.required = false;
+    countParam.description = "Maximum number of frames to read. Must be at most 1000, which is the default.";
+
+    AddCommandMessageErrorResponses(info);
+  }
+
   ENDPOINT(
           "GET", "Variables/Local/{stackFrame}", StackLocals, PATH(UInt32, stackFrame), QUERY(String, path),
-          QUERIES(QueryParams, queryParams))
+          QUERIES(QueryParams, queryParams), REQUEST(std::shared_ptr<IncomingRequest>, request))
   {
-    return HandleVariablesCommandMessage(queryParams, [&](const data::PaginationInfo& pagination) {
-      std::vector<data::Variable> variables;
-      return std::tuple(
-              messageCommandInterface_->GetStackVariables(stackFrame, path->std_str(), pagination, variables),
-              variables);
-    });
+    return HandleVariablesCommandMessage(
+            request, queryParams, [messageCommandInterface = messageCommandInterface_, stackFrame, path](
+                                 const data::PaginationInfo& pagination, const data::VariableQueryOptions& options) {
+              std::vector<data::Variable> variables;
+              uint64_t nextCursor = 0;
+              const auto rc = messageCommandInterface->GetStackVariables(
+                      stackFrame, path->std_str(), pagination, options, variables, nextCursor);
+              return std::tuple(rc, std::move(variables), nextCursor);
+            });
   }
   ENDPOINT_INFO(StackLocals)
   {
     info->addResponse<Object<dto::VariableListResponse>>(Status::CODE_200, "application/json");
+    AddCommandMessageETagParams(info);
     AddCommandMessagePaginationParams(info);
+    AddCommandMessageCursorParam(info);
+    AddCommandMessageStreamParam(info);
+    AddCommandMessageExpansionParams(info);
+    AddCommandMessageFilterParams(info);
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT(
+          "GET", "Variables/Local/{stackFrame}/Value", StackLocalValue, PATH(UInt32, stackFrame), QUERY(String, path))
+  {
+    std::vector<data::Variable> variables = {{}};
+    const auto ret = messageCommandInterface_->GetStackVariable(stackFrame, path->std_str(), variables[0]);
+    return CreateVariableListResponse(ret, variables);
+  }
+  ENDPOINT_INFO(StackLocalValue)
+  {
+    info->description = "Reads the single variable at the given path, with a full summary of its value.";
+    info->addResponse<Object<dto::VariableListResponse>>(Status::CODE_200, "application/json");
     AddCommandMessageErrorResponses(info);
   }
 
@@ -120,6 +220,8 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
   {
     std::vector<data::Variable> newValues = {{}};
     const auto ret = messageCommandInterface_->SetStackVariableValue(stackFrame, path->std_str(), setValueBody->value->std_str(), newValues[0]);
+    // Only once the value has changed, so that no response read before the edit is cached as the new version.
+    responseCache_->Invalidate();
     if (ret != data::ReturnCode::Success) {
       return CreateReturnCodeResponse(ret);
     }
@@ -135,18 +237,270 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
     AddCommandMessageErrorResponses(info);
   }
 
-  ENDPOINT("GET", "Variables/Global", StackGlobals, QUERY(String, path), QUERIES(QueryParams, queryParams))
+  ENDPOINT(
+          "GET", "Variables/Global", StackGlobals, QUERY(String, path), QUERIES(QueryParams, queryParams),
+          REQUEST(std::shared_ptr<IncomingRequest>, request))
   {
-    return HandleVariablesCommandMessage(queryParams, [&](const data::PaginationInfo& pagination) {
-      std::vector<data::Variable> variables;
-      return std::tuple(
-              messageCommandInterface_->GetGlobalVariables(path->std_str(), pagination, variables), variables);
-    });
+    return HandleVariablesCommandMessage(
+            request, queryParams, [messageCommandInterface = messageCommandInterface_, path](
+                                 const data::PaginationInfo& pagination, const data::VariableQueryOptions& options) {
+              std::vector<data::Variable> variables;
+              uint64_t nextCursor = 0;
+              const auto rc = messageCommandInterface->GetGlobalVariables(
+                      path->std_str(), pagination, options, variables, nextCursor);
+              return std::tuple(rc, std::move(variables), nextCursor);
+            });
   }
   ENDPOINT_INFO(StackGlobals)
   {
     info->addResponse<Object<dto::VariableListResponse>>(Status::CODE_200, "application/json");
+    AddCommandMessageETagParams(info);
     AddCommandMessagePaginationParams(info);
+    AddCommandMessageCursorParam(info);
+    AddCommandMessageStreamParam(info);
+    AddCommandMessageExpansionParams(info);
+    AddCommandMessageFilterParams(info);
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT("GET", "Variables/Global/Value", StackGlobalValue, QUERY(String, path))
+  {
+    std::vector<data::Variable> variables = {{}};
+    const auto ret = messageCommandInterface_->GetGlobalVariable(path->std_str(), variables[0]);
+    return CreateVariableListResponse(ret, variables);
+  }
+  ENDPOINT_INFO(StackGlobalValue)
+  {
+    info->description = "Reads the single variable at the given path, with a full summary of its value.";
+    info->addResponse<Object<dto::VariableListResponse>>(Status::CODE_200, "application/json");
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT(
+          "GET", "Variables/Array/{stackFrame}", ArraySlice, PATH(Int32, stackFrame), QUERY(String, path),
+          QUERIES(QueryParams, queryParams))
+  {
+    data::PaginationInfo range = {};
+    const bool validParams =
+            ParseQueryParamWithDefault(queryParams, "beginIterator", 0U, range.beginIterator) &&
+            ParseQueryParamWithDefault(queryParams, "count", kMaxArraySliceCount, range.count) &&
+            range.count <= kMaxArraySliceCount;
+    const auto formatStr = queryParams.get("format");
+    const auto format = formatStr == nullptr ? std::string() : formatStr->std_str();
+    if (!validParams || !(format.empty() || format == "base64" || format == "binary")) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    data::ArraySlice slice;
+    const auto ret = messageCommandInterface_->GetArraySlice(stackFrame, path->std_str(), range, slice);
+    if (ret != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(ret);
+    }
+
+    if (format == "binary") {
+      auto response = createResponse(
+              Status::CODE_200,
+              String(reinterpret_cast<const char*>(slice.data.data()), static_cast<v_buff_size>(slice.data.size()),
+                     true));
+      response->putHeader(Header::CONTENT_TYPE, "application/octet-stream");
+      response->putHeader("X-Sdb-Element-Type", ToElementTypeName(slice.elementType));
+      response->putHeader("X-Sdb-Element-Size", std::to_string(slice.elementSize).c_str());
+      response->putHeader("X-Sdb-Begin-Index", std::to_string(slice.beginIndex).c_str());
+      response->putHeader("X-Sdb-Array-Size", std::to_string(slice.arraySize).c_str());
+      return response;
+    }
+
+    const auto sliceDto = dto::ArraySliceResponse::createShared();
+    sliceDto->elementType = static_cast<dto::VariableType>(slice.elementType);
+    sliceDto->elementSize = slice.elementSize;
+    sliceDto->beginIndex = slice.beginIndex;
+    sliceDto->arraySize = slice.arraySize;
+    sliceDto->data =
+            oatpp::encoding::Base64::encode(slice.data.data(), static_cast<v_buff_size>(slice.data.size()));
+    sliceDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    return createDtoResponse(Status::CODE_200, sliceDto);
+  }
+  ENDPOINT_INFO(ArraySlice)
+  {
+    info->description =
+            "Reads a range of an array of integers and/or floats as a packed buffer. If stackFrame is -1, path is "
+            "relative to the root table. With format=binary the raw bytes are returned as application/octet-stream, "
+            "and the slice properties are sent as X-Sdb-* headers.";
+    info->addResponse<Object<dto::ArraySliceResponse>>(Status::CODE_200, "application/json");
+
+    auto& beginIteratorParam = info->queryParams.add<UInt32>("beginIterator");
+    beginIteratorParam.required = false;
+    beginIteratorParam.description = "Index of the first element to read. Defaults to 0.";
+
+    auto& countParam = info->queryParams.add<UInt32>("count");
+    countParam.required = false;
+    countParam.description = "Maximum number of elements to read. Must be at most 1000000, which is the default.";
+
+    auto& formatParam = info->queryParams.add<String>("format");
+    formatParam.required = false;
+    formatParam.description = "Either 'base64' (default) or 'binary'.";
+
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT(
+          "GET", "Variables/Array/{stackFrame}/Statistics", ArrayStatistics, PATH(Int32, stackFrame),
+          QUERY(String, path), QUERIES(QueryParams, queryParams))
+  {
+    data::PaginationInfo range = {};
+    uint32_t histogramBinCount = 0;
+    const bool validParams =
+            ParseQueryParamWithDefault(queryParams, "beginIterator", 0U, range.beginIterator) &&
+            ParseQueryParamWithDefault(queryParams, "count", UINT32_MAX, range.count) &&
+            ParseQueryParamWithDefault(queryParams, "bins", 16U, histogramBinCount) &&
+            histogramBinCount <= kMaxHistogramBins;
+    if (!validParams) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    data::ArrayStatistics statistics;
+    const auto ret = messageCommandInterface_->GetArrayStatistics(
+            stackFrame, path->std_str(), range, histogramBinCount, statistics);
+    if (ret != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(ret);
+    }
+
+    const auto statisticsDto = dto::ArrayStatisticsResponse::createShared();
+    statisticsDto->arraySize = statistics.arraySize;
+    statisticsDto->count = statistics.count;
+    statisticsDto->nanCount = statistics.nanCount;
+    if (statistics.count > statistics.nanCount) {
+      statisticsDto->min = statistics.min;
+      statisticsDto->max = statistics.max;
+      statisticsDto->mean = statistics.mean;
+    }
+    statisticsDto->histogram = List<UInt32>::createShared();
+    for (const auto binCount : statistics.histogram) {
+      statisticsDto->histogram->push_back(binCount);
+    }
+    statisticsDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    return createDtoResponse(Status::CODE_200, statisticsDto);
+  }
+  ENDPOINT_INFO(ArrayStatistics)
+  {
+    info->description =
+            "Computes min, max, mean, NaN count and a histogram over a range of an array of integers and/or floats. "
+            "If stackFrame is -1, path is relative to the root table.";
+    info->addResponse<Object<dto::ArrayStatisticsResponse>>(Status::CODE_200, "application/json");
+
+    auto& beginIteratorParam = info->queryParams.add<UInt32>("beginIterator");
+    beginIteratorParam.required = false;
+    beginIteratorParam.description = "Index of the first element to include. Defaults to 0.";
+
+    auto& countParam = info->queryParams.add<UInt32>("count");
+    countParam.required = false;
+    countParam.description = "Maximum number of elements to include. Defaults to the whole array.";
+
+    auto& binsParam = info->queryParams.add<UInt32>("bins");
+    binsParam.required = false;
+    binsParam.description = "Number of histogram bins, spanning [min, max]. Defaults to 16, must be at most 1024.";
+
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT(
+          "GET", "Variables/Export/{stackFrame}", ExportVariable, PATH(Int32, stackFrame), QUERY(String, watch),
+          QUERIES(QueryParams, queryParams))
+  {
+    // Files are written by ExportVariableToFile; don't let a client think that one was.
+    data::ExportOptions options = {};
+    if (queryParams.get("file") != nullptr ||
+        !ParseExportParams(queryParams, kDefaultExportBodyBytes, kMaxExportBodyBytes, options))
+    {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    std::string body;
+    data::ExportResult result;
+    const auto ret = messageCommandInterface_->ExportVariable(
+            stackFrame, watch->std_str(), options,
+            [&body](const std::string_view chunk) {
+              body.append(chunk);
+              return true;
+            },
+            result);
+    if (ret != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(ret);
+    }
+
+    auto response = createResponse(Status::CODE_200, String(body.c_str(), static_cast<v_buff_size>(body.size()), true));
+    response->putHeader(Header::CONTENT_TYPE, "application/json");
+    response->putHeader("X-Sdb-Export-Nodes", std::to_string(result.nodeCount).c_str());
+    response->putHeader("X-Sdb-Export-Shared-References", std::to_string(result.sharedReferenceCount).c_str());
+    response->putHeader("X-Sdb-Export-Truncated", result.truncated ? "true" : "false");
+    return response;
+  }
+  ENDPOINT_INFO(ExportVariable)
+  {
+    info->description =
+            "Serializes the value of a watch expression, and everything reachable from it, to JSON in a single pass. "
+            "If stackFrame is -1, the expression is evaluated in the global scope. Containers that were already "
+            "written, including cycles, are written as {\"$ref\": \"<JSON pointer>\"}, and containers beyond "
+            "maxDepth as {\"$truncated\": true}. The JSON is returned as the body, with the export properties sent "
+            "as X-Sdb-Export-* headers. The body is built in memory before it is sent, so is limited to 16MiB; use "
+            "Variables/ExportFile for larger exports.";
+    info->addResponse<String>(Status::CODE_200, "application/json");
+
+    AddExportParams(info, "Export stops after roughly this many bytes. Defaults to 4MiB, must be at most 16MiB.");
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT(
+          "POST", "Variables/ExportFile/{stackFrame}", ExportVariableToFile, PATH(Int32, stackFrame),
+          QUERY(String, watch), QUERY(String, file), QUERIES(QueryParams, queryParams))
+  {
+    data::ExportOptions options = {};
+    std::filesystem::path path;
+    if (!ParseExportParams(queryParams, static_cast<uint32_t>(options.maxBytes), UINT32_MAX, options) ||
+        !ResolveExportFile(file->std_str(), path))
+    {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    // Create exclusive ("x"), so that an existing file is never overwritten
+    const std::unique_ptr<FILE, decltype(&std::fclose)> fileStream(
+            std::fopen(path.string().c_str(), "wbx"), &std::fclose);
+    if (fileStream == nullptr) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    data::ExportResult result;
+    const auto ret = messageCommandInterface_->ExportVariable(
+            stackFrame, watch->std_str(), options,
+            [&fileStream](const std::string_view chunk) {
+              return std::fwrite(chunk.data(), 1, chunk.size(), fileStream.get()) == chunk.size();
+            },
+            result);
+    if (ret != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(ret);
+    }
+
+    const auto exportDto = dto::ExportResponse::createShared();
+    exportDto->nodeCount = result.nodeCount;
+    exportDto->byteCount = result.byteCount;
+    exportDto->sharedReferenceCount = result.sharedReferenceCount;
+    exportDto->truncated = result.truncated;
+    exportDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    return createDtoResponse(Status::CODE_200, exportDto);
+  }
+  ENDPOINT_INFO(ExportVariableToFile)
+  {
+    info->description =
+            "As Variables/Export, but writes the JSON to a new file on the machine running the program and returns "
+            "the export properties. Only available if the program set an export directory when starting the "
+            "debugger.";
+    info->addResponse<Object<dto::ExportResponse>>(Status::CODE_200, "application/json");
+
+    info->queryParams["file"].description =
+            "Path of the file, relative to the export directory, which it must stay within. The file must not "
+            "already exist.";
+
+    AddExportParams(info, "Export stops after roughly this many bytes. Defaults to 64MiB.");
     AddCommandMessageErrorResponses(info);
   }
 
@@ -185,16 +539,8 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
 
     const auto varListDto = dto::ImmediateValueListResponse::createShared();
     varListDto->values = List<Object<dto::ImmediateValue>>::createShared();
-    for (const auto& [variable, scope, iteratorPath] : values)
-    {
-      auto valueDto = dto::ImmediateValue::createShared();
-      varListDto->values->push_back(valueDto);
-      valueDto->variable = CreateVariable(variable);
-      valueDto->variableScope = static_cast<dto::VariableScope>(scope);
-      valueDto->iteratorPath = List<UInt32>::createShared();
-      for (const auto iterator : iteratorPath) {
-        valueDto->iteratorPath->push_back(iterator);
-      }
+    for (const auto& value : values) {
+      varListDto->values->push_back(CreateImmediateValue(value));
     }
 
     varListDto->code = static_cast<int32_t>(data::ReturnCode::Success);
@@ -208,11 +554,199 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
     AddCommandMessageErrorResponses(info);
   }
 
+  ENDPOINT("PUT", "PauseBundle", SetPauseBundle, BODY_DTO(Object<dto::PauseBundleConfig>, configDto))
+  {
+    data::PauseBundleConfig config;
+    if (configDto->enabled != nullptr) {
+      config.enabled = *configDto->enabled;
+    }
+    if (configDto->localsCount != nullptr) {
+      config.localsCount = *configDto->localsCount;
+    }
+    if (configDto->globalsCount != nullptr) {
+      config.globalsCount = *configDto->globalsCount;
+    }
+    if (config.localsCount > 1000U || config.globalsCount > 1000U) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+    return CreateReturnCodeResponse(messageCommandInterface_->SetPauseBundleConfig(config));
+  }
+  ENDPOINT_INFO(SetPauseBundle)
+  {
+    info->description =
+            "Configures the pause_bundle event, which is sent after each status event that has a paused runstate. "
+            "localsCount and globalsCount must be at most 1000.";
+    info->addConsumes<Object<dto::PauseBundleConfig>>("application/json");
+    AddCommandMessageResponse(info);
+  }
+
+  ENDPOINT("POST", "Watches", AddWatch, BODY_DTO(Object<dto::AddWatchRequest>, addWatchRequest))
+  {
+    if (addWatchRequest->watch == nullptr) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    uint64_t watchId = 0;
+    const auto rc = messageCommandInterface_->AddWatch(addWatchRequest->watch->std_str(), watchId);
+    if (rc != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(rc);
+    }
+
+    const auto addWatchDto = dto::AddWatchResponse::createShared();
+    addWatchDto->id = watchId;
+    addWatchDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    return createDtoResponse(Status::CODE_200, addWatchDto);
+  }
+  ENDPOINT_INFO(AddWatch)
+  {
+    info->description =
+            "Registers a watch expression. Registered watches are evaluated in the scope of the top stack frame each "
+            "time the program pauses, and the results are sent in the watches field of the status event.";
+    info->addConsumes<Object<dto::AddWatchRequest>>("application/json");
+    info->addResponse<Object<dto::AddWatchResponse>>(Status::CODE_200, "application/json");
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT("DELETE", "Watches/{watchId}", RemoveWatch, PATH(UInt64, watchId))
+  {
+    return CreateReturnCodeResponse(messageCommandInterface_->RemoveWatch(watchId));
+  }
+  ENDPOINT_INFO(RemoveWatch)
+  {
+    info->pathParams.add<UInt64>("watchId").description = "ID that was returned when the watch was added.";
+    AddCommandMessageResponse(info);
+  }
+
+  ENDPOINT(
+          "POST", "DataBreakpoints", AddDataBreakpoint,
+          BODY_DTO(Object<dto::AddDataBreakpointRequest>, addDataBreakpointRequest))
+  {
+    if (addDataBreakpointRequest->watch == nullptr || addDataBreakpointRequest->stackFrame == nullptr) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
+    uint64_t dataBreakpointId = 0;
+    const auto rc = messageCommandInterface_->AddDataBreakpoint(
+            addDataBreakpointRequest->stackFrame, addDataBreakpointRequest->watch->std_str(), dataBreakpointId);
+    if (rc != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(rc);
+    }
+
+    const auto addDataBreakpointDto = dto::AddDataBreakpointResponse::createShared();
+    addDataBreakpointDto->id = dataBreakpointId;
+    addDataBreakpointDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    return createDtoResponse(Status::CODE_200, addDataBreakpointDto);
+  }
+  ENDPOINT_INFO(AddDataBreakpoint)
+  {
+    info->description =
+            "Pauses the program when the value of a table slot, array element or instance field changes. The watch "
+            "must be a path ending in an accessor, and is resolved once in the given stack frame (-1 for globals). "
+            "Can only be called while paused. The status event's pausedAtDataBreakpointId is set when it triggers.";
+    info->addConsumes<Object<dto::AddDataBreakpointRequest>>("application/json");
+    info->addResponse<Object<dto::AddDataBreakpointResponse>>(Status::CODE_200, "application/json");
+    AddCommandMessageErrorResponses(info);
+  }
+
+  ENDPOINT("DELETE", "DataBreakpoints/{dataBreakpointId}", RemoveDataBreakpoint, PATH(UInt64, dataBreakpointId))
+  {
+    return CreateReturnCodeResponse(messageCommandInterface_->RemoveDataBreakpoint(dataBreakpointId));
+  }
+  ENDPOINT_INFO(RemoveDataBreakpoint)
+  {
+    info->pathParams.add<UInt64>("dataBreakpointId").description =
+            "ID that was returned when the data breakpoint was added.";
+    AddCommandMessageResponse(info);
+  }
+
+  ENDPOINT("GET", "Output/Counters", OutputCounters)
+  {
+    const auto countersDto = dto::OutputCountersResponse::createShared();
+    countersDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    countersDto->sources = List<Object<dto::OutputSourceCounters>>::createShared();
+    for (const auto& counters : outputChannel_->GetCounters()) {
+      const auto sourceDto = dto::OutputSourceCounters::createShared();
+      sourceDto->file = String(counters.fileName.c_str(), static_cast<v_buff_size>(counters.fileName.size()), true);
+      sourceDto->isErr = counters.isErr;
+      sourceDto->lineCount = counters.lineCount;
+      sourceDto->byteCount = counters.byteCount;
+      sourceDto->droppedLineCount = counters.droppedLineCount;
+      countersDto->sources->push_back(sourceDto);
+    }
+    return createDtoResponse(Status::CODE_200, countersDto);
+  }
+  ENDPOINT_INFO(OutputCounters)
+  {
+    info->description =
+            "Totals of the output written by the script since the server started, per file and stream. Output is sent "
+            "in output_lines events; droppedLineCount counts lines that were written faster than they could be sent.";
+    info->addResponse<Object<dto::OutputCountersResponse>>(Status::CODE_200, "application/json");
+  }
+
+  ENDPOINT("GET", "Output/History", SearchOutputHistory, QUERIES(QueryParams, queryParams))
+  {
+    OutputHistory::Query query;
+    if (!ParseOutputHistoryQuery(queryParams, query)) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+    const auto result = outputHistory_->Find(query);
+
+    const auto historyDto = dto::OutputHistoryResponse::createShared();
+    historyDto->code = static_cast<int32_t>(data::ReturnCode::Success);
+    historyDto->lines = List<Object<dto::OutputHistoryLine>>::createShared();
+    for (const auto& record : result.records) {
+      const auto lineDto = dto::OutputHistoryLine::createShared();
+      lineDto->sequence = record.sequence;
+      lineDto->output = String(record.line.output.c_str(), static_cast<v_buff_size>(record.line.output.size()), true);
+      lineDto->isErr = record.line.isErr;
+      lineDto->file =
+              String(record.line.fileName.c_str(), static_cast<v_buff_size>(record.line.fileName.size()), true);
+      lineDto->line = record.line.line;
+      historyDto->lines->push_back(lineDto);
+    }
+    historyDto->firstSequence = result.firstSequence;
+    historyDto->nextSequence = result.nextSequence;
+    return createDtoResponse(Status::CODE_200, historyDto);
+  }
+  ENDPOINT_INFO(SearchOutputHistory)
+  {
+    info->description =
+            "Searches the most recent output of the script, oldest first. Each line has the sequence number it was "
+            "sent with in output_lines events, so a client that connects late can fetch what it missed.";
+    info->addResponse<Object<dto::OutputHistoryResponse>>(Status::CODE_200, "application/json");
+    AddCommandMessageErrorResponses(info);
+
+    auto& beginParam = info->queryParams.add<UInt64>("begin");
+    beginParam.required = false;
+    beginParam.description = "Sequence number of the first line to return. Defaults to the oldest line held.";
+
+    auto& endParam = info->queryParams.add<UInt64>("end");
+    endParam.required = false;
+    endParam.description = "Sequence number to stop before.";
+
+    auto& countParam = info->queryParams.add<UInt32>("count");
+    countParam.required = false;
+    countParam.description = "Maximum number of lines to return. Defaults to 1000, and must be at most 10000.";
+
+    auto& fileParam = info->queryParams.add<String>("file");
+    fileParam.required = false;
+    fileParam.description = "Only return lines written by this file.";
+
+    auto& isErrParam = info->queryParams.add<String>("isErr");
+    isErrParam.required = false;
+    isErrParam.description = "true to only return lines written to stderr, false for stdout.";
+
+    auto& containsParam = info->queryParams.add<String>("contains");
+    containsParam.required = false;
+    containsParam.description = "Only return lines containing this text.";
+  }
+
   ENDPOINT("PUT", "FileBreakpoints", FileBreakpoints, BODY_DTO(Object<dto::SetFileBreakpointsRequest>, createBpRequest))
   {
     std::vector<data::CreateBreakpoint> bpList;
     for (const auto& bpDto : *createBpRequest->breakpoints) {
-      bpList.emplace_back(data::CreateBreakpoint{bpDto->id, bpDto->line});
+      bpList.emplace_back(data::CreateBreakpoint{
+              bpDto->id, bpDto->line, bpDto->condition != nullptr ? bpDto->condition->std_str() : std::string()});
     }
 
     std::vector<data::ResolvedBreakpoint> resolvedBpList;
@@ -242,6 +776,93 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
     AddCommandMessageErrorResponses(info);
   }
 
+  // Conversions from data to dto types, also used when sending events.
+  [[nodiscard]] static List<Object<dto::Variable>> CreateVariablesList(const std::vector<data::Variable>& variables)
+  {
+    auto variablesDto = List<Object<dto::Variable>>::createShared();
+    for (const auto& variable : variables) {
+      variablesDto->push_back(CreateVariable(variable));
+    }
+    return variablesDto;
+  }
+
+  [[nodiscard]] static Object<dto::Variable> CreateVariable(const data::Variable& variable)
+  {
+    auto variableDto = dto::Variable::createShared();
+    variableDto->pathIterator = variable.pathIterator;
+    variableDto->pathUiString =
+            String(variable.pathUiString.c_str(), static_cast<v_buff_size>(variable.pathUiString.size()), false);
+    variableDto->pathTableKeyType = static_cast<dto::VariableType>(variable.pathTableKeyType);
+    variableDto->valueType = static_cast<dto::VariableType>(variable.valueType);
+    variableDto->value = String(variable.value.c_str(), static_cast<v_buff_size>(variable.value.size()), false);
+    variableDto->valueRawAddress = variable.valueRawAddress;
+    variableDto->childCount = variable.childCount;
+    variableDto->instanceClassName = String(
+            variable.instanceClassName.c_str(), static_cast<v_buff_size>(variable.instanceClassName.size()), false);
+    variableDto->editable = variable.editable;
+    variableDto->parentIndex = variable.parentIndex;
+    return variableDto;
+  }
+
+  [[nodiscard]] static Object<dto::ImmediateValue> CreateImmediateValue(const data::ImmediateValue& value)
+  {
+    auto valueDto = dto::ImmediateValue::createShared();
+    valueDto->variable = CreateVariable(value.variable);
+    valueDto->variableScope = static_cast<dto::VariableScope>(value.scope);
+    valueDto->iteratorPath = List<UInt32>::createShared();
+    for (const auto iterator : value.iteratorPath) {
+      valueDto->iteratorPath->push_back(iterator);
+    }
+    return valueDto;
+  }
+
+  [[nodiscard]] static Object<dto::StackEntry> CreateStackEntry(const data::StackEntry& stackEntry)
+  {
+    const auto stackEntryDto = dto::StackEntry::createShared();
+    stackEntryDto->file = stackEntry.file.c_str();
+    stackEntryDto->line = stackEntry.line;
+    stackEntryDto->function = stackEntry.function.c_str();
+    return stackEntryDto;
+  }
+
+  [[nodiscard]] static Object<dto::WatchResult> CreateWatchResult(const data::WatchResult& watchResult)
+  {
+    auto watchResultDto = dto::WatchResult::createShared();
+    watchResultDto->id = watchResult.id;
+    watchResultDto->watch =
+            String(watchResult.watch.c_str(), static_cast<v_buff_size>(watchResult.watch.size()), false);
+    watchResultDto->code = static_cast<int32_t>(watchResult.code);
+    if (watchResult.code == data::ReturnCode::Success) {
+      watchResultDto->value = CreateImmediateValue(watchResult.value);
+    }
+    return watchResultDto;
+  }
+
+  // Cursors are sent as hex strings, so that clients treat them as opaque tokens rather than numbers.
+  // An empty string is a valid cursor of 0, meaning there is no cursor.
+  [[nodiscard]] static bool ParseCursor(const std::string& cursorStr, uint64_t& cursor)
+  {
+    if (cursorStr.empty()) {
+      cursor = 0;
+      return true;
+    }
+
+    std::stringstream ss(cursorStr);
+    ss >> std::hex >> cursor;
+    return !ss.fail() && ss.eof() && cursor != 0;
+  }
+
+  // Empty if there is no next page
+  [[nodiscard]] static std::string FormatCursor(const uint64_t cursor)
+  {
+    if (cursor == 0) {
+      return {};
+    }
+    std::stringstream ss;
+    ss << std::hex << cursor;
+    return ss.str();
+  }
+
  private:
   static void AddCommandMessageResponse(const std::shared_ptr<Endpoint::Info>& info)
   {
@@ -253,6 +874,15 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
     info->addResponse<Object<dto::CommandMessageResponse>>(Status::CODE_400, "application/json");
     info->addResponse<Object<dto::CommandMessageResponse>>(Status::CODE_500, "application/json");
   }
+  static void AddCommandMessageETagParams(const std::shared_ptr<Endpoint::Info>& info)
+  {
+    auto& ifNoneMatchParam = info->headers.add<String>("If-None-Match");
+    ifNoneMatchParam.required = false;
+    ifNoneMatchParam.description =
+            "ETag of an earlier response. Responses only change once the program resumes, or a variable is edited; "
+            "until then, 304 Not Modified is returned instead.";
+    info->addResponse<String>(Status::CODE_304, "text/plain");
+  }
   static void AddCommandMessagePaginationParams(const std::shared_ptr<Endpoint::Info>& info)
   {
     auto& beginIteratorParam = info->queryParams.add<UInt32>("beginIterator");
@@ -263,9 +893,81 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
     countParam.required = false;
     countParam.description = "Count of items for pagination. Count must be at most 1000.";
   }
+  static void AddCommandMessageCursorParam(const std::shared_ptr<Endpoint::Info>& info)
+  {
+    auto& cursorParam = info->queryParams.add<String>("cursor");
+    cursorParam.required = false;
+    cursorParam.description =
+            "nextCursor from the previous page of the same request. When given, beginIterator is ignored and the "
+            "listing resumes where the previous page ended. Cursors expire when the program resumes.";
+  }
+  static void AddCommandMessageStreamParam(const std::shared_ptr<Endpoint::Info>& info)
+  {
+    auto& formatParam = info->queryParams.add<String>("format");
+    formatParam.required = false;
+    formatParam.description =
+            "Set to 'ndjson' to stream every matching variable, one JSON object per line, rather than returning a "
+            "single page. count then limits the total, and defaults to no limit. parentIndex refers to a line of the "
+            "stream. The last line is {\"code\":N}; any other code than 0 means that the listing is incomplete. Not "
+            "available when the server serves connections asynchronously.";
+  }
+  static void AddCommandMessageExpansionParams(const std::shared_ptr<Endpoint::Info>& info)
+  {
+    auto& depthParam = info->queryParams.add<UInt32>("depth");
+    depthParam.required = false;
+    depthParam.description =
+            "Number of levels of children to recursively expand, returned as a flattened tree (see parentIndex). "
+            "Defaults to 0, which returns only direct children. Must be at most 16.";
+
+    auto& maxNodesParam = info->queryParams.add<UInt32>("maxNodes");
+    maxNodesParam.required = false;
+    maxNodesParam.description =
+            "Maximum number of variables returned across all expanded levels. Defaults to 1000, must be at most 10000.";
+
+    auto& summaryParam = info->queryParams.add<String>("summary");
+    summaryParam.required = false;
+    summaryParam.description =
+            "How the value of tables and instances is summarized: 'sorted' (default), 'first' for the first "
+            "summaryFields fields in iteration order, or 'none' to leave the value empty. Empty values can be fetched "
+            "individually via Variables/Local/{stackFrame}/Value or Variables/Global/Value.";
+
+    auto& summaryFieldsParam = info->queryParams.add<UInt32>("summaryFields");
+    summaryFieldsParam.required = false;
+    summaryFieldsParam.description = "Maximum number of fields in each summary when summary=first. Defaults to 4.";
+
+    auto& summaryBytesParam = info->queryParams.add<UInt32>("summaryBytes");
+    summaryBytesParam.required = false;
+    summaryBytesParam.description =
+            "Total length of summaries built for the request, plus 8 bytes for each key read to build them. Once "
+            "used up, remaining summaries are left empty. Defaults to 16384.";
+  }
+  static void AddCommandMessageFilterParams(const std::shared_ptr<Endpoint::Info>& info)
+  {
+    auto& keyParam = info->queryParams.add<String>("filterKey");
+    keyParam.required = false;
+    keyParam.description =
+            "Only return children whose key contains this string, or matches it if it contains * or ? wildcards. "
+            "Case insensitive. When filtering, count is the number of matching children to return.";
+
+    auto& typeParam = info->queryParams.add<String>("filterType");
+    typeParam.required = false;
+    typeParam.description = "Only return children whose value has one of these types, separated by commas.";
+
+    auto& opParam = info->queryParams.add<String>("filterOp");
+    opParam.required = false;
+    opParam.description =
+            "Only return children whose value compares to filterValue using this operator: eq, ne, lt, gt or "
+            "contains. Numbers are compared numerically, strings lexicographically.";
 
+    auto& valueParam = info->queryParams.add<String>("filterValue");
+    valueParam.required = false;
+    valueParam.description = "Value to compare against when filterOp is set.";
+  }
+
+  template<typename TValue>
   [[nodiscard]] static bool ParseQueryParamWithDefault(
-          const QueryParams& queryParams, const char* name, const uint32_t defaultValue, uint32_t& parsedValue)
+          const QueryParams& queryParams, const char* name, const std::common_type_t<TValue> defaultValue,
+          TValue& parsedValue)
   {
     const auto paramValueStr = queryParams.get(name);
     if (paramValueStr == nullptr || paramValueStr->getSize() == 0) {
@@ -278,52 +980,265 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
     return !ss.fail();
   }
 
-  [[nodiscard]] std::shared_ptr<OutgoingResponse>
-  HandleVariablesCommandMessage(const QueryParams& queryParams, const VariablesCallback& getVariablesFn) const
+  [[nodiscard]] static bool ParseOutputHistoryQuery(const QueryParams& queryParams, OutputHistory::Query& query)
   {
+    if (!ParseQueryParamWithDefault(queryParams, "begin", query.beginSequence, query.beginSequence) ||
+        !ParseQueryParamWithDefault(queryParams, "end", query.endSequence, query.endSequence) ||
+        !ParseQueryParamWithDefault(queryParams, "count", query.maxCount, query.maxCount) ||
+        query.maxCount > kMaxOutputHistoryCount)
+    {
+      return false;
+    }
+
+    if (const auto fileStr = queryParams.get("file"); fileStr != nullptr) {
+      query.fileName = fileStr->std_str();
+    }
+    if (const auto isErrStr = queryParams.get("isErr"); isErrStr != nullptr) {
+      const auto isErr = isErrStr->std_str();
+      if (isErr != "true" && isErr != "false") {
+        return false;
+      }
+      query.isErr = isErr == "true";
+    }
+    if (const auto containsStr = queryParams.get("contains"); containsStr != nullptr) {
+      query.contains = containsStr->std_str();
+    }
+    return true;
+  }
+
+  [[nodiscard]] static bool ParseCursorParam(const QueryParams& queryParams, uint64_t& cursor)
+  {
+    const auto paramValueStr = queryParams.get("cursor");
+    return ParseCursor(paramValueStr == nullptr ? std::string() : paramValueStr->std_str(), cursor);
+  }
+
+  [[nodiscard]] static const char* ToElementTypeName(const data::VariableType elementType)
+  {
+    return VariableListWriter::ToVariableTypeName(elementType);
+  }
+
+  [[nodiscard]] static bool ParseExportParams(
+          const QueryParams& queryParams, const uint32_t defaultMaxBytes, const uint32_t maxMaxBytes,
+          data::ExportOptions& options)
+  {
+    uint32_t maxBytes = 0;
+    const bool validParams =
+            ParseQueryParamWithDefault(queryParams, "maxDepth", options.maxDepth, options.maxDepth) &&
+            ParseQueryParamWithDefault(queryParams, "maxNodes", options.maxNodes, options.maxNodes) &&
+            ParseQueryParamWithDefault(queryParams, "maxBytes", defaultMaxBytes, maxBytes) &&
+            options.maxDepth <= kMaxExportDepth && maxBytes <= maxMaxBytes;
+    options.maxBytes = maxBytes;
+    return validParams;
+  }
+
+  static void AddExportParams(const std::shared_ptr<Endpoint::Info>& info, const char* maxBytesDescription)
+  {
+    auto& maxDepthParam = info->queryParams.add<UInt32>("maxDepth");
+    maxDepthParam.required = false;
+    maxDepthParam.description = "Maximum depth of nested containers. Defaults to 32, must be at most 256.";
+
+    auto& maxNodesParam = info->queryParams.add<UInt32>("maxNodes");
+    maxNodesParam.required = false;
+    maxNodesParam.description = "Maximum number of values to write. Defaults to 100000.";
+
+    auto& maxBytesParam = info->queryParams.add<UInt32>("maxBytes");
+    maxBytesParam.required = false;
+    maxBytesParam.description = maxBytesDescription;
+  }
+
+  // Resolves a file within the export directory. Symlinks and .. are resolved before checking that it stays within
+  // the directory. Returns false if there is no export directory.
+  [[nodiscard]] bool ResolveExportFile(const std::string& file, std::filesystem::path& path) const
+  {
+    if (exportDirectory_.empty() || file.empty()) {
+      return false;
+    }
+
+    std::error_code ec;
+    const auto directory = std::filesystem::weakly_canonical(exportDirectory_, ec);
+    if (ec) {
+      return false;
+    }
+    path = std::filesystem::weakly_canonical(directory / file, ec);
+    if (ec) {
+      return false;
+    }
+
+    const auto [directoryEnd, pathEnd] = std::mismatch(directory.begin(), directory.end(), path.begin(), path.end());
+    return directoryEnd == directory.end() && pathEnd != path.end();
+  }
+
+  [[nodiscard]] static bool ParseFilterParams(const QueryParams& queryParams, data::VariableFilter& filter)
+  {
+    const auto readParam = [&queryParams](const char* name) {
+      const auto paramValueStr = queryParams.get(name);
+      return paramValueStr == nullptr ? std::string() : paramValueStr->std_str();
+    };
+
+    filter.keyPattern = readParam("filterKey");
+
+    // Comma separated list of type names
+    std::stringstream typesSs(readParam("filterType"));
+    std::string typeName;
+    const auto& typeNames = VariableListWriter::kVariableTypeNames;
+    while (std::getline(typesSs, typeName, ',')) {
+      const auto typePos = std::find(typeNames.begin(), typeNames.end(), typeName);
+      if (typePos == typeNames.end()) {
+        return false;
+      }
+      filter.valueTypes.push_back(static_cast<data::VariableType>(typePos - typeNames.begin()));
+    }
+
+    const auto op = readParam("filterOp");
+    if (op.empty()) {
+      filter.valueOperator = data::FilterOperator::None;
+    }
+    else if (op == "eq") {
+      filter.valueOperator = data::FilterOperator::Equal;
+    }
+    else if (op == "ne") {
+      filter.valueOperator = data::FilterOperator::NotEqual;
+    }
+    else if (op == "lt") {
+      filter.valueOperator = data::FilterOperator::Less;
+    }
+    else if (op == "gt") {
+      filter.valueOperator = data::FilterOperator::Greater;
+    }
+    else if (op == "contains") {
+      filter.valueOperator = data::FilterOperator::Contains;
+    }
+    else {
+      return false;
+    }
+    filter.value = readParam("filterValue");
+    return true;
+  }
+
+  [[nodiscard]] static bool ParseSummaryModeParam(const QueryParams& queryParams, data::SummaryMode& summaryMode)
+  {
+    const auto paramValueStr = queryParams.get("summary");
+    const auto paramValue = paramValueStr == nullptr ? std::string() : paramValueStr->std_str();
+    if (paramValue.empty() || paramValue == "sorted") {
+      summaryMode = data::SummaryMode::Sorted;
+    }
+    else if (paramValue == "first") {
+      summaryMode = data::SummaryMode::FirstFields;
+    }
+    else if (paramValue == "none") {
+      summaryMode = data::SummaryMode::None;
+    }
+    else {
+      return false;
+    }
+    return true;
+  }
+
+  [[nodiscard]] std::shared_ptr<OutgoingResponse> HandleVariablesCommandMessage(
+          const std::shared_ptr<IncomingRequest>& request, const QueryParams& queryParams,
+          const VariablesCallback& getVariablesFn) const
+  {
+    const auto formatStr = queryParams.get("format");
+    const auto format = formatStr == nullptr ? std::string() : formatStr->std_str();
+    const bool isStream = format == "ndjson";
+    if ((!format.empty() && !isStream) || (isStream && isAsync_)) {
+      return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
+    }
+
     data::PaginationInfo pagination = {};
+    data::VariableQueryOptions options = {};
+    const auto defaultCount = isStream ? UINT32_MAX : 100U;
     const bool validParams = ParseQueryParamWithDefault(queryParams, "beginIterator", 0U, pagination.beginIterator) &&
-                             ParseQueryParamWithDefault(queryParams, "count", 100U, pagination.count) &&
-                             pagination.count <= 1000U;
-    if (!validParams) {
+                             ParseQueryParamWithDefault(queryParams, "count", defaultCount, pagination.count) &&
+                             (isStream || pagination.count <= 1000U) &&
+                             ParseQueryParamWithDefault(queryParams, "depth", 0U, options.expandDepth) &&
+                             ParseQueryParamWithDefault(queryParams, "maxNodes", 1000U, options.maxNodes) &&
+                             options.expandDepth <= kMaxExpandDepth && options.maxNodes <= kMaxExpandNodes;
+    const bool validSummaryParams =
+            ParseSummaryModeParam(queryParams, options.summaryMode) &&
+            ParseQueryParamWithDefault(queryParams, "summaryFields", 4U, options.summaryFieldCount) &&
+            ParseQueryParamWithDefault(queryParams, "summaryBytes", 16384U, options.summaryBudgetBytes);
+    if (!validParams || !validSummaryParams || !ParseFilterParams(queryParams, options.filter) ||
+        !ParseCursorParam(queryParams, pagination.cursor)) {
       return CreateReturnCodeResponse(data::ReturnCode::InvalidParameter);
     }
 
-    const auto [ret, variables] = getVariablesFn(pagination);
+    // Reading the same variables gives the same result until the program resumes, or a value is edited, so while
+    // paused responses are tagged with (and cached by) the pause epoch. The request's URI includes all the params.
+    uint32_t pauseEpoch = 0;
+    const bool isPaused = messageCommandInterface_->GetPauseEpoch(pauseEpoch) == data::ReturnCode::Success;
+    const auto version = isPaused ? responseCache_->GetVersion(pauseEpoch) : 0U;
+    const auto etag = isPaused ? ResponseCache::FormatETag(version) : std::string();
+    const auto cacheKey = request->getStartingLine().path.std_str();
+    if (isPaused) {
+      const auto ifNoneMatch = request->getHeader("If-None-Match");
+      if (ifNoneMatch != nullptr && ResponseCache::IsETagMatch(ifNoneMatch->std_str(), etag)) {
+        auto response = OutgoingResponse::createShared(Status::CODE_304, nullptr);
+        response->putHeader("ETag", etag.c_str());
+        return response;
+      }
+
+      if (!isStream) {
+        const auto cachedBody = responseCache_->Find(version, cacheKey);
+        if (cachedBody != nullptr) {
+          return CreateJsonResponse(cachedBody, etag);
+        }
+      }
+    }
+
+    if (isStream) {
+      // The body has no known size, so is sent with chunked transfer encoding.
+      const auto body = std::make_shared<oatpp::web::protocol::http::outgoing::StreamingBody>(
+              std::make_shared<VariableStreamCallback>(getVariablesFn, pagination, options, pagination.count));
+      auto response = OutgoingResponse::createShared(Status::CODE_200, body);
+      response->putHeader(Header::CONTENT_TYPE, "application/x-ndjson");
+      if (isPaused) {
+        response->putHeader("ETag", etag.c_str());
+      }
+      return response;
+    }
+
+    const auto [ret, variables, nextCursor] = getVariablesFn(pagination, options);
     if (ret != data::ReturnCode::Success) {
       return CreateReturnCodeResponse(ret);
     }
 
-    const auto varListDto = dto::VariableListResponse::createShared();
-    varListDto->variables = CreateVariablesList(variables);
-    varListDto->code = static_cast<int32_t>(data::ReturnCode::Success);
-    return createDtoResponse(Status::CODE_200, varListDto);
+    const auto body = VariableListWriter::Write(
+            static_cast<int32_t>(data::ReturnCode::Success), variables, FormatCursor(nextCursor));
+    if (isPaused) {
+      responseCache_->Insert(version, cacheKey, body);
+    }
+    return CreateJsonResponse(body, etag);
   }
 
-  [[nodiscard]] static List<Object<dto::Variable>> CreateVariablesList(const std::vector<data::Variable>& variables)
+  [[nodiscard]] std::shared_ptr<OutgoingResponse>
+  CreateVariableListResponse(const data::ReturnCode ret, const std::vector<data::Variable>& variables) const
   {
-    auto variablesDto = List<Object<dto::Variable>>::createShared();
-    for (const auto& variable : variables) {
-      variablesDto->push_back(CreateVariable(variable));
+    if (ret != data::ReturnCode::Success) {
+      return CreateReturnCodeResponse(ret);
     }
-    return variablesDto;
+
+    return CreateVariableListJsonResponse(variables, {});
   }
 
-  [[nodiscard]] static Object<dto::Variable> CreateVariable(const data::Variable& variable)
+  // Variable pages can be large, so are serialized directly rather than via dto::VariableListResponse.
+  [[nodiscard]] std::shared_ptr<OutgoingResponse>
+  CreateVariableListJsonResponse(const std::vector<data::Variable>& variables, const std::string_view nextCursor) const
   {
-    auto variableDto = dto::Variable::createShared();
-    variableDto->pathIterator = variable.pathIterator;
-    variableDto->pathUiString =
-            String(variable.pathUiString.c_str(), static_cast<v_buff_size>(variable.pathUiString.size()), false);
-    variableDto->pathTableKeyType = static_cast<dto::VariableType>(variable.pathTableKeyType);
-    variableDto->valueType = static_cast<dto::VariableType>(variable.valueType);
-    variableDto->value = String(variable.value.c_str(), static_cast<v_buff_size>(variable.value.size()), false);
-    variableDto->valueRawAddress = variable.valueRawAddress;
-    variableDto->childCount = variable.childCount;
-    variableDto->instanceClassName = String(
-            variable.instanceClassName.c_str(), static_cast<v_buff_size>(variable.instanceClassName.size()), false);
-    variableDto->editable = variable.editable;
-    return variableDto;
+    return CreateJsonResponse(
+            VariableListWriter::Write(static_cast<int32_t>(data::ReturnCode::Success), variables, nextCursor), {});
+  }
+
+  // The ETag header is left out if etag is empty.
+  [[nodiscard]] std::shared_ptr<OutgoingResponse>
+  CreateJsonResponse(const oatpp::String& body, const std::string& etag) const
+  {
+    auto response = createResponse(Status::CODE_200, body);
+    response->putHeader(Header::CONTENT_TYPE, "application/json");
+    if (!etag.empty()) {
+      response->putHeader("ETag", etag.c_str());
+    }
+    return response;
   }
 
   [[nodiscard]] std::shared_ptr<OutgoingResponse> CreateCommandOkResponse() const
@@ -347,7 +1262,14 @@ class DebugCommandController final : public oatpp::web::server::api::ApiControll
   }
 
   const std::shared_ptr<MessageCommandInterface> messageCommandInterface_;
+  const std::shared_ptr<OutputChannel> outputChannel_;
+  const std::shared_ptr<OutputHistory> outputHistory_;
   const std::shared_ptr<OutgoingResponse> commandOkResponse_;
+  // Exports may only be written to files within this directory; none can be if it's empty.
+  const std::filesystem::path exportDirectory_;
+  // Streamed listings aren't allowed in Async mode, as their pages would be read on the executor threads.
+  const bool isAsync_;
+  const std::shared_ptr<ResponseCache> responseCache_ = std::make_shared<ResponseCache>();
 };
 }// namespace sdb
 
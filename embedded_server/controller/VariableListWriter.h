@@ -0,0 +1,154 @@
+#pragma once
+
+#ifndef SDB_VARIABLE_LIST_WRITER_H
+#define SDB_VARIABLE_LIST_WRITER_H
+
+#include <sdb/JsonString.h>
+#include <sdb/MessageInterface.h>
+
+#include <oatpp/core/Types.hpp>
+
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sdb {
+
+// Serializes a dto::VariableListResponse straight from data::Variables, rather than building a dto::Variable (and a
+// wrapper object per field) for each one and passing them to the ObjectMapper.
+// The output is measured first and then written into a single buffer of exactly that size, so the body of a page costs
+// one allocation however many variables it holds, and the strings read during the VM walk are copied only once.
+// Field names and enum values match those of the DTOs, so clients can't tell which path produced a response.
+class VariableListWriter {
+ public:
+  static constexpr std::array<const char*, 18> kVariableTypeNames = {
+          "null",          "integer",   "float",       "bool",   "string",    "table", "array",    "userdata", "closure",
+          "nativeclosure", "generator", "userpointer", "thread", "funcproto", "class", "instance", "weakref",  "outer",
+  };
+
+  // nextCursor is written as null if it is empty.
+  [[nodiscard]] static oatpp::String Write(
+          const int32_t code, const std::vector<data::Variable>& variables, const std::string_view nextCursor)
+  {
+    CountingSink counter;
+    WriteResponse(counter, code, variables, nextCursor);
+
+    oatpp::String body(static_cast<v_buff_size>(counter.size));
+    BufferSink writer{reinterpret_cast<char*>(body->getData())};
+    WriteResponse(writer, code, variables, nextCursor);
+    return body;
+  }
+
+  // Appends one line per variable, for newline delimited JSON streams. parentIndex is offset by lineOffset, so that it
+  // refers to a line of the whole stream rather than to a variable of this page.
+  static void AppendLines(const std::vector<data::Variable>& variables, const int32_t lineOffset, std::string& out)
+  {
+    StringSink sink{out};
+    for (const auto& variable : variables) {
+      WriteVariable(sink, variable, lineOffset);
+      sink.Put('\n');
+    }
+  }
+
+  // The last line of a newline delimited JSON stream, which tells the client whether the listing is complete.
+  static void AppendEndLine(const int32_t code, std::string& out)
+  {
+    StringSink sink{out};
+    sink.Put("{\"code\":");
+    WriteInteger(sink, code);
+    sink.Put("}\n");
+  }
+
+  [[nodiscard]] static const char* ToVariableTypeName(const data::VariableType type)
+  {
+    return kVariableTypeNames.at(static_cast<size_t>(type));
+  }
+
+ private:
+  struct CountingSink {
+    void Put(const char) { ++size; }
+    void Put(const std::string_view str) { size += str.size(); }
+    size_t size = 0;
+  };
+
+  struct BufferSink {
+    void Put(const char c) { *pos++ = c; }
+    void Put(const std::string_view str)
+    {
+      std::memcpy(pos, str.data(), str.size());
+      pos += str.size();
+    }
+    char* pos;
+  };
+
+  struct StringSink {
+    void Put(const char c) { str.push_back(c); }
+    void Put(const std::string_view value) { str.append(value); }
+    std::string& str;
+  };
+
+  template<typename TSink>
+  static void WriteResponse(
+          TSink& sink, const int32_t code, const std::vector<data::Variable>& variables,
+          const std::string_view nextCursor)
+  {
+    sink.Put("{\"code\":");
+    WriteInteger(sink, code);
+    sink.Put(",\"variables\":[");
+    for (size_t i = 0; i < variables.size(); ++i) {
+      if (i != 0) {
+        sink.Put(',');
+      }
+      WriteVariable(sink, variables[i], 0);
+    }
+    sink.Put("],\"nextCursor\":");
+    if (nextCursor.empty()) {
+      sink.Put("null");
+    }
+    else {
+      json::WriteString(sink, nextCursor);
+    }
+    sink.Put('}');
+  }
+
+  template<typename TSink>
+  static void WriteVariable(TSink& sink, const data::Variable& variable, const int32_t parentIndexOffset)
+  {
+    sink.Put("{\"pathIterator\":");
+    WriteInteger(sink, variable.pathIterator);
+    sink.Put(",\"pathUiString\":");
+    json::WriteString(sink, variable.pathUiString);
+    sink.Put(",\"pathTableKeyType\":");
+    json::WriteString(sink, ToVariableTypeName(variable.pathTableKeyType));
+    sink.Put(",\"valueType\":");
+    json::WriteString(sink, ToVariableTypeName(variable.valueType));
+    sink.Put(",\"value\":");
+    json::WriteString(sink, variable.value);
+    sink.Put(",\"valueRawAddress\":");
+    WriteInteger(sink, variable.valueRawAddress);
+    sink.Put(",\"childCount\":");
+    WriteInteger(sink, variable.childCount);
+    sink.Put(",\"instanceClassName\":");
+    json::WriteString(sink, variable.instanceClassName);
+    sink.Put(",\"editable\":");
+    sink.Put(variable.editable ? "true" : "false");
+    sink.Put(",\"parentIndex\":");
+    WriteInteger(sink, variable.parentIndex < 0 ? variable.parentIndex : variable.parentIndex + parentIndexOffset);
+    sink.Put('}');
+  }
+
+  template<typename TSink, typename TInteger>
+  static void WriteInteger(TSink& sink, const TInteger value)
+  {
+    std::array<char, 24> buffer = {};
+    const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+    sink.Put(std::string_view(buffer.data(), static_cast<size_t>(result.ptr - buffer.data())));
+  }
+};
+
+}// namespace sdb
+
+#endif// SDB_VARIABLE_LIST_WRITER_H
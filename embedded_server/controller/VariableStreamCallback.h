@@ -0,0 +1,106 @@
+#pragma once
+
+#ifndef SDB_VARIABLE_STREAM_CALLBACK_H
+#define SDB_VARIABLE_STREAM_CALLBACK_H
+
+#include "VariableListWriter.h"
+
+#include <sdb/MessageInterface.h>
+
+#include <oatpp/core/data/stream/Stream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace sdb {
+
+// Body of a streamed variable listing, written as newline delimited JSON: one line per variable, followed by a final
+// {"code":N} line that says whether the listing completed.
+// Pages are fetched with cursors, one at a time and only once the previous page has been written to the socket, so
+// memory use is bounded by the page size rather than the size of the table, and a slow client slows down the walk
+// rather than letting output build up. The pause mutex is only held while each page is read, so the program may be
+// resumed mid-stream; the cursor then expires, and the final line reports InvalidParameter.
+class VariableStreamCallback : public oatpp::data::stream::ReadCallback {
+ public:
+  using FetchPageFn = std::function<std::tuple<data::ReturnCode, std::vector<data::Variable>, uint64_t>(
+          const data::PaginationInfo& pagination, const data::VariableQueryOptions& options)>;
+
+  static constexpr uint32_t kPageSize = 256U;
+
+  // count is the maximum number of direct children of the path to list; nested variables don't count towards it.
+  VariableStreamCallback(
+          FetchPageFn fetchPage, const data::PaginationInfo& pagination, const data::VariableQueryOptions& options,
+          const uint32_t count)
+      : fetchPage_(std::move(fetchPage))
+      , pagination_(pagination)
+      , options_(options)
+      , remaining_(count)
+  {}
+
+  oatpp::v_io_size read(void* buffer, const v_buff_size count, oatpp::async::Action& /*action*/) override
+  {
+    while (readPos_ == buffer_.size()) {
+      if (finished_) {
+        return 0;
+      }
+      FillBuffer();
+    }
+
+    const auto size = std::min(static_cast<size_t>(count), buffer_.size() - readPos_);
+    std::memcpy(buffer, buffer_.data() + readPos_, size);
+    readPos_ += size;
+    return static_cast<oatpp::v_io_size>(size);
+  }
+
+ private:
+  void FillBuffer()
+  {
+    buffer_.clear();
+    readPos_ = 0;
+
+    pagination_.count = std::min(kPageSize, remaining_);
+    const auto [ret, variables, nextCursor] = fetchPage_(pagination_, options_);
+    if (ret != data::ReturnCode::Success) {
+      Finish(ret);
+      return;
+    }
+
+    VariableListWriter::AppendLines(variables, static_cast<int32_t>(linesWritten_), buffer_);
+    linesWritten_ += variables.size();
+    remaining_ -= static_cast<uint32_t>(std::count_if(variables.begin(), variables.end(), [](const auto& variable) {
+      return variable.parentIndex < 0;
+    }));
+
+    // An empty page means that nothing more can be listed (eg. maxNodes is 0), even if there is a cursor.
+    if (nextCursor == 0 || remaining_ == 0 || variables.empty()) {
+      Finish(data::ReturnCode::Success);
+      return;
+    }
+    pagination_.cursor = nextCursor;
+  }
+
+  void Finish(const data::ReturnCode code)
+  {
+    VariableListWriter::AppendEndLine(static_cast<int32_t>(code), buffer_);
+    finished_ = true;
+  }
+
+  const FetchPageFn fetchPage_;
+  data::PaginationInfo pagination_;
+  const data::VariableQueryOptions options_;
+  uint32_t remaining_;
+
+  // Lines of the current page that haven't been read yet
+  std::string buffer_;
+  size_t readPos_ = 0;
+  size_t linesWritten_ = 0;
+  bool finished_ = false;
+};
+
+}// namespace sdb
+
+#endif// SDB_VARIABLE_STREAM_CALLBACK_H
@@ -12,6 +12,8 @@
 #include <oatpp/parser/json/mapping/ObjectMapper.hpp>
 #include <oatpp/web/server/api/ApiController.hpp>
 
+#include <string>
+
 #include OATPP_CODEGEN_BEGIN(ApiController)
 
 namespace sdb {
@@ -24,9 +26,49 @@ class WebsocketController final : public oatpp::web::server::api::ApiController
     return std::make_shared<WebsocketController>(objectMapper);
   }
 
-  ENDPOINT("GET", "ws", WebSocket, REQUEST(std::shared_ptr<IncomingRequest>, request)) {
-    return oatpp::websocket::Handshaker::serversideHandshake(request->getHeaders(), websocketConnectionHandler_);
+  ENDPOINT("GET", "ws", WebSocket, REQUEST(std::shared_ptr<IncomingRequest>, request),
+           QUERIES(QueryParams, queryParams)) {
+    const auto encodingStr = queryParams.get("encoding");
+    const auto encoding = encodingStr == nullptr ? std::string() : encodingStr->std_str();
+    if (!encoding.empty() && encoding != "json" && encoding != "msgpack") {
+      return createResponse(Status::CODE_400, "encoding must be json or msgpack");
+    }
+    const auto outputStr = queryParams.get("output");
+    const auto output = outputStr == nullptr ? std::string() : outputStr->std_str();
+    if (!output.empty() && output != "line" && output != "batched") {
+      return createResponse(Status::CODE_400, "output must be line or batched");
+    }
+    if (encoding == "msgpack" && output == "line") {
+      return createResponse(Status::CODE_400, "output must be batched when encoding is msgpack");
+    }
+
+    auto response =
+            oatpp::websocket::Handshaker::serversideHandshake(request->getHeaders(), websocketConnectionHandler_);
+    if (!encoding.empty() || !output.empty()) {
+      auto parameters = std::make_shared<oatpp::network::ConnectionHandler::ParameterMap>();
+      if (!encoding.empty()) {
+        (*parameters)["encoding"] = encoding.c_str();
+      }
+      if (!output.empty()) {
+        (*parameters)["output"] = output.c_str();
+      }
+      response->setConnectionUpgradeParameters(parameters);
+    }
+    return response;
   };
+  ENDPOINT_INFO(WebSocket) {
+    info->description =
+            "Upgrades to a websocket that events are sent on. Events are JSON text frames, unless encoding is msgpack, "
+            "in which case they are MessagePack binary frames with the same structure and field names.";
+    auto& encodingParam = info->queryParams.add<String>("encoding");
+    encodingParam.required = false;
+    encodingParam.description = "json (the default) or msgpack.";
+    auto& outputParam = info->queryParams.add<String>("output");
+    outputParam.required = false;
+    outputParam.description =
+            "line (the default for json) sends an output_line event per line of script output; batched (the only "
+            "option for msgpack) sends output_lines events.";
+  }
 
  private:
   OATPP_COMPONENT(std::shared_ptr<oatpp::network::ConnectionHandler>, websocketConnectionHandler_, "websocket");
@@ -19,11 +19,19 @@ ENUM(CommandMessageType, v_int32,
     VALUE(StepOut,    2, "step_out"),
     VALUE(StepOver,   3, "step_over"),
     VALUE(StepIn,     4, "step_in"),
-    VALUE(SendStatus, 5, "send_status"))
+    VALUE(SendStatus, 5, "send_status"),
+    VALUE(LocalVariables,  6, "local_variables"),
+    VALUE(GlobalVariables, 7, "global_variables"),
+    VALUE(AckStatus,       8, "ack_status"))
 
 ENUM(EventMessageType, v_int32,
-    VALUE(Status,     0, "status"),
-    VALUE(OutputLine, 1, "output_line"))
+    VALUE(Status,      0, "status"),
+    // Sent to connections that didn't ask for output to be batched into output_lines.
+    VALUE(OutputLine,  1, "output_line"),
+    VALUE(PauseBundle, 2, "pause_bundle"),
+    VALUE(OutputLines, 3, "output_lines"),
+    VALUE(CommandResponse, 4, "command_response"),
+    VALUE(StatusDelta,     5, "status_delta"))
 
 ENUM(RunState, v_int32,
     VALUE(Running,    0, "running"),
@@ -90,6 +98,7 @@ class Variable : public oatpp::DTO {
   DTO_FIELD(UInt32, childCount);
   DTO_FIELD(String, instanceClassName);
   DTO_FIELD(Boolean, editable);
+  DTO_FIELD(Int32, parentIndex);
 };
 
 class VariableSetValueBody : public oatpp::DTO {
@@ -103,6 +112,37 @@ class VariableListResponse : public CommandMessageResponse {
   DTO_INIT(VariableListResponse, CommandMessageResponse)
 
   DTO_FIELD(List<Object<Variable>>, variables);
+  // Pass as the cursor query param to fetch the next page; null if this page reached the end.
+  DTO_FIELD(String, nextCursor);
+};
+
+// Sent by clients on the websocket, to run a command without making an HTTP request. The result is sent back to the
+// same connection as a command_response event with the same id.
+class CommandMessage : public oatpp::DTO {
+  DTO_INIT(CommandMessage, DTO)
+
+  // Chosen by the client
+  DTO_FIELD(UInt64, id);
+  DTO_FIELD(Enum<CommandMessageType>, type);
+  // The remaining fields are only used by local_variables (which requires stackFrame) and global_variables, and have
+  // the same meaning as the query params of Variables/Local and Variables/Global.
+  DTO_FIELD(UInt32, stackFrame);
+  DTO_FIELD(String, path);
+  DTO_FIELD(UInt32, beginIterator);
+  DTO_FIELD(UInt32, count);
+  DTO_FIELD(String, cursor);
+  // Only used by ack_status: the sequence of the status (or status_delta) event to send later statuses relative to.
+  DTO_FIELD(UInt64, statusSequence);
+};
+
+class CommandMessageResult : public CommandMessageResponse {
+  DTO_INIT(CommandMessageResult, CommandMessageResponse)
+
+  // id of the CommandMessage; null if the message couldn't be read.
+  DTO_FIELD(UInt64, id);
+  // Only set by local_variables and global_variables
+  DTO_FIELD(List<Object<Variable>>, variables);
+  DTO_FIELD(String, nextCursor);
 };
 
 class ImmediateValue : public oatpp::DTO {
@@ -119,6 +159,89 @@ class ImmediateValueListResponse : public CommandMessageResponse {
   DTO_FIELD(List<Object<ImmediateValue>>, values);
 };
 
+class ArraySliceResponse : public CommandMessageResponse {
+  DTO_INIT(ArraySliceResponse, CommandMessageResponse)
+
+  DTO_FIELD(Enum<VariableType>, elementType);
+  DTO_FIELD(UInt32, elementSize);
+  DTO_FIELD(UInt32, beginIndex);
+  DTO_FIELD(UInt32, arraySize);
+  // Base64 encoded elements, packed in native byte order
+  DTO_FIELD(String, data);
+};
+
+class ArrayStatisticsResponse : public CommandMessageResponse {
+  DTO_INIT(ArrayStatisticsResponse, CommandMessageResponse)
+
+  DTO_FIELD(UInt32, arraySize);
+  DTO_FIELD(UInt32, count);
+  DTO_FIELD(UInt32, nanCount);
+  // min, max and mean are omitted if every value is NaN
+  DTO_FIELD(Float64, min);
+  DTO_FIELD(Float64, max);
+  DTO_FIELD(Float64, mean);
+  DTO_FIELD(List<UInt32>, histogram);
+};
+
+// Returned by Variables/ExportFile.
+class ExportResponse : public CommandMessageResponse {
+  DTO_INIT(ExportResponse, CommandMessageResponse)
+
+  DTO_FIELD(UInt32, nodeCount);
+  DTO_FIELD(UInt64, byteCount);
+  DTO_FIELD(UInt32, sharedReferenceCount);
+  DTO_FIELD(Boolean, truncated);
+};
+
+class WatchResult : public oatpp::DTO {
+  DTO_INIT(WatchResult, DTO)
+
+  DTO_FIELD(UInt64, id);
+  DTO_FIELD(String, watch);
+  DTO_FIELD(Int32, code);
+  DTO_FIELD(Object<ImmediateValue>, value);
+};
+
+class PauseBundle : public oatpp::DTO {
+  DTO_INIT(PauseBundle, DTO)
+
+  DTO_FIELD(List<Object<Variable>>, locals);
+  DTO_FIELD(List<Object<Variable>>, globals);
+};
+
+class PauseBundleConfig : public oatpp::DTO {
+  DTO_INIT(PauseBundleConfig, DTO)
+
+  DTO_FIELD(Boolean, enabled);
+  DTO_FIELD(UInt32, localsCount);
+  DTO_FIELD(UInt32, globalsCount);
+};
+
+class AddWatchRequest : public oatpp::DTO {
+  DTO_INIT(AddWatchRequest, DTO)
+
+  DTO_FIELD(String, watch);
+};
+
+class AddWatchResponse : public CommandMessageResponse {
+  DTO_INIT(AddWatchResponse, CommandMessageResponse)
+
+  DTO_FIELD(UInt64, id);
+};
+
+class AddDataBreakpointRequest : public oatpp::DTO {
+  DTO_INIT(AddDataBreakpointRequest, DTO)
+
+  DTO_FIELD(Int32, stackFrame) = -1;
+  DTO_FIELD(String, watch);
+};
+
+class AddDataBreakpointResponse : public CommandMessageResponse {
+  DTO_INIT(AddDataBreakpointResponse, CommandMessageResponse)
+
+  DTO_FIELD(UInt64, id);
+};
+
 class StackEntry : public oatpp::DTO {
   DTO_INIT(StackEntry, DTO)
 
@@ -127,13 +250,62 @@ class StackEntry : public oatpp::DTO {
   DTO_FIELD(String, function);
 };
 
+class StackResponse : public CommandMessageResponse {
+  DTO_INIT(StackResponse, CommandMessageResponse)
+
+  DTO_FIELD(List<Object<StackEntry>>, stack);
+  DTO_FIELD(UInt32, stackDepth);
+};
+
 class Status : public oatpp::DTO {
 
   DTO_INIT(Status, DTO)
 
+  // Increases with each status event; acknowledged by the ack_status command.
+  DTO_FIELD(UInt64, sequence);
   DTO_FIELD(Enum<RunState>, runstate);
+  // The innermost frames; read the rest with the Stack endpoint.
   DTO_FIELD(List<Object<StackEntry>>, stack);
+  DTO_FIELD(UInt32, stackDepth);
   DTO_FIELD(UInt64, pausedAtBreakpointId);
+  DTO_FIELD(UInt64, pausedAtDataBreakpointId);
+  DTO_FIELD(List<Object<WatchResult>>, watches);
+};
+
+class InternedName : public oatpp::DTO {
+  DTO_INIT(InternedName, DTO)
+
+  DTO_FIELD(UInt32, id);
+  DTO_FIELD(String, name);
+};
+
+class StackEntryRef : public oatpp::DTO {
+  DTO_INIT(StackEntryRef, DTO)
+
+  DTO_FIELD(UInt32, fileId);
+  DTO_FIELD(UInt32, line);
+  DTO_FIELD(UInt32, functionId);
+};
+
+// Sent in place of a Status to connections that have acknowledged an earlier one (the base). Frames are aligned by
+// their depth from the bottom of the whole stack, as a Status only holds the top of deep stacks: the stack is the given
+// frames, followed by unchangedFrameCount frames of the base's stack at the same depths, followed by bottomFrames (the
+// frames below the bottom of the base's stack). File and function names are sent in names the first time the
+// connection needs them, and are referred to by id from then on.
+class StatusDelta : public oatpp::DTO {
+  DTO_INIT(StatusDelta, DTO)
+
+  DTO_FIELD(UInt64, sequence);
+  DTO_FIELD(UInt64, baseSequence);
+  DTO_FIELD(Enum<RunState>, runstate);
+  DTO_FIELD(List<Object<InternedName>>, names);
+  DTO_FIELD(UInt32, unchangedFrameCount);
+  DTO_FIELD(List<Object<StackEntryRef>>, frames);
+  DTO_FIELD(List<Object<StackEntryRef>>, bottomFrames);
+  DTO_FIELD(UInt32, stackDepth);
+  DTO_FIELD(UInt64, pausedAtBreakpointId);
+  DTO_FIELD(UInt64, pausedAtDataBreakpointId);
+  DTO_FIELD(List<Object<WatchResult>>, watches);
 };
 
 class OutputLine : public oatpp::DTO
@@ -146,12 +318,57 @@ class OutputLine : public oatpp::DTO
   DTO_FIELD(Int32, line);
 };
 
+class OutputLineBatch : public oatpp::DTO {
+  DTO_INIT(OutputLineBatch, DTO)
+
+  DTO_FIELD(List<Object<OutputLine>>, lines);
+  // Sequence number of the first line, as used by Output/History; the rest follow on consecutively.
+  DTO_FIELD(UInt64, firstSequence);
+  // Number of lines written after the last of these that were dropped, because output was produced faster than it
+  // could be sent.
+  DTO_FIELD(UInt32, droppedLineCount);
+};
+
+class OutputHistoryLine : public OutputLine {
+  DTO_INIT(OutputHistoryLine, OutputLine)
+
+  DTO_FIELD(UInt64, sequence);
+};
+
+class OutputHistoryResponse : public CommandMessageResponse {
+  DTO_INIT(OutputHistoryResponse, CommandMessageResponse)
+
+  DTO_FIELD(List<Object<OutputHistoryLine>>, lines);
+  // Sequence number of the oldest line still held
+  DTO_FIELD(UInt64, firstSequence);
+  // Pass as the begin query param to continue from where this response stopped
+  DTO_FIELD(UInt64, nextSequence);
+};
+
+class OutputSourceCounters : public oatpp::DTO {
+  DTO_INIT(OutputSourceCounters, DTO)
+
+  DTO_FIELD(String, file);
+  DTO_FIELD(Boolean, isErr);
+  DTO_FIELD(UInt64, lineCount);
+  DTO_FIELD(UInt64, byteCount);
+  DTO_FIELD(UInt64, droppedLineCount);
+};
+
+class OutputCountersResponse : public CommandMessageResponse {
+  DTO_INIT(OutputCountersResponse, CommandMessageResponse)
+
+  DTO_FIELD(List<Object<OutputSourceCounters>>, sources);
+};
+
 class CreateBreakpoint : public oatpp::DTO
 {
   DTO_INIT(CreateBreakpoint, DTO)
 
   DTO_FIELD(UInt64, id);
   DTO_FIELD(UInt32, line);
+  // Optional; the breakpoint only pauses execution when this watch expression is truthy.
+  DTO_FIELD(String, condition);
 };
 
 class SetFileBreakpointsRequest : public oatpp::DTO {
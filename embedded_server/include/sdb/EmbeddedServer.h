@@ -7,6 +7,8 @@
 #ifndef EMBEDDED_SERVER_H
 #define EMBEDDED_SERVER_H
 
+#include "ListenerConfig.h"
+
 #include <sdb/MessageInterface.h>
 
 #include <memory>
@@ -28,6 +30,7 @@ class EmbeddedServer {
 
   // Creates a new instance. Should be called after the environment has been initialized.
   [[nodiscard]] static EmbeddedServer* Create(uint16_t port);
+  [[nodiscard]] static EmbeddedServer* Create(const ListenerConfig& config);
 
   [[nodiscard]] virtual std::shared_ptr<MessageEventInterface> GetEventInterface() const = 0;
   virtual void SetCommandInterface(std::shared_ptr<MessageCommandInterface> messageCommandInterface) = 0;
@@ -0,0 +1,44 @@
+//
+// Created by Lewis weaver on 5/30/2021.
+//
+
+#pragma once
+
+#ifndef LISTENER_CONFIG_H
+#define LISTENER_CONFIG_H
+
+#include <cstdint>
+#include <string>
+
+namespace sdb {
+struct ListenerConfig {
+  enum class ConnectionMode {
+    // Each HTTP connection is served by its own thread, for as long as it stays open.
+    ThreadPerConnection,
+    // HTTP connections are served by coroutines on a fixed set of executor threads, so idle connections don't hold a
+    // thread each. Most requests are handled on the data processing threads. Those that may walk large parts of the VM
+    // (listing and exporting variables) are handled on separate worker threads, so that one large export can't hold
+    // up the rest, eg. Pause and Continue; when too many of them are waiting, further ones are refused with 503.
+    // Streamed (ndjson) variable listings aren't available, as their pages would be read on the executor threads.
+    Async
+  };
+
+  uint16_t port = 8000U;
+  std::string hostName = "localhost";
+
+  ConnectionMode connectionMode = ConnectionMode::ThreadPerConnection;
+  // Executor thread counts, only used when connectionMode is Async.
+  uint32_t asyncDataProcessingThreads = 1U;
+  uint32_t asyncIoThreads = 1U;
+  uint32_t asyncTimerThreads = 1U;
+  // Threads, and the number of requests that may wait for them, that handle requests which walk the VM in Async mode.
+  uint32_t asyncWorkerThreads = 1U;
+  uint32_t asyncMaxQueuedWorkerRequests = 16U;
+
+  // Variables/ExportFile may only create files within this directory. Empty, the default, disables writing exports to
+  // files; any client that can connect could otherwise fill the disk of the machine running the program.
+  std::string exportDirectory;
+};
+}// namespace sdb
+
+#endif
@@ -0,0 +1,649 @@
+#include "BoundedQueue.h"
+#include "OutputChannel.h"
+#include "OutputHistory.h"
+#include "ResponseCache.h"
+#include "StatusDeltaTracker.h"
+#include "WorkerPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sdb::tests {
+
+namespace {
+data::Status CreateStatus(std::vector<data::StackEntry> stack)
+{
+  data::Status status;
+  status.stackDepth = static_cast<uint32_t>(stack.size());
+  status.stack = std::move(stack);
+  return status;
+}
+
+std::string ToStdString(const oatpp::String& str)
+{
+  return std::string(str->c_str(), static_cast<size_t>(str->getSize()));
+}
+}// namespace
+
+TEST(StatusDeltaTrackerTest, FullStatusUntilAcknowledgedTest)
+{
+  StatusDeltaTracker tracker;
+  const auto status = CreateStatus({{"a.nut", 10, "f"}, {"main.nut", 5, "main"}});
+  StatusDelta delta;
+
+  tracker.AddFullStatus(1, status);
+  ASSERT_FALSE(tracker.TryCreateDelta(2, status, delta));
+}
+
+TEST(StatusDeltaTrackerTest, UnchangedFrameCountTest)
+{
+  StatusDeltaTracker tracker;
+  auto status = CreateStatus({{"a.nut", 10, "f"}, {"a.nut", 20, "g"}, {"main.nut", 5, "main"}});
+  StatusDelta delta;
+  tracker.AddFullStatus(1, status);
+  ASSERT_TRUE(tracker.Acknowledge(1));
+
+  // Stepping within the top frame only changes that frame
+  status.stack[0].line = 11;
+  ASSERT_TRUE(tracker.TryCreateDelta(2, status, delta));
+  ASSERT_EQ(delta.sequence, 2U);
+  ASSERT_EQ(delta.baseSequence, 1U);
+  ASSERT_EQ(delta.unchangedFrameCount, 2U);
+  ASSERT_EQ(delta.frames.size(), 1U);
+  ASSERT_EQ(delta.frames[0].line, 11U);
+
+  // Stepping into a function adds a frame; it's still against the acknowledged status, so the top frame has changed
+  status.stack.insert(status.stack.begin(), {"b.nut", 1, "h"});
+  ++status.stackDepth;
+  ASSERT_TRUE(tracker.TryCreateDelta(3, status, delta));
+  ASSERT_EQ(delta.baseSequence, 1U);
+  ASSERT_EQ(delta.unchangedFrameCount, 2U);
+  ASSERT_EQ(delta.frames.size(), 2U);
+
+  // Returning to main leaves only the bottom frame, which is unchanged
+  ASSERT_TRUE(tracker.Acknowledge(3));
+  ASSERT_TRUE(tracker.TryCreateDelta(4, CreateStatus({{"main.nut", 5, "main"}}), delta));
+  ASSERT_EQ(delta.baseSequence, 3U);
+  ASSERT_EQ(delta.unchangedFrameCount, 1U);
+  ASSERT_TRUE(delta.frames.empty());
+}
+
+TEST(StatusDeltaTrackerTest, TruncatedStackTest)
+{
+  // Mutually recursive isEven/isOdd, paused deeper than the status holds, with every caller at the line of its call
+  const auto createStatus = [](const uint32_t stackDepth, const uint32_t topLine) {
+    data::Status status;
+    status.stackDepth = stackDepth;
+    for (auto depth = stackDepth; depth-- > 0 && status.stack.size() < data::Status::kMaxStackFrames;) {
+      const auto line = depth + 1 == stackDepth ? topLine : 3U;
+      status.stack.push_back({"a.nut", line, depth == 0 ? "main" : depth % 2 == 0 ? "isEven" : "isOdd"});
+    }
+    return status;
+  };
+  StatusDeltaTracker tracker;
+  StatusDelta delta;
+  tracker.AddFullStatus(1, createStatus(40, 3));
+  ASSERT_TRUE(tracker.Acknowledge(1));
+
+  // Stepping in only adds the new top frame, although the bottom of the status has moved up by one
+  ASSERT_TRUE(tracker.TryCreateDelta(2, createStatus(41, 1), delta));
+  ASSERT_EQ(delta.unchangedFrameCount, data::Status::kMaxStackFrames - 1U);
+  ASSERT_EQ(delta.frames.size(), 1U);
+  ASSERT_EQ(delta.frames[0].line, 1U);
+  ASSERT_TRUE(delta.bottomFrames.empty());
+  const auto isEvenId = delta.frames[0].functionId;
+  ASSERT_TRUE(tracker.Acknowledge(2));
+
+  // Stepping out removes it, and the frame that the status now holds at its bottom isn't known to the client
+  ASSERT_TRUE(tracker.TryCreateDelta(3, createStatus(40, 3), delta));
+  ASSERT_EQ(delta.unchangedFrameCount, data::Status::kMaxStackFrames - 1U);
+  ASSERT_TRUE(delta.frames.empty());
+  ASSERT_EQ(delta.bottomFrames.size(), 1U);
+  ASSERT_EQ(delta.bottomFrames[0].functionId, isEvenId);
+  ASSERT_EQ(delta.bottomFrames[0].line, 3U);
+}
+
+TEST(StatusDeltaTrackerTest, NamesSentOnceTest)
+{
+  StatusDeltaTracker tracker;
+  auto status = CreateStatus({{"a.nut", 10, "f"}, {"main.nut", 5, "main"}});
+  StatusDelta delta;
+  tracker.AddFullStatus(1, status);
+  ASSERT_TRUE(tracker.Acknowledge(1));
+
+  // A delta only includes the names that its own frames use
+  status.stack[0].line = 11;
+  ASSERT_TRUE(tracker.TryCreateDelta(2, status, delta));
+  ASSERT_EQ(delta.frames.size(), 1U);
+  ASSERT_EQ(delta.names.size(), 2U);
+  ASSERT_EQ(delta.names[0].first, delta.frames[0].fileId);
+  ASSERT_EQ(delta.names[0].second, "a.nut");
+  ASSERT_EQ(delta.names[1].first, delta.frames[0].functionId);
+  ASSERT_EQ(delta.names[1].second, "f");
+
+  // ... and once they've been sent, later deltas refer to them by id alone
+  status.stack[0].line = 12;
+  ASSERT_TRUE(tracker.TryCreateDelta(3, status, delta));
+  ASSERT_EQ(delta.frames.size(), 1U);
+  ASSERT_TRUE(delta.names.empty());
+
+  // New names are still sent, along with nothing that was sent already
+  status.stack.insert(status.stack.begin(), {"a.nut", 30, "g"});
+  ++status.stackDepth;
+  ASSERT_TRUE(tracker.TryCreateDelta(4, status, delta));
+  ASSERT_EQ(delta.frames.size(), 2U);
+  ASSERT_EQ(delta.names.size(), 1U);
+  ASSERT_EQ(delta.names[0].second, "g");
+}
+
+TEST(StatusDeltaTrackerTest, AcknowledgeForgottenSequenceTest)
+{
+  StatusDeltaTracker tracker;
+  const auto status = CreateStatus({{"main.nut", 5, "main"}});
+  StatusDelta delta;
+
+  // Never sent
+  ASSERT_FALSE(tracker.Acknowledge(1));
+
+  // Forgotten, once too many later statuses weren't acknowledged
+  for (uint64_t sequence = 1; sequence <= StatusDeltaTracker::kMaxUnacknowledged + 1; ++sequence) {
+    tracker.AddFullStatus(sequence, status);
+  }
+  ASSERT_FALSE(tracker.Acknowledge(1));
+  ASSERT_FALSE(tracker.TryCreateDelta(100, status, delta));
+  ASSERT_TRUE(tracker.Acknowledge(2));
+
+  // Acknowledging a status forgets the ones sent before it
+  ASSERT_TRUE(tracker.Acknowledge(StatusDeltaTracker::kMaxUnacknowledged + 1));
+  ASSERT_FALSE(tracker.Acknowledge(3));
+  ASSERT_TRUE(tracker.TryCreateDelta(100, status, delta));
+  ASSERT_EQ(delta.baseSequence, StatusDeltaTracker::kMaxUnacknowledged + 1);
+}
+
+TEST(BoundedQueueTest, FifoTest)
+{
+  // Rounded up to 4
+  BoundedQueue<std::string> queue(3);
+  ASSERT_TRUE(queue.IsEmpty());
+  std::string value;
+  ASSERT_FALSE(queue.TryPop(value));
+
+  // Several laps of the ring, so that the cells' sequence numbers wrap around
+  for (int lap = 0; lap < 3; ++lap) {
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(queue.TryPush(std::to_string(lap) + "." + std::to_string(i)));
+    }
+    std::string rejected = "rejected";
+    ASSERT_FALSE(queue.TryPush(std::move(rejected)));
+    ASSERT_EQ(rejected, "rejected");
+    ASSERT_FALSE(queue.IsEmpty());
+
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(queue.TryPop(value));
+      ASSERT_EQ(value, std::to_string(lap) + "." + std::to_string(i));
+    }
+    ASSERT_FALSE(queue.TryPop(value));
+    ASSERT_TRUE(queue.IsEmpty());
+  }
+
+  // Interleaved
+  ASSERT_TRUE(queue.TryPush("a"));
+  ASSERT_TRUE(queue.TryPush("b"));
+  ASSERT_TRUE(queue.TryPop(value));
+  ASSERT_EQ(value, "a");
+  ASSERT_TRUE(queue.TryPush("c"));
+  ASSERT_TRUE(queue.TryPop(value));
+  ASSERT_EQ(value, "b");
+  ASSERT_TRUE(queue.TryPop(value));
+  ASSERT_EQ(value, "c");
+}
+
+TEST(BoundedQueueTest, MultiProducerStressTest)
+{
+  constexpr uint32_t kProducerCount = 4;
+  constexpr uint32_t kConsumerCount = 2;
+  constexpr uint32_t kValuesPerProducer = 100000;
+  // Small, so that producers often find it full and consumers often find it empty
+  BoundedQueue<uint64_t> queue(16);
+
+  std::vector<std::thread> producers;
+  for (uint32_t producer = 0; producer < kProducerCount; ++producer) {
+    producers.emplace_back([&queue, producer]() {
+      for (uint32_t i = 0; i < kValuesPerProducer; ++i) {
+        uint64_t value = (uint64_t{producer} << 32U) | i;
+        while (!queue.TryPush(std::move(value))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Each consumer sees the values of each producer in the order they were pushed
+  std::atomic<uint32_t> popCount = 0;
+  std::vector<std::vector<uint32_t>> receivedCounts(kConsumerCount, std::vector<uint32_t>(kProducerCount));
+  std::atomic<bool> isOrdered = true;
+  std::vector<std::thread> consumers;
+  for (uint32_t consumer = 0; consumer < kConsumerCount; ++consumer) {
+    consumers.emplace_back([&queue, &popCount, &isOrdered, &counts = receivedCounts[consumer]]() {
+      std::vector<int64_t> lastValues(kProducerCount, -1);
+      uint64_t value = 0;
+      while (popCount.load() < kProducerCount * kValuesPerProducer) {
+        if (!queue.TryPop(value)) {
+          std::this_thread::yield();
+          continue;
+        }
+        ++popCount;
+        const auto producer = static_cast<uint32_t>(value >> 32U);
+        const auto i = static_cast<int64_t>(value & UINT32_MAX);
+        if (producer >= kProducerCount || i <= lastValues[producer]) {
+          isOrdered = false;
+        }
+        else {
+          lastValues[producer] = i;
+          ++counts[producer];
+        }
+      }
+    });
+  }
+
+  for (auto& thread : producers) {
+    thread.join();
+  }
+  for (auto& thread : consumers) {
+    thread.join();
+  }
+
+  // Every value was popped exactly once
+  ASSERT_TRUE(isOrdered);
+  ASSERT_EQ(popCount.load(), kProducerCount * kValuesPerProducer);
+  for (uint32_t producer = 0; producer < kProducerCount; ++producer) {
+    uint32_t count = 0;
+    for (const auto& counts : receivedCounts) {
+      count += counts[producer];
+    }
+    ASSERT_EQ(count, kValuesPerProducer);
+  }
+  ASSERT_TRUE(queue.IsEmpty());
+}
+
+TEST(OutputChannelTest, RingFullTest)
+{
+  OutputChannel channel;
+  // The first line wakes the sender, to start the flush interval
+  ASSERT_TRUE(channel.Push({"first\n", false, "main.nut", 0}));
+  for (uint32_t i = 1; i < OutputChannel::kRingCapacity; ++i) {
+    ASSERT_FALSE(channel.Push({"line\n", false, "main.nut", i}));
+  }
+
+  // Only the first dropped line wakes the sender
+  ASSERT_TRUE(channel.Push({"dropped\n", false, "main.nut", 0}));
+  ASSERT_FALSE(channel.Push({"dropped\n", true, "main.nut", 0}));
+
+  // The oldest lines are kept, followed by a count of those dropped
+  std::vector<OutputChannel::Line> lines;
+  ASSERT_EQ(channel.Drain(lines), 2U);
+  ASSERT_EQ(lines.size(), OutputChannel::kRingCapacity);
+  ASSERT_EQ(lines[0].output, "first\n");
+  ASSERT_EQ(lines.back().line, OutputChannel::kRingCapacity - 1);
+  ASSERT_TRUE(channel.IsEmpty());
+
+  // There's room again once drained
+  ASSERT_TRUE(channel.Push({"after\n", false, "main.nut", 0}));
+  ASSERT_EQ(channel.Drain(lines), 0U);
+  ASSERT_EQ(lines.size(), 1U);
+}
+
+TEST(OutputChannelTest, ByteCapTest)
+{
+  OutputChannel channel;
+  const std::string large(OutputChannel::kMaxPendingBytes - 8U, 'x');
+  ASSERT_TRUE(channel.Push({large, false, "main.nut", 1}));
+
+  // Doesn't fit in what is left
+  ASSERT_TRUE(channel.Push({"0123456789", false, "main.nut", 2}));
+  // Would fit, but is dropped as well so that there's a single gap
+  ASSERT_FALSE(channel.Push({"0", false, "main.nut", 3}));
+
+  std::vector<OutputChannel::Line> lines;
+  ASSERT_EQ(channel.Drain(lines), 2U);
+  ASSERT_EQ(lines.size(), 1U);
+  ASSERT_EQ(lines[0].line, 1U);
+
+  // A line that is larger than the cap on its own is truncated rather than dropped
+  const std::string tooLarge(OutputChannel::kMaxPendingBytes * 2U, 'x');
+  ASSERT_TRUE(channel.Push({tooLarge, false, "main.nut", 4}));
+  ASSERT_EQ(channel.Drain(lines), 0U);
+  ASSERT_EQ(lines.size(), 1U);
+  ASSERT_EQ(lines[0].output.size(), OutputChannel::kMaxPendingBytes);
+}
+
+TEST(OutputChannelTest, CountersTest)
+{
+  OutputChannel channel;
+  ASSERT_TRUE(channel.GetCounters().empty());
+
+  const std::string large(OutputChannel::kMaxPendingBytes, 'x');
+  ASSERT_TRUE(channel.Push({large, false, "a.nut", 1}));
+  ASSERT_TRUE(channel.Push({"error\n", true, "a.nut", 2}));
+  ASSERT_FALSE(channel.Push({"output\n", false, "b.nut", 3}));
+
+  const auto counters = channel.GetCounters();
+  ASSERT_EQ(counters.size(), 3U);
+  ASSERT_EQ(counters[0].fileName, "a.nut");
+  ASSERT_FALSE(counters[0].isErr);
+  ASSERT_EQ(counters[0].lineCount, 1U);
+  ASSERT_EQ(counters[0].byteCount, large.size());
+  ASSERT_EQ(counters[0].droppedLineCount, 0U);
+  ASSERT_EQ(counters[1].fileName, "a.nut");
+  ASSERT_TRUE(counters[1].isErr);
+  ASSERT_EQ(counters[1].lineCount, 1U);
+  ASSERT_EQ(counters[1].byteCount, 6U);
+  ASSERT_EQ(counters[1].droppedLineCount, 1U);
+  ASSERT_EQ(counters[2].fileName, "b.nut");
+  ASSERT_EQ(counters[2].droppedLineCount, 1U);
+
+  // Counters are totals, so aren't reset by draining
+  std::vector<OutputChannel::Line> lines;
+  ASSERT_EQ(channel.Drain(lines), 2U);
+  ASSERT_EQ(channel.GetCounters()[1].droppedLineCount, 1U);
+}
+
+TEST(OutputChannelTest, FlushDueTest)
+{
+  OutputChannel channel;
+  const auto longAgo = std::chrono::steady_clock::time_point();
+  ASSERT_FALSE(channel.GetFlushDeadline().has_value());
+  ASSERT_FALSE(channel.IsFlushDue(std::chrono::steady_clock::now()));
+
+  // Due once the oldest line has waited kFlushInterval
+  ASSERT_TRUE(channel.Push({"line\n", false, "main.nut", 1}));
+  const auto deadline = channel.GetFlushDeadline();
+  ASSERT_TRUE(deadline.has_value());
+  ASSERT_FALSE(channel.IsFlushDue(*deadline - std::chrono::milliseconds(1)));
+  ASSERT_TRUE(channel.IsFlushDue(*deadline));
+
+  // ... or straight away once kFlushBytes are pending, which wakes the sender once
+  const std::string large(OutputChannel::kFlushBytes / 2U, 'x');
+  ASSERT_FALSE(channel.Push({large, false, "main.nut", 2}));
+  ASSERT_FALSE(channel.IsFlushDue(longAgo));
+  ASSERT_TRUE(channel.Push({large, false, "main.nut", 3}));
+  ASSERT_TRUE(channel.IsFlushDue(longAgo));
+  ASSERT_FALSE(channel.Push({large, false, "main.nut", 4}));
+  // The deadline is still that of the oldest line
+  ASSERT_EQ(channel.GetFlushDeadline(), deadline);
+
+  std::vector<OutputChannel::Line> lines;
+  ASSERT_EQ(channel.Drain(lines), 0U);
+  ASSERT_FALSE(channel.GetFlushDeadline().has_value());
+  ASSERT_FALSE(channel.IsFlushDue(std::chrono::steady_clock::now()));
+}
+
+TEST(OutputHistoryTest, EvictionTest)
+{
+  OutputHistory history;
+  // Each line takes a chunk of its own, so that the oldest are evicted once kMaxChunks lines are held
+  const std::string large(OutputHistory::kChunkSize / 2U, 'x');
+  constexpr uint32_t kEvictedCount = 3;
+  std::vector<OutputChannel::Line> lines;
+  for (uint32_t i = 0; i < OutputHistory::kMaxChunks + kEvictedCount; ++i) {
+    lines.push_back({large, false, "main.nut", i});
+  }
+  ASSERT_EQ(history.Append(lines), 0U);
+
+  OutputHistory::Query query;
+  auto result = history.Find(query);
+  ASSERT_EQ(result.firstSequence, kEvictedCount);
+  ASSERT_EQ(result.records.size(), OutputHistory::kMaxChunks);
+  ASSERT_EQ(result.records[0].sequence, kEvictedCount);
+  ASSERT_EQ(result.records[0].line.line, kEvictedCount);
+  ASSERT_EQ(result.nextSequence, OutputHistory::kMaxChunks + kEvictedCount);
+
+  // Recycled chunks hold new lines; lines longer than a chunk are truncated
+  const std::string tooLarge(OutputHistory::kChunkSize * 2U, 'y');
+  ASSERT_EQ(history.Append({{tooLarge, true, "other.nut", 7}}), OutputHistory::kMaxChunks + kEvictedCount);
+  query.beginSequence = OutputHistory::kMaxChunks + kEvictedCount;
+  result = history.Find(query);
+  ASSERT_EQ(result.firstSequence, kEvictedCount + 1U);
+  ASSERT_EQ(result.records.size(), 1U);
+  ASSERT_LT(result.records[0].line.output.size(), OutputHistory::kChunkSize);
+  ASSERT_EQ(result.records[0].line.output[0], 'y');
+  ASSERT_EQ(result.records[0].line.fileName, "other.nut");
+  ASSERT_TRUE(result.records[0].line.isErr);
+}
+
+TEST(OutputHistoryTest, PagingTest)
+{
+  OutputHistory history;
+  std::vector<OutputChannel::Line> lines;
+  for (uint32_t i = 0; i < 10; ++i) {
+    lines.push_back({"line " + std::to_string(i), i % 2U == 1U, "main.nut", i});
+  }
+  history.Append(lines);
+
+  // Each page continues from the nextSequence of the one before
+  OutputHistory::Query query;
+  query.maxCount = 4;
+  std::vector<uint64_t> sequences;
+  for (int page = 0; page < 3; ++page) {
+    const auto result = history.Find(query);
+    ASSERT_LE(result.records.size(), query.maxCount);
+    for (const auto& record : result.records) {
+      sequences.push_back(record.sequence);
+    }
+    query.beginSequence = result.nextSequence;
+  }
+  ASSERT_EQ(sequences, std::vector<uint64_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  ASSERT_EQ(query.beginSequence, 10U);
+
+  // Paging through filtered lines skips those that don't match
+  query = {};
+  query.maxCount = 2;
+  query.isErr = true;
+  auto result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 2U);
+  ASSERT_EQ(result.records[0].sequence, 1U);
+  ASSERT_EQ(result.records[1].sequence, 3U);
+  query.beginSequence = result.nextSequence;
+  result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 2U);
+  ASSERT_EQ(result.records[0].sequence, 5U);
+  ASSERT_EQ(result.records[1].sequence, 7U);
+  query.beginSequence = result.nextSequence;
+  result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 1U);
+  ASSERT_EQ(result.records[0].sequence, 9U);
+  ASSERT_EQ(result.nextSequence, 10U);
+
+  // The end of the range is exclusive
+  query = {};
+  query.beginSequence = 2;
+  query.endSequence = 4;
+  result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 2U);
+  ASSERT_EQ(result.nextSequence, 4U);
+}
+
+TEST(OutputHistoryTest, FilterTest)
+{
+  OutputHistory history;
+  // Large lines, so that the sources are spread across chunks that are skipped
+  const std::string large(OutputHistory::kChunkSize / 2U, 'x');
+  history.Append({
+          {large, false, "a.nut", 1},
+          {large, true, "a.nut", 2},
+          {large, false, "b.nut", 3},
+          {"small error", true, "b.nut", 4},
+          {"small output", false, "a.nut", 5},
+  });
+
+  OutputHistory::Query query;
+  query.fileName = "a.nut";
+  auto result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 3U);
+  ASSERT_EQ(result.records[0].line.line, 1U);
+  ASSERT_EQ(result.records[1].line.line, 2U);
+  ASSERT_EQ(result.records[2].line.line, 5U);
+  ASSERT_EQ(result.nextSequence, 5U);
+
+  query.isErr = true;
+  result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 1U);
+  ASSERT_EQ(result.records[0].line.line, 2U);
+
+  query.fileName.reset();
+  result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 2U);
+  ASSERT_EQ(result.records[0].line.line, 2U);
+  ASSERT_EQ(result.records[1].line.line, 4U);
+
+  query.isErr.reset();
+  query.contains = "small";
+  result = history.Find(query);
+  ASSERT_EQ(result.records.size(), 2U);
+  ASSERT_EQ(result.records[0].line.output, "small error");
+  ASSERT_EQ(result.records[1].line.output, "small output");
+
+  // A file that has never written anything
+  query = {};
+  query.fileName = "c.nut";
+  result = history.Find(query);
+  ASSERT_TRUE(result.records.empty());
+  ASSERT_EQ(result.nextSequence, 5U);
+}
+
+TEST(ResponseCacheTest, FindInsertedTest)
+{
+  ResponseCache cache;
+  const auto version = cache.GetVersion(1);
+  ASSERT_EQ(cache.Find(version, "/a"), nullptr);
+
+  cache.Insert(version, "/a", "body");
+  const auto body = cache.Find(version, "/a");
+  ASSERT_NE(body, nullptr);
+  ASSERT_EQ(ToStdString(body), "body");
+  ASSERT_EQ(cache.Find(version, "/b"), nullptr);
+}
+
+TEST(ResponseCacheTest, NewerVersionEvictsTest)
+{
+  ResponseCache cache;
+  const auto version = cache.GetVersion(1);
+  cache.Insert(version, "/a", "body");
+
+  // Editing a value makes a newer version within the same pause
+  cache.Invalidate();
+  const auto editedVersion = cache.GetVersion(1);
+  ASSERT_GT(editedVersion, version);
+  ASSERT_EQ(cache.Find(editedVersion, "/a"), nullptr);
+
+  // Responses built from older state are neither found nor inserted
+  cache.Insert(version, "/a", "stale");
+  ASSERT_EQ(cache.Find(editedVersion, "/a"), nullptr);
+  ASSERT_EQ(cache.Find(version, "/a"), nullptr);
+
+  // As does the next pause
+  cache.Insert(editedVersion, "/a", "body");
+  const auto nextPauseVersion = cache.GetVersion(2);
+  ASSERT_GT(nextPauseVersion, editedVersion);
+  ASSERT_EQ(cache.Find(nextPauseVersion, "/a"), nullptr);
+}
+
+TEST(ResponseCacheTest, ByteBudgetEvictsTest)
+{
+  ResponseCache cache;
+  const auto version = cache.GetVersion(1);
+
+  // Too large to cache at all
+  const std::string tooLarge(ResponseCache::kMaxEntryBytes, 'x');
+  cache.Insert(version, "/large", tooLarge.c_str());
+  ASSERT_EQ(cache.Find(version, "/large"), nullptr);
+
+  // Only kMaxBytes / kMaxEntryBytes entries this size fit, so the least recently used are evicted
+  const std::string body(ResponseCache::kMaxEntryBytes - 16U, 'x');
+  constexpr size_t kEntryCount = ResponseCache::kMaxBytes / ResponseCache::kMaxEntryBytes;
+  cache.Insert(version, "/0", body.c_str());
+  for (size_t i = 1; i < kEntryCount; ++i) {
+    cache.Insert(version, "/" + std::to_string(i), body.c_str());
+  }
+  // Use the oldest, so that the next oldest is evicted instead
+  ASSERT_NE(cache.Find(version, "/0"), nullptr);
+  cache.Insert(version, "/new", body.c_str());
+
+  ASSERT_NE(cache.Find(version, "/0"), nullptr);
+  ASSERT_EQ(cache.Find(version, "/1"), nullptr);
+  for (size_t i = 2; i < kEntryCount; ++i) {
+    ASSERT_NE(cache.Find(version, "/" + std::to_string(i)), nullptr);
+  }
+  ASSERT_NE(cache.Find(version, "/new"), nullptr);
+}
+
+TEST(ResponseCacheTest, ETagMatchTest)
+{
+  const auto etag = ResponseCache::FormatETag(ResponseCache().GetVersion(3));
+  ASSERT_EQ(etag, "\"3.0\"");
+
+  ASSERT_TRUE(ResponseCache::IsETagMatch(etag, etag));
+  ASSERT_FALSE(ResponseCache::IsETagMatch("\"3.1\"", etag));
+  ASSERT_FALSE(ResponseCache::IsETagMatch("", etag));
+
+  // Weak ETags compare equal to strong ones
+  ASSERT_TRUE(ResponseCache::IsETagMatch("W/" + etag, etag));
+
+  // Any ETag
+  ASSERT_TRUE(ResponseCache::IsETagMatch("*", etag));
+  ASSERT_TRUE(ResponseCache::IsETagMatch(" * ", etag));
+
+  // Lists, with or without spaces
+  ASSERT_TRUE(ResponseCache::IsETagMatch("\"1.0\", " + etag, etag));
+  ASSERT_TRUE(ResponseCache::IsETagMatch("\"1.0\",W/" + etag + ",\"2.0\"", etag));
+  ASSERT_FALSE(ResponseCache::IsETagMatch("\"1.0\", \"2.0\"", etag));
+  ASSERT_FALSE(ResponseCache::IsETagMatch(",", etag));
+}
+
+TEST(WorkerPoolTest, BoundedQueueTest)
+{
+  constexpr size_t kMaxQueuedTasks = 4;
+  std::promise<void> release;
+  const auto released = release.get_future().share();
+  std::promise<void> started;
+  std::atomic<uint32_t> runCount = 0;
+  {
+    WorkerPool workers(1, kMaxQueuedTasks);
+
+    // Hold the only thread, so that later tasks wait
+    ASSERT_TRUE(workers.TrySubmit([&started, released, &runCount]() {
+      started.set_value();
+      released.wait();
+      ++runCount;
+    }));
+    started.get_future().wait();
+
+    std::promise<void> lastRun;
+    for (size_t i = 0; i < kMaxQueuedTasks; ++i) {
+      const bool isLast = i + 1 == kMaxQueuedTasks;
+      ASSERT_TRUE(workers.TrySubmit([&runCount, &lastRun, isLast]() {
+        ++runCount;
+        if (isLast) {
+          lastRun.set_value();
+        }
+      }));
+    }
+    ASSERT_FALSE(workers.TrySubmit([]() {}));
+
+    release.set_value();
+    lastRun.get_future().wait();
+    ASSERT_EQ(runCount.load(), kMaxQueuedTasks + 1);
+
+    // There's room again
+    ASSERT_TRUE(workers.TrySubmit([]() {}));
+  }
+}
+
+}// namespace sdb::tests
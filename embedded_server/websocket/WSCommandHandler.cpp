@@ -0,0 +1,102 @@
+#include "WSCommandHandler.h"
+
+#include "../controller/DebugCommandController.h"
+
+#include <exception>
+
+using sdb::WSCommandHandler;
+
+WSCommandHandler::WSCommandHandler(std::shared_ptr<MessageCommandInterface> messageCommandInterface)
+    : messageCommandInterface_(std::move(messageCommandInterface))
+    , mapper_(oatpp::parser::json::mapping::ObjectMapper::createShared()) {}
+
+oatpp::String WSCommandHandler::handleMessage(
+        const oatpp::String& message, const EventEncoding encoding, MsgPackEventEncoder& msgPackEncoder,
+        StatusDeltaTracker& statusDeltas) const {
+  oatpp::Object<dto::CommandMessage> command;
+  try {
+    command = mapper_->readFromString<oatpp::Object<dto::CommandMessage>>(message);
+  } catch (const std::exception& e) {
+    OATPP_LOGD("WSCommandHandler", "Failed to read command message: %s", e.what())
+  }
+
+  std::optional<uint64_t> id;
+  auto code = data::ReturnCode::InvalidParameter;
+  std::vector<data::Variable> variables;
+  uint64_t nextCursor = 0;
+  if (command != nullptr && command->id != nullptr && command->type != nullptr) {
+    id = *command->id;
+    code = runCommand(*command, statusDeltas, variables, nextCursor);
+  }
+
+  const bool isVariablesCommand = command != nullptr && (command->type == dto::CommandMessageType::LocalVariables ||
+                                                         command->type == dto::CommandMessageType::GlobalVariables);
+  const bool hasVariables = isVariablesCommand && code == data::ReturnCode::Success;
+  const auto nextCursorStr = hasVariables ? DebugCommandController::FormatCursor(nextCursor) : std::string();
+  if (encoding == EventEncoding::MsgPack) {
+    return msgPackEncoder.EncodeCommandResult(id, code, hasVariables ? &variables : nullptr, nextCursorStr);
+  }
+
+  const auto resultDto = dto::CommandMessageResult::createShared();
+  resultDto->code = static_cast<int32_t>(code);
+  if (id.has_value()) {
+    resultDto->id = *id;
+  }
+  if (hasVariables) {
+    resultDto->variables = DebugCommandController::CreateVariablesList(variables);
+    if (!nextCursorStr.empty()) {
+      resultDto->nextCursor = nextCursorStr.c_str();
+    }
+  }
+
+  const auto wrapper = dto::EventMessageWrapper<dto::CommandMessageResult>::createShared();
+  wrapper->type = dto::EventMessageType::CommandResponse;
+  wrapper->message = resultDto;
+  return mapper_->writeToString(wrapper);
+}
+
+sdb::data::ReturnCode WSCommandHandler::runCommand(
+        const dto::CommandMessage& command, StatusDeltaTracker& statusDeltas, std::vector<data::Variable>& variables,
+        uint64_t& nextCursor) const {
+  switch (*command.type) {
+    case dto::CommandMessageType::Pause:
+      return messageCommandInterface_->PauseExecution();
+    case dto::CommandMessageType::Continue:
+      return messageCommandInterface_->ContinueExecution();
+    case dto::CommandMessageType::StepOut:
+      return messageCommandInterface_->StepOut();
+    case dto::CommandMessageType::StepOver:
+      return messageCommandInterface_->StepOver();
+    case dto::CommandMessageType::StepIn:
+      return messageCommandInterface_->StepIn();
+    case dto::CommandMessageType::SendStatus:
+      return messageCommandInterface_->SendStatus();
+    case dto::CommandMessageType::AckStatus:
+      if (command.statusSequence == nullptr || !statusDeltas.Acknowledge(*command.statusSequence)) {
+        return data::ReturnCode::InvalidParameter;
+      }
+      return data::ReturnCode::Success;
+    case dto::CommandMessageType::LocalVariables:
+    case dto::CommandMessageType::GlobalVariables:
+      break;
+    default:
+      return data::ReturnCode::InvalidParameter;
+  }
+
+  data::PaginationInfo pagination = {};
+  pagination.beginIterator = command.beginIterator != nullptr ? *command.beginIterator : 0U;
+  pagination.count = command.count != nullptr ? *command.count : 100U;
+  const auto path = command.path != nullptr ? command.path->std_str() : std::string();
+  const auto cursor = command.cursor != nullptr ? command.cursor->std_str() : std::string();
+  if (pagination.count > kMaxVariablesCount || !DebugCommandController::ParseCursor(cursor, pagination.cursor)) {
+    return data::ReturnCode::InvalidParameter;
+  }
+
+  if (command.type == dto::CommandMessageType::GlobalVariables) {
+    return messageCommandInterface_->GetGlobalVariables(path, pagination, {}, variables, nextCursor);
+  }
+  if (command.stackFrame == nullptr) {
+    return data::ReturnCode::InvalidParameter;
+  }
+  return messageCommandInterface_->GetStackVariables(*command.stackFrame, path, pagination, {}, variables, nextCursor);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef SDB_WS_COMMAND_HANDLER_H
+#define SDB_WS_COMMAND_HANDLER_H
+
+#include "../MsgPackEventEncoder.h"
+#include "../StatusDeltaTracker.h"
+#include "WSListener.h"
+
+#include <sdb/MessageInterface.h>
+
+#include <oatpp/parser/json/mapping/ObjectMapper.hpp>
+
+#include <memory>
+
+namespace sdb {
+/**
+ * Runs commands that clients send on their websocket (as JSON dto::CommandMessage text frames), so that stepping
+ * doesn't need an HTTP request each time. Commands go to the same MessageCommandInterface methods as the
+ * DebugCommandController endpoints.
+ */
+class WSCommandHandler {
+ public:
+  explicit WSCommandHandler(std::shared_ptr<MessageCommandInterface> messageCommandInterface);
+
+  /**
+   * Returns the command_response event to send back, in the connection's encoding. Called from the connection's own
+   * thread, so the MsgPack encoder is passed in rather than shared, along with the connection's statuses for
+   * ack_status.
+   */
+  [[nodiscard]] oatpp::String handleMessage(
+          const oatpp::String& message, EventEncoding encoding, MsgPackEventEncoder& msgPackEncoder,
+          StatusDeltaTracker& statusDeltas) const;
+
+ private:
+  static constexpr uint32_t kMaxVariablesCount = 1000U;
+
+  [[nodiscard]] data::ReturnCode runCommand(
+          const dto::CommandMessage& command, StatusDeltaTracker& statusDeltas, std::vector<data::Variable>& variables,
+          uint64_t& nextCursor) const;
+
+  std::shared_ptr<MessageCommandInterface> messageCommandInterface_;
+  std::shared_ptr<oatpp::parser::json::mapping::ObjectMapper> mapper_;
+};
+}// namespace sdb
+
+#endif// SDB_WS_COMMAND_HANDLER_H
@@ -1,6 +1,13 @@
 #include "WSListener.h"
+#include "WSCommandHandler.h"
+
+#include "../controller/DebugCommandController.h"
 
 #include "oatpp/core/macro/component.hpp"
+#include "oatpp/parser/json/mapping/ObjectMapper.hpp"
+
+#include <algorithm>
+#include <iterator>
 
 using sdb::RemoteConnection;
 using sdb::WSInstanceListener;
@@ -8,11 +15,23 @@ using sdb::WSInstanceListener;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // RemoteConnection
 
-RemoteConnection::RemoteConnection(const WebSocket& webSocket)
-    : webSocket_(webSocket) {}
+RemoteConnection::RemoteConnection(
+        const WebSocket& webSocket, const EventEncoding encoding, const OutputFormat outputFormat,
+        std::shared_ptr<WSCommandHandler> commandHandler)
+    : webSocket_(webSocket)
+    , encoding_(encoding)
+    , outputFormat_(outputFormat)
+    , commandHandler_(std::move(commandHandler))
+    , mapper_(oatpp::parser::json::mapping::ObjectMapper::createShared())
+    , writerThread_(&RemoteConnection::runWriter, this) {}
+
+RemoteConnection::~RemoteConnection() {
+  stop();
+}
 
 void RemoteConnection::onPing(const WebSocket& socket, const oatpp::String& message) {
   OATPP_LOGD(TAG, "onPing")
+  std::lock_guard lock(sendMutex_);
   socket.sendPong(message);
 }
 
@@ -32,13 +51,160 @@ void RemoteConnection::readMessage(const WebSocket& socket, v_uint8 opcode, p_ch
     messageBuffer_.clear();
 
     OATPP_LOGD(TAG, "onMessage message='%s'", wholeMessage->c_str())
+    handleCommandMessage(socket, wholeMessage);
   } else if(size > 0) { // message frame received
     messageBuffer_.writeSimple(data, size);
   }
 }
 
-void RemoteConnection::sendMessage(const oatpp::String& message) {
-  webSocket_.sendOneFrameText(message);
+void RemoteConnection::handleCommandMessage(const WebSocket& socket, const oatpp::String& message) {
+  if (commandHandler_ == nullptr) {
+    OATPP_LOGE(TAG, "No command interface, ignoring message")
+    return;
+  }
+  queueMessages({{commandHandler_->handleMessage(message, encoding_, msgPackEncoder_, statusDeltas_)}});
+}
+
+void RemoteConnection::queueMessages(const std::vector<WSEvent>& messages) {
+  std::unique_lock lock(queueMutex_);
+  if (isStopping_ || isOverflowed_) {
+    return;
+  }
+
+  const auto isForConnection = [this](const WSEvent& event) {
+    return !event.outputFormat.has_value() || *event.outputFormat == outputFormat_;
+  };
+  size_t messageCount = 0U;
+  size_t messagesSize = 0U;
+  for (const auto& event : messages) {
+    if (isForConnection(event)) {
+      ++messageCount;
+      messagesSize += static_cast<size_t>(event.message->getSize());
+    }
+  }
+  if (queue_.size() + messageCount > kMaxQueuedMessages || queuedBytes_ + messagesSize > kMaxQueuedBytes) {
+    OATPP_LOGE(TAG, "Client is not reading events fast enough, closing connection. Queued messages=%d",
+               static_cast<uint32_t>(queue_.size()))
+    queue_.clear();
+    queuedBytes_ = 0U;
+    isOverflowed_ = true;
+  }
+  else {
+    std::copy_if(messages.begin(), messages.end(), std::back_inserter(queue_), isForConnection);
+    queuedBytes_ += messagesSize;
+  }
+  lock.unlock();
+  queueCondition_.notify_one();
+}
+
+void RemoteConnection::stop() {
+  {
+    std::lock_guard lock(queueMutex_);
+    isStopping_ = true;
+    queue_.clear();
+    queuedBytes_ = 0U;
+  }
+  queueCondition_.notify_one();
+  if (writerThread_.joinable()) {
+    writerThread_.join();
+  }
+}
+
+void RemoteConnection::runWriter() {
+  std::unique_lock lock(queueMutex_);
+  while (true) {
+    queueCondition_.wait(
+            lock, [this]() { return isStopping_ || !queue_.empty() || (isOverflowed_ && !isCloseSent_); });
+    if (isStopping_) {
+      return;
+    }
+
+    if (isOverflowed_) {
+      isCloseSent_ = true;
+      lock.unlock();
+      {
+        std::lock_guard sendLock(sendMutex_);
+        webSocket_.sendClose(kOverflowCloseCode, "Event queue overflowed");
+      }
+      lock.lock();
+      continue;
+    }
+
+    const auto event = std::move(queue_.front());
+    queue_.pop_front();
+    queuedBytes_ -= static_cast<size_t>(event.message->getSize());
+
+    // Sending may block for as long as the client takes to read; the queue stays open to other threads meanwhile.
+    lock.unlock();
+    sendEvent(event);
+    lock.lock();
+  }
+}
+
+void RemoteConnection::sendEvent(const WSEvent& event) {
+  if (event.status == nullptr) {
+    sendFrame(event.message);
+    return;
+  }
+
+  StatusDelta delta;
+  if (!statusDeltas_.TryCreateDelta(event.statusSequence, *event.status, delta)) {
+    statusDeltas_.AddFullStatus(event.statusSequence, *event.status);
+    sendFrame(event.message);
+  } else if (encoding_ == EventEncoding::MsgPack) {
+    sendFrame(writerMsgPackEncoder_.EncodeStatusDelta(delta, *event.status));
+  } else {
+    sendFrame(serializeStatusDelta(delta, *event.status));
+  }
+}
+
+oatpp::String RemoteConnection::serializeStatusDelta(const StatusDelta& delta, const data::Status& status) const {
+  const auto deltaDto = dto::StatusDelta::createShared();
+  deltaDto->sequence = delta.sequence;
+  deltaDto->baseSequence = delta.baseSequence;
+  deltaDto->runstate = static_cast<dto::RunState>(status.runState);
+  deltaDto->names = oatpp::List<oatpp::Object<dto::InternedName>>::createShared();
+  for (const auto& [id, name] : delta.names) {
+    const auto nameDto = dto::InternedName::createShared();
+    nameDto->id = id;
+    nameDto->name = oatpp::String(name.data(), static_cast<v_buff_size>(name.size()), false);
+    deltaDto->names->push_back(nameDto);
+  }
+  deltaDto->unchangedFrameCount = delta.unchangedFrameCount;
+  const auto createFrameDtos = [](const std::vector<StatusDelta::Frame>& frames) {
+    auto frameDtos = oatpp::List<oatpp::Object<dto::StackEntryRef>>::createShared();
+    for (const auto& frame : frames) {
+      const auto frameDto = dto::StackEntryRef::createShared();
+      frameDto->fileId = frame.fileId;
+      frameDto->line = frame.line;
+      frameDto->functionId = frame.functionId;
+      frameDtos->push_back(frameDto);
+    }
+    return frameDtos;
+  };
+  deltaDto->frames = createFrameDtos(delta.frames);
+  deltaDto->bottomFrames = createFrameDtos(delta.bottomFrames);
+  deltaDto->stackDepth = status.stackDepth;
+  deltaDto->pausedAtBreakpointId = status.pausedAtBreakpointId;
+  deltaDto->pausedAtDataBreakpointId = status.pausedAtDataBreakpointId;
+  deltaDto->watches = oatpp::List<oatpp::Object<dto::WatchResult>>::createShared();
+  for (const auto& watchResult : status.watches) {
+    deltaDto->watches->push_back(DebugCommandController::CreateWatchResult(watchResult));
+  }
+
+  const auto wrapper = dto::EventMessageWrapper<dto::StatusDelta>::createShared();
+  wrapper->type = dto::EventMessageType::StatusDelta;
+  wrapper->message = deltaDto;
+  return mapper_->writeToString(wrapper);
+}
+
+void RemoteConnection::sendFrame(const oatpp::String& message) {
+  std::lock_guard lock(sendMutex_);
+  if (encoding_ == EventEncoding::MsgPack) {
+    webSocket_.sendOneFrameBinary(message);
+  } else {
+    webSocket_.sendOneFrameText(message);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -46,34 +212,86 @@ void RemoteConnection::sendMessage(const oatpp::String& message) {
 
 std::atomic<v_int32> WSInstanceListener::SOCKETS(0);
 
-void WSInstanceListener::broadcastMessage(const oatpp::String& message) {
-  OATPP_LOGD(TAG, "Broadcasting to %d clients: %s",
-             static_cast<uint32_t>(connections_.size()),
-             message->c_str())
-  for (const auto& connection : connections_) {
-    connection->sendMessage(message);
+void WSInstanceListener::broadcastMessages(const EventEncoding encoding, const std::vector<WSEvent>& messages) {
+  const auto connections = std::atomic_load(&connections_);
+  OATPP_LOGD(TAG, "Broadcasting %d messages, %d clients connected",
+             static_cast<uint32_t>(messages.size()),
+             static_cast<uint32_t>(connections->size()))
+  for (const auto& connection : *connections) {
+    if (connection->getEncoding() == encoding) {
+      connection->queueMessages(messages);
+    }
   }
 }
 
+bool WSInstanceListener::hasConnections(const EventEncoding encoding) const {
+  return hasConnections(encoding, OutputFormat::Line) || hasConnections(encoding, OutputFormat::Batched);
+}
+
+bool WSInstanceListener::hasConnections(const EventEncoding encoding, const OutputFormat outputFormat) const {
+  return connectionCounts_[static_cast<size_t>(encoding)][static_cast<size_t>(outputFormat)].load(
+                 std::memory_order_relaxed) > 0;
+}
+
+void WSInstanceListener::setCommandHandler(std::shared_ptr<WSCommandHandler> commandHandler) {
+  std::lock_guard lock(connectionsMutex_);
+  commandHandler_ = std::move(commandHandler);
+}
+
 void WSInstanceListener::onAfterCreate(const oatpp::websocket::WebSocket& socket, const std::shared_ptr<const ParameterMap>& params) {
 
   const auto oldCount = SOCKETS.fetch_add(1);
   OATPP_LOGD(TAG, "New Incoming Connection. Connection count=%d", oldCount + 1)
 
-  const auto remoteConnection = std::make_shared<RemoteConnection>(socket);
-  socket.setListener(remoteConnection);
+  // The encoding and output format were validated by the handshake endpoint
+  auto encoding = EventEncoding::Json;
+  auto outputFormat = OutputFormat::Line;
+  if (params != nullptr) {
+    const auto encodingPos = params->find("encoding");
+    if (encodingPos != params->end() && encodingPos->second == "msgpack") {
+      encoding = EventEncoding::MsgPack;
+      outputFormat = OutputFormat::Batched;
+    }
+    const auto outputPos = params->find("output");
+    if (outputPos != params->end() && outputPos->second == "batched") {
+      outputFormat = OutputFormat::Batched;
+    }
+  }
 
-  connections_.push_back(remoteConnection);
+  std::lock_guard lock(connectionsMutex_);
+  const auto remoteConnection = std::make_shared<RemoteConnection>(socket, encoding, outputFormat, commandHandler_);
+  socket.setListener(remoteConnection);
+  auto connections = std::make_shared<ConnectionList>(*connections_);
+  connections->push_back(remoteConnection);
+  std::atomic_store(&connections_, std::shared_ptr<const ConnectionList>(std::move(connections)));
+  connectionCounts_[static_cast<size_t>(encoding)][static_cast<size_t>(outputFormat)].fetch_add(
+          1, std::memory_order_relaxed);
 }
 
 void WSInstanceListener::onBeforeDestroy(const oatpp::websocket::WebSocket& socket) {
   const auto listener = socket.getListener();
+  std::shared_ptr<RemoteConnection> connection;
+  std::unique_lock lock(connectionsMutex_);
 
-  const auto pos = std::find_if(connections_.begin(), connections_.end(), [listener = listener.get()](const auto& conn) { return conn.get() == listener; });
-  if (pos == connections_.end()) {
+  auto connections = std::make_shared<ConnectionList>(*connections_);
+  const auto pos = std::find_if(connections->begin(), connections->end(), [listener = listener.get()](const auto& conn) {
+    return conn.get() == listener;
+  });
+  if (pos == connections->end()) {
     OATPP_LOGE(TAG, "Failed to remove connection.")
   } else {
-    connections_.erase(pos);
+    connection = *pos;
+    connectionCounts_[static_cast<size_t>(connection->getEncoding())][static_cast<size_t>(
+            connection->getOutputFormat())].fetch_sub(1, std::memory_order_relaxed);
+    connections->erase(pos);
+    std::atomic_store(&connections_, std::shared_ptr<const ConnectionList>(std::move(connections)));
+  }
+  lock.unlock();
+
+  // The broadcaster may still hold a snapshot with this connection in it, so the writer is stopped explicitly rather
+  // than when the connection is destroyed; the socket it writes to is about to be.
+  if (connection != nullptr) {
+    connection->stop();
   }
 
   auto oldCount = SOCKETS.fetch_add(-1);
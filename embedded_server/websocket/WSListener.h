@@ -9,22 +9,78 @@
 #include "oatpp-websocket/ConnectionHandler.hpp"
 #include "oatpp-websocket/WebSocket.hpp"
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
 
 #include <sdb/MessageInterface.h>
 
+#include "../MsgPackEventEncoder.h"
+#include "../StatusDeltaTracker.h"
+
 namespace oatpp::parser::json::mapping {
 class ObjectMapper;
 }
 
 namespace sdb {
+class WSCommandHandler;
+
+/**
+ * Format that events are sent to a connection in, chosen by the encoding query param of the handshake.
+ * Json events are sent as text frames, MsgPack events as binary frames with the same structure and field names.
+ */
+enum class EventEncoding {
+  Json,
+  MsgPack,
+  Count
+};
+
+/**
+ * How script output is sent to a connection, chosen by the output query param of the handshake. Line connections are
+ * sent an output_line event per line, as clients written before output was batched expect; Batched connections are
+ * sent output_lines events. Json connections are Line unless they ask otherwise, and MsgPack connections are always
+ * Batched.
+ */
+enum class OutputFormat {
+  Line,
+  Batched,
+  Count
+};
+
+/**
+ * An encoded event, shared by every connection that it is sent to.
+ */
+struct WSEvent {
+  oatpp::String message;
+  // Only set for status events, which are sent as a status_delta instead to connections that have acknowledged an
+  // earlier status.
+  std::shared_ptr<const data::Status> status;
+  uint64_t statusSequence = 0U;
+  // Only set for output events, which are only sent to connections with this output format.
+  std::optional<OutputFormat> outputFormat;
+};
+
 /**
  * WebSocket listener listens on incoming WebSocket events.
  */
 class RemoteConnection : public oatpp::websocket::WebSocket::Listener {
  public:
-  RemoteConnection(const WebSocket& webSocket);
+  RemoteConnection(
+          const WebSocket& webSocket, EventEncoding encoding, OutputFormat outputFormat,
+          std::shared_ptr<WSCommandHandler> commandHandler);
+  ~RemoteConnection() override;
+
+  // Deleted methods
+  RemoteConnection(const RemoteConnection& other) = delete;
+  RemoteConnection(const RemoteConnection&& other) = delete;
+  RemoteConnection& operator=(const RemoteConnection&) = delete;
+  RemoteConnection& operator=(RemoteConnection&&) = delete;
 
   /**
    * Called on "ping" frame.
@@ -46,19 +102,71 @@ class RemoteConnection : public oatpp::websocket::WebSocket::Listener {
    */
   void readMessage(const WebSocket& socket, v_uint8 opcode, p_char8 data, oatpp::v_io_size size) override;
 
-  void sendMessage(const oatpp::String& message);
+  /**
+   * Adds messages to the end of the send queue, without waiting for them to be sent. Output events for the other output
+   * format are skipped. Called both from the event sender thread and the connection's own thread (to respond to
+   * commands).
+   * If the client falls so far behind that the queue would exceed its limits, the queued messages are discarded and
+   * the connection is closed, as the client has missed events and needs to reconnect and request the status again.
+   */
+  void queueMessages(const std::vector<WSEvent>& messages);
+
+  /**
+   * Stops the writer thread, discarding any messages that haven't been sent. Must be called before the WebSocket is
+   * destroyed.
+   */
+  void stop();
+
+  [[nodiscard]] EventEncoding getEncoding() const {
+    return encoding_;
+  }
+
+  [[nodiscard]] OutputFormat getOutputFormat() const {
+    return outputFormat_;
+  }
 
  private:
   void handleCommandMessage(const WebSocket& socket, const oatpp::String& message);
+  // Sends the queued messages, in order; runs on writerThread_.
+  void runWriter();
+  void sendEvent(const WSEvent& event);
+  void sendFrame(const oatpp::String& message);
+  [[nodiscard]] oatpp::String serializeStatusDelta(const StatusDelta& delta, const data::Status& status) const;
 
   static constexpr const char* TAG = "Server_WSListener";
+  static constexpr size_t kMaxQueuedMessages = 1024U;
+  static constexpr size_t kMaxQueuedBytes = 16U * 1024U * 1024U;
+  // "Try Again Later"
+  static constexpr v_uint16 kOverflowCloseCode = 1013U;
 
   const WebSocket& webSocket_;
+  const EventEncoding encoding_;
+  const OutputFormat outputFormat_;
+  // Null until the embedded server has a command interface, in which case commands are ignored.
+  const std::shared_ptr<WSCommandHandler> commandHandler_;
+  // Used on the connection's own thread; writerMsgPackEncoder_ and mapper_ are used by the writer.
+  MsgPackEventEncoder msgPackEncoder_;
+  MsgPackEventEncoder writerMsgPackEncoder_;
+  std::shared_ptr<oatpp::parser::json::mapping::ObjectMapper> mapper_;
+  StatusDeltaTracker statusDeltas_;
+  // Frames must not be interleaved; pongs are sent from the connection's own thread, everything else by the writer.
+  std::mutex sendMutex_;
+
+  std::mutex queueMutex_;
+  std::condition_variable queueCondition_;
+  std::deque<WSEvent> queue_;
+  size_t queuedBytes_ = 0U;
+  bool isOverflowed_ = false;
+  bool isCloseSent_ = false;
+  bool isStopping_ = false;
 
   /**
    * Buffer for messages. Needed for multi-frame messages.
    */
   oatpp::data::stream::ChunkedBuffer messageBuffer_;
+
+  // Declared last, so that it starts after everything it uses is initialized.
+  std::thread writerThread_;
 };
 
 /**
@@ -73,7 +181,23 @@ class WSInstanceListener : public oatpp::websocket::ConnectionHandler::SocketIns
   static std::atomic<v_int32> SOCKETS;
 
  public:
-  void broadcastMessage(const oatpp::String& message);
+  /**
+   * Queues each message, in order, to every connected client that uses the given encoding. Called from the event sender
+   * thread; messages are shared between connections rather than copied, and a slow client doesn't delay the others.
+   */
+  void broadcastMessages(EventEncoding encoding, const std::vector<WSEvent>& messages);
+  /**
+   * Whether any client uses the given encoding, so that events don't need to be encoded in formats nobody reads.
+   */
+  [[nodiscard]] bool hasConnections(EventEncoding encoding) const;
+  /**
+   * As above, for clients that also use the given output format.
+   */
+  [[nodiscard]] bool hasConnections(EventEncoding encoding, OutputFormat outputFormat) const;
+  /**
+   * Used to run the commands that clients send on connections created after this is called.
+   */
+  void setCommandHandler(std::shared_ptr<WSCommandHandler> commandHandler);
   /**
    *  Called when socket is created
    */
@@ -86,7 +210,18 @@ class WSInstanceListener : public oatpp::websocket::ConnectionHandler::SocketIns
 
  private:
   static constexpr const char* TAG = "Server_WSInstanceListener";
-  std::vector<std::shared_ptr<RemoteConnection>> connections_;
+  using ConnectionList = std::vector<std::shared_ptr<RemoteConnection>>;
+
+  // Connections are added and removed on their own threads, while messages are broadcast from the sender thread.
+  // The list is copied on each change (under connectionsMutex_) and swapped in atomically, so broadcasting reads a
+  // snapshot of it without taking the lock.
+  std::mutex connectionsMutex_;
+  std::shared_ptr<const ConnectionList> connections_ = std::make_shared<const ConnectionList>();
+  std::shared_ptr<WSCommandHandler> commandHandler_;
+  // Indexed by encoding, then output format.
+  std::array<std::array<std::atomic<uint32_t>, static_cast<size_t>(OutputFormat::Count)>,
+             static_cast<size_t>(EventEncoding::Count)>
+          connectionCounts_ = {};
 };
 }// namespace qdb
 #endif// SAMPLE_APP_WSLISTENER_HWSLISTENER_H
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef SDB_JSON_STRING_H
+#define SDB_JSON_STRING_H
+
+#include <string_view>
+
+namespace sdb::json {
+
+// Writes str to sink as a JSON string. sink must have Put(char) and Put(std::string_view) methods.
+// Escapes quotes, backslashes and control characters. Everything else, including UTF-8 sequences, is copied as is.
+template<typename TSink>
+void WriteString(TSink& sink, const std::string_view str)
+{
+  static constexpr std::string_view kHexDigits = "0123456789abcdef";
+
+  sink.Put('"');
+  size_t runBegin = 0;
+  for (size_t i = 0; i < str.size(); ++i) {
+    const auto c = static_cast<unsigned char>(str[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    // Copy everything up to this character in one go
+    sink.Put(str.substr(runBegin, i - runBegin));
+    runBegin = i + 1;
+    switch (c) {
+      case '"': sink.Put("\\\""); break;
+      case '\\': sink.Put("\\\\"); break;
+      case '\n': sink.Put("\\n"); break;
+      case '\r': sink.Put("\\r"); break;
+      case '\t': sink.Put("\\t"); break;
+      default:
+        sink.Put("\\u00");
+        sink.Put(kHexDigits[c >> 4U]);
+        sink.Put(kHexDigits[c & 0xFU]);
+    }
+  }
+  sink.Put(str.substr(runBegin));
+  sink.Put('"');
+}
+
+}// namespace sdb::json
+
+#endif// SDB_JSON_STRING_H
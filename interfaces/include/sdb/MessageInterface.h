@@ -7,8 +7,10 @@
 #define SDB_MESSAGE_INTERFACE_H
 
 #include <cinttypes>
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace sdb {
@@ -31,12 +33,6 @@ struct StackEntry {
   uint32_t line;
   std::string function;
 };
-struct Status {
-  RunState runState = RunState::Paused;
-  std::vector<StackEntry> stack;
-  uint64_t pausedAtBreakpointId = 0;
-};
-
 struct OutputLine {
   std::string_view const output;
   bool isErr = false;
@@ -81,16 +77,69 @@ struct Variable {
   // If valueType is Instance, this is set with the full class name.
   std::string instanceClassName;
   bool editable = false;
+  // Index (in the returned list) of the variable that this is a child of, or -1 if it is a child of the requested path.
+  int32_t parentIndex = -1;
 };
 struct PaginationInfo {
   uint32_t beginIterator;
   uint32_t count;
+  // If not zero, the nextCursor returned by the previous page of the same variables request, which is resumed from
+  // instead of beginIterator. Cursors are only valid until the program resumes.
+  uint64_t cursor = 0;
+};
+enum class SummaryMode
+{
+  // Summarize the first few fields of each table or instance, sorted by key.
+  Sorted,
+  // Summarize the first summaryFieldCount fields in iteration order, without reading or sorting the remaining keys.
+  FirstFields,
+  // Leave the value of tables and instances empty. Summaries can then be fetched on demand via Get*Variable.
+  None
+};
+enum class FilterOperator
+{
+  None,
+  Equal,
+  NotEqual,
+  Less,
+  Greater,
+  // Value is a string that contains the filter value (case insensitive)
+  Contains
+};
+// Restricts which direct children of the requested path are returned. Every non-empty part must match.
+struct VariableFilter {
+  // Case insensitive. If it contains * or ? wildcards, the whole key must match; otherwise it matches any key
+  // containing it.
+  std::string keyPattern;
+  // If not empty, only children with one of these value types are returned.
+  std::vector<VariableType> valueTypes;
+  // Compares the child's value against `value`. Numbers are compared numerically, strings lexicographically.
+  FilterOperator valueOperator = FilterOperator::None;
+  std::string value;
+};
+struct VariableQueryOptions {
+  // How many levels below the requested path to recursively expand. 0 means only direct children are returned.
+  uint32_t expandDepth = 0;
+  // Maximum number of variables that will be returned, across all expanded levels.
+  uint32_t maxNodes = 1000;
+  // How the value of table and instance variables is built.
+  SummaryMode summaryMode = SummaryMode::Sorted;
+  // Maximum number of fields in each summary, when summaryMode is FirstFields.
+  uint32_t summaryFieldCount = 4;
+  // Total length of all summaries built for the request, plus a few bytes for each key read to build them. Once used
+  // up, remaining summaries are left empty; tables whose keys no longer fit are summarized in iteration order.
+  uint32_t summaryBudgetBytes = 16384;
+  // When set, pagination.count is the number of matching children to return, and children keep their real
+  // pathIterator.
+  VariableFilter filter;
 };
 struct CreateBreakpoint {
   // ID must be >= 1
   uint64_t id;
   // Line must be >= 1
   uint32_t line;
+  // Optional watch expression; if not empty, the breakpoint only pauses execution when it evaluates to a truthy value.
+  std::string condition;
 };
 struct ResolvedBreakpoint {
   uint64_t id;
@@ -103,6 +152,81 @@ struct ImmediateValue
   VariableScope scope;
   std::vector<uint32_t> iteratorPath;
 };
+struct ArraySlice {
+  // Integer or Float. Arrays that mix integers and floats are returned as Float; Null if the slice is empty.
+  VariableType elementType = VariableType::Null;
+  // Size in bytes of each element, which depends on how squirrel was compiled (_SQ64, SQUSEDOUBLE).
+  uint32_t elementSize = 0;
+  // Index of the first element in the slice
+  uint32_t beginIndex = 0;
+  // Total number of elements in the array
+  uint32_t arraySize = 0;
+  // Elements packed contiguously, in native byte order.
+  std::vector<uint8_t> data;
+};
+struct ArrayStatistics {
+  // Total number of elements in the array
+  uint32_t arraySize = 0;
+  // Number of elements within the requested range that were included in the statistics
+  uint32_t count = 0;
+  uint32_t nanCount = 0;
+  // min, max and mean ignore NaN values, and are only valid when count > nanCount.
+  double min = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+  // Element counts of equal width bins spanning [min, max]. Empty if min or max is not finite.
+  std::vector<uint32_t> histogram;
+};
+struct ExportOptions {
+  // Containers nested deeper than this are written as a truncation marker rather than expanded.
+  uint32_t maxDepth = 32;
+  // Maximum number of values to write, including containers.
+  uint32_t maxNodes = 100000;
+  // Export stops once this many bytes have been written; the closing brackets may take it slightly over.
+  uint64_t maxBytes = 64U * 1024U * 1024U;
+};
+struct ExportResult {
+  uint32_t nodeCount = 0;
+  uint64_t byteCount = 0;
+  // Number of containers that were written as a reference to an earlier occurrence, including cycles.
+  uint32_t sharedReferenceCount = 0;
+  // True if any of the ExportOptions limits were reached, so part of the graph is missing.
+  bool truncated = false;
+};
+struct PauseBundleConfig {
+  // If false, no bundle is built when the program pauses.
+  bool enabled = false;
+  // Maximum number of locals of the top stack frame to include.
+  uint32_t localsCount = 100;
+  // Maximum number of root table entries to include.
+  uint32_t globalsCount = 100;
+};
+struct PauseBundle {
+  std::vector<Variable> locals;
+  std::vector<Variable> globals;
+};
+struct WatchResult {
+  // ID returned by MessageCommandInterface::AddWatch
+  uint64_t id = 0;
+  std::string watch;
+  ReturnCode code = ReturnCode::Success;
+  ImmediateValue value;
+};
+struct Status {
+  // Most frames that are included in stack; the rest can be read with MessageCommandInterface::GetStack.
+  static constexpr uint32_t kMaxStackFrames = 32U;
+
+  RunState runState = RunState::Paused;
+  // The top of the stack (innermost frame first), at most kMaxStackFrames of it.
+  std::vector<StackEntry> stack;
+  // Number of frames in the whole stack.
+  uint32_t stackDepth = 0;
+  uint64_t pausedAtBreakpointId = 0;
+  // ID of the data breakpoint whose value changed, if that is what caused the pause.
+  uint64_t pausedAtDataBreakpointId = 0;
+  // Results of every registered watch, evaluated in the scope of the top stack frame. Only set when paused.
+  std::vector<WatchResult> watches;
+};
 }// namespace data
 
 /// <summary>
@@ -152,12 +276,57 @@ class MessageCommandInterface {
   /// </summary>
   [[nodiscard]] virtual data::ReturnCode SendStatus() = 0;
 
+  /// <summary>
+  /// Reads a range of the stack frames, where frame 0 is the innermost, for stacks deeper than Status::stack holds.
+  /// stackDepth is set to the number of frames in the whole stack. Can only be called while paused.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode GetStack(
+          const data::PaginationInfo& range, std::vector<data::StackEntry>& stack, uint32_t& stackDepth) = 0;
+
+  /// <summary>
+  /// Reads a number that changes each time the program pauses, and stays the same until it resumes. Apart from edits
+  /// made with SetStackVariableValue, reading the same variables twice with the same epoch gives the same result, so it
+  /// can be used to cache them. Can only be called while paused.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode GetPauseEpoch(uint32_t& pauseEpoch) = 0;
+
+  /// <summary>
+  /// Lists the children of the variable at the given path. If options.expandDepth is greater than zero, children are
+  /// recursively expanded and returned as a flattened tree in pre-order (see Variable::parentIndex).
+  /// nextCursor is set to a cursor for the following page of children, or 0 if this page reached the end. The
+  /// following page may be empty when a filter is set.
+  /// </summary>
   [[nodiscard]] virtual data::ReturnCode GetStackVariables(
           uint32_t stackFrame, const std::string& path, const data::PaginationInfo& pagination,
-          std::vector<data::Variable>& variables) = 0;
+          const data::VariableQueryOptions& options, std::vector<data::Variable>& variables, uint64_t& nextCursor) = 0;
 
   [[nodiscard]] virtual data::ReturnCode GetGlobalVariables(
-          const std::string& path, const data::PaginationInfo& pagination, std::vector<data::Variable>& variables) = 0;
+          const std::string& path, const data::PaginationInfo& pagination, const data::VariableQueryOptions& options,
+          std::vector<data::Variable>& variables, uint64_t& nextCursor) = 0;
+
+  /// <summary>
+  /// Reads a single variable at the given path, with a full summary as its value. Useful to fill in a value that was
+  /// left empty by VariableQueryOptions::summaryMode or summaryBudgetBytes.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode GetStackVariable(
+          uint32_t stackFrame, const std::string& path, data::Variable& variable) = 0;
+
+  [[nodiscard]] virtual data::ReturnCode GetGlobalVariable(const std::string& path, data::Variable& variable) = 0;
+
+  /// <summary>
+  /// Reads a range of an array that contains only integer and float values, as a packed buffer. Much cheaper than
+  /// listing the elements as variables for large arrays. If stackFrame is -1, path is relative to the root table.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode GetArraySlice(
+          int32_t stackFrame, const std::string& path, const data::PaginationInfo& range, data::ArraySlice& slice) = 0;
+
+  /// <summary>
+  /// Computes statistics over a range of an array that contains only integer and float values, without sending the
+  /// elements themselves. If stackFrame is -1, path is relative to the root table.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode GetArrayStatistics(
+          int32_t stackFrame, const std::string& path, const data::PaginationInfo& range, uint32_t histogramBinCount,
+          data::ArrayStatistics& statistics) = 0;
 
   [[nodiscard]] virtual data::ReturnCode SetStackVariableValue(
           uint32_t stackFrame, const std::string& path, const std::string& newValueString, data::Variable& newValue) = 0;
@@ -165,14 +334,51 @@ class MessageCommandInterface {
 
   /// <summary>
   /// Evaluate the expression in the scope of this stack frame. If -1, the expression is evaluated in the global scope.
+  /// Expressions may use member and index accessors, arithmetic, comparisons, && and ||, and len().
   /// </summary>
   [[nodiscard]] virtual data::ReturnCode GetImmediateValue(
           int32_t stackFrame, const std::string& watch, const data::PaginationInfo& pagination,
           data::ImmediateValue& variable) = 0;
 
+  /// <summary>
+  /// Serializes the value of the watch expression, and everything reachable from it, to JSON in a single pass while
+  /// the program stays paused. Output is passed to writeFn in chunks as it is produced; if writeFn returns false the
+  /// export is abandoned. writeFn is called with the debugger locked, so must not call back into it.
+  /// A container that was already written (a cycle, or a reference shared by two parents) is written as
+  /// {"$ref": "<JSON pointer to the first occurrence>"}.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode ExportVariable(
+          int32_t stackFrame, const std::string& watch, const data::ExportOptions& options,
+          const std::function<bool(std::string_view)>& writeFn, data::ExportResult& result) = 0;
+
   [[nodiscard]] virtual data::ReturnCode SetFileBreakpoints(
           const std::string& file, const std::vector<data::CreateBreakpoint>& createBps,
           std::vector<data::ResolvedBreakpoint>& resolvedBps) = 0;
+
+  /// <summary>
+  /// Configures the bundle of variables that is built each time the program pauses, and sent to
+  /// MessageEventInterface::HandlePauseBundle directly after the status.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode SetPauseBundleConfig(const data::PauseBundleConfig& config) = 0;
+
+  /// <summary>
+  /// Registers a watch expression, which is evaluated each time the program pauses. Results are sent in
+  /// Status::watches. The expression is only parsed once, here.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode AddWatch(const std::string& watch, uint64_t& watchId) = 0;
+
+  [[nodiscard]] virtual data::ReturnCode RemoveWatch(uint64_t watchId) = 0;
+
+  /// <summary>
+  /// Adds a data breakpoint, which pauses the program on the first line that runs after the value of a table slot,
+  /// array element or instance field changes. watch must be a path ending in an accessor (eg. player.health); it is
+  /// resolved once, here, in the scope of the given stack frame (-1 for the global scope), and the container is then
+  /// watched directly. Can only be called while paused.
+  /// </summary>
+  [[nodiscard]] virtual data::ReturnCode AddDataBreakpoint(
+          int32_t stackFrame, const std::string& watch, uint64_t& dataBreakpointId) = 0;
+
+  [[nodiscard]] virtual data::ReturnCode RemoveDataBreakpoint(uint64_t dataBreakpointId) = 0;
 };
 
 /// <summary>
@@ -193,6 +399,9 @@ class MessageEventInterface {
   // Interface definition
   virtual void HandleStatusChanged(const data::Status& status) = 0;
   virtual void HandleOutputLine(const data::OutputLine& outputLine) = 0;
+
+  // Only called if a pause bundle has been enabled via MessageCommandInterface::SetPauseBundleConfig
+  virtual void HandlePauseBundle(const data::PauseBundle& pauseBundle) = 0;
 };
 }// namespace sdb
 
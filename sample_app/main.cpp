@@ -29,6 +29,7 @@
 #include <unordered_map>
 
 using sdb::EmbeddedServer;
+using sdb::ListenerConfig;
 using sdb::SquirrelDebugger;
 using sdb::data::ReturnCode;
 using std::cerr;
@@ -65,6 +66,8 @@ class SampleApp {
  public:
   struct InitArgs {
     uint16_t debuggerPort = 8000U;
+    bool asyncServer = false;
+    std::string exportDirectory;
   };
   struct RunArgs {
     std::string file;
@@ -80,7 +83,13 @@ class SampleApp {
   void Initialize(const InitArgs& args)
   {
     EmbeddedServer::InitEnvironment();
-    ep_.reset(EmbeddedServer::Create(args.debuggerPort));
+    ListenerConfig listenerConfig;
+    listenerConfig.port = args.debuggerPort;
+    if (args.asyncServer) {
+      listenerConfig.connectionMode = ListenerConfig::ConnectionMode::Async;
+    }
+    listenerConfig.exportDirectory = args.exportDirectory;
+    ep_.reset(EmbeddedServer::Create(listenerConfig));
 
     debugger_ = std::make_shared<SquirrelDebugger>();
     ep_->SetCommandInterface(debugger_);
@@ -322,12 +331,21 @@ int main(int argc, char** argv)
               "p", "port", "Network port which the debugger will listen on", false, initArgs.debuggerPort,
               "unsigned integer");
       cmd.add(portArg);
+      const TCLAP::SwitchArg asyncServer(
+              "a", "async_server", "If set, the debugger serves HTTP connections from a fixed pool of threads", cmd,
+              initArgs.asyncServer);
+      TCLAP::ValueArg exportDirArg(
+              "e", "export_dir", "Directory that the debugger may write variable exports to. Disabled if not set",
+              false, initArgs.exportDirectory, "string");
+      cmd.add(exportDirArg);
 
       cmd.parse(argc, argv);
 
       runArgs.file = fileArg.getValue();
       runArgs.breakOnStart = breakOnStart.getValue();
       initArgs.debuggerPort = portArg.getValue();
+      initArgs.asyncServer = asyncServer.getValue();
+      initArgs.exportDirectory = exportDirArg.getValue();
     }
     catch (TCLAP::ArgException& e) {
       std::stringstream ss;
@@ -0,0 +1,177 @@
+#include "ArrayStatistics.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SDB_ARRAY_STATISTICS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace sdb {
+namespace {
+struct StatisticsAccumulator {
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  double sum = 0.0;
+  size_t nanCount = 0;
+};
+
+template<typename T>
+void AccumulateScalar(const T* values, const size_t count, StatisticsAccumulator& acc)
+{
+  for (size_t i = 0; i < count; ++i) {
+    const auto value = static_cast<double>(values[i]);
+    if constexpr (std::is_floating_point_v<T>) {
+      if (std::isnan(value)) {
+        ++acc.nanCount;
+        continue;
+      }
+    }
+    acc.min = std::min(acc.min, value);
+    acc.max = std::max(acc.max, value);
+    acc.sum += value;
+  }
+}
+
+#ifdef SDB_ARRAY_STATISTICS_SSE2
+// Number of set bits in a 4 bit movemask result
+constexpr std::array<uint8_t, 16> kMaskBitCount = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+// Each kernel processes as many whole vectors as it can and returns how many values were consumed; the remainder is
+// left to AccumulateScalar.
+// Note that minps/maxps return the second operand if either is NaN, so passing the running value second means NaN
+// lanes leave it unchanged. NaN lanes are masked to zero before summing.
+size_t AccumulateSse2(const float* values, const size_t count, StatisticsAccumulator& acc)
+{
+  const size_t vectorCount = count & ~static_cast<size_t>(3U);
+  if (vectorCount == 0) {
+    return 0;
+  }
+
+  __m128 minV = _mm_set1_ps(std::numeric_limits<float>::infinity());
+  __m128 maxV = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+  // Sum in double precision, as float sums lose precision quickly over large arrays.
+  __m128d sumLo = _mm_setzero_pd();
+  __m128d sumHi = _mm_setzero_pd();
+  size_t validCount = 0;
+  for (size_t i = 0; i < vectorCount; i += 4) {
+    const __m128 x = _mm_loadu_ps(values + i);
+    const __m128 notNan = _mm_cmpord_ps(x, x);
+    validCount += kMaskBitCount[_mm_movemask_ps(notNan)];
+    minV = _mm_min_ps(x, minV);
+    maxV = _mm_max_ps(x, maxV);
+    const __m128 validX = _mm_and_ps(x, notNan);
+    sumLo = _mm_add_pd(sumLo, _mm_cvtps_pd(validX));
+    sumHi = _mm_add_pd(sumHi, _mm_cvtps_pd(_mm_movehl_ps(validX, validX)));
+  }
+
+  alignas(16) std::array<float, 4> minLanes = {};
+  alignas(16) std::array<float, 4> maxLanes = {};
+  alignas(16) std::array<double, 2> sumLanes = {};
+  _mm_store_ps(minLanes.data(), minV);
+  _mm_store_ps(maxLanes.data(), maxV);
+  _mm_store_pd(sumLanes.data(), _mm_add_pd(sumLo, sumHi));
+  for (size_t lane = 0; lane < 4; ++lane) {
+    acc.min = std::min(acc.min, static_cast<double>(minLanes[lane]));
+    acc.max = std::max(acc.max, static_cast<double>(maxLanes[lane]));
+  }
+  acc.sum += sumLanes[0] + sumLanes[1];
+  acc.nanCount += vectorCount - validCount;
+  return vectorCount;
+}
+
+size_t AccumulateSse2(const double* values, const size_t count, StatisticsAccumulator& acc)
+{
+  const size_t vectorCount = count & ~static_cast<size_t>(1U);
+  if (vectorCount == 0) {
+    return 0;
+  }
+
+  __m128d minV = _mm_set1_pd(std::numeric_limits<double>::infinity());
+  __m128d maxV = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+  __m128d sumV = _mm_setzero_pd();
+  size_t validCount = 0;
+  for (size_t i = 0; i < vectorCount; i += 2) {
+    const __m128d x = _mm_loadu_pd(values + i);
+    const __m128d notNan = _mm_cmpord_pd(x, x);
+    validCount += kMaskBitCount[_mm_movemask_pd(notNan)];
+    minV = _mm_min_pd(x, minV);
+    maxV = _mm_max_pd(x, maxV);
+    sumV = _mm_add_pd(sumV, _mm_and_pd(x, notNan));
+  }
+
+  alignas(16) std::array<double, 2> minLanes = {};
+  alignas(16) std::array<double, 2> maxLanes = {};
+  alignas(16) std::array<double, 2> sumLanes = {};
+  _mm_store_pd(minLanes.data(), minV);
+  _mm_store_pd(maxLanes.data(), maxV);
+  _mm_store_pd(sumLanes.data(), sumV);
+  acc.min = std::min({acc.min, minLanes[0], minLanes[1]});
+  acc.max = std::max({acc.max, maxLanes[0], maxLanes[1]});
+  acc.sum += sumLanes[0] + sumLanes[1];
+  acc.nanCount += vectorCount - validCount;
+  return vectorCount;
+}
+#endif
+
+template<typename T>
+void ComputeHistogram(
+        const T* values, const size_t count, const double min, const double max, std::vector<uint32_t>& histogram)
+{
+  const auto binCount = histogram.size();
+  const auto range = max - min;
+  const auto scale = range > 0.0 ? static_cast<double>(binCount) / range : 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    const auto value = static_cast<double>(values[i]);
+    if constexpr (std::is_floating_point_v<T>) {
+      if (std::isnan(value)) {
+        continue;
+      }
+    }
+    const auto bin = std::min(static_cast<size_t>((value - min) * scale), binCount - 1);
+    ++histogram[bin];
+  }
+}
+}// namespace
+
+template<typename T>
+void ComputeArrayStatistics(
+        const T* values, const size_t count, const uint32_t histogramBinCount, data::ArrayStatistics& statistics)
+{
+  StatisticsAccumulator acc;
+  size_t scalarBegin = 0;
+#ifdef SDB_ARRAY_STATISTICS_SSE2
+  if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+    scalarBegin = AccumulateSse2(values, count, acc);
+  }
+#endif
+  AccumulateScalar(values + scalarBegin, count - scalarBegin, acc);
+
+  statistics.count = static_cast<uint32_t>(count);
+  statistics.nanCount = static_cast<uint32_t>(acc.nanCount);
+  statistics.histogram.clear();
+  const auto validCount = count - acc.nanCount;
+  if (validCount == 0) {
+    return;
+  }
+
+  statistics.min = acc.min;
+  statistics.max = acc.max;
+  statistics.mean = acc.sum / static_cast<double>(validCount);
+
+  if (histogramBinCount > 0 && std::isfinite(acc.min) && std::isfinite(acc.max)) {
+    statistics.histogram.resize(histogramBinCount);
+    ComputeHistogram(values, count, acc.min, acc.max, statistics.histogram);
+  }
+}
+
+template void ComputeArrayStatistics<float>(const float*, size_t, uint32_t, data::ArrayStatistics&);
+template void ComputeArrayStatistics<double>(const double*, size_t, uint32_t, data::ArrayStatistics&);
+template void ComputeArrayStatistics<int>(const int*, size_t, uint32_t, data::ArrayStatistics&);
+template void ComputeArrayStatistics<long>(const long*, size_t, uint32_t, data::ArrayStatistics&);
+template void ComputeArrayStatistics<long long>(const long long*, size_t, uint32_t, data::ArrayStatistics&);
+}// namespace sdb
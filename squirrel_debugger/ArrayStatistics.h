@@ -0,0 +1,23 @@
+#pragma once
+
+#ifndef SDB_ARRAY_STATISTICS_H
+#define SDB_ARRAY_STATISTICS_H
+
+#include "sdb/MessageInterface.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sdb {
+
+// Computes min/max/mean/NaN count and a histogram of the given contiguous values. Only `count`, `nanCount`, `min`,
+// `max`, `mean` and `histogram` are written to `statistics`.
+// Uses SSE2 kernels for float and double values where available, and a scalar loop otherwise.
+// Instantiated for float, double, int, long and long long.
+template<typename T>
+void ComputeArrayStatistics(
+        const T* values, size_t count, uint32_t histogramBinCount, data::ArrayStatistics& statistics);
+
+}// namespace sdb
+
+#endif// SDB_ARRAY_STATISTICS_H
@@ -19,7 +19,7 @@ using sdb::BreakpointMap;
 constexpr bool kCaseInsensitivePaths = true;// need this on windows
 const char* const kTag = "BreakpointMap";
 
-void BreakpointMap::Clear(const FileNameHandle& handle)
+void BreakpointMap::Clear(const FileNameHandle& handle, std::vector<Breakpoint>& removedBreakpoints)
 {
   if (handle == nullptr) {
     SDB_LOGE(kTag, "Clear: Null FileNameHandle provided");
@@ -31,6 +31,9 @@ void BreakpointMap::Clear(const FileNameHandle& handle)
     return;
   }
 
+  for (auto& [line, bp] : bpMapPos->second) {
+    removedBreakpoints.emplace_back(std::move(bp));
+  }
   bpMapPos->second.clear();
 }
 
@@ -69,6 +72,15 @@ bool BreakpointMap::ReadBreakpoint(const FileNameHandle& handle, const uint32_t
   return true;
 }
 
+void BreakpointMap::ForEach(const std::function<void(const Breakpoint&)>& func) const
+{
+  for (const auto& [handle, bpMap] : breakpoints_) {
+    for (const auto& [line, bp] : bpMap) {
+      func(bp);
+    }
+  }
+}
+
 BreakpointMap::FileNameHandle BreakpointMap::FindFileNameHandle(const std::string& fileName) const
 {
   FileNameHandle handle;
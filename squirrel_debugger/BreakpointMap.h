@@ -6,14 +6,22 @@
 #ifndef SDB_BREAKPOINT_MAP_H
 #define SDB_BREAKPOINT_MAP_H
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace sdb {
+namespace sq {
+class CompiledExpression;
+}// namespace sq
+
 struct Breakpoint {
   uint64_t id = 0;
   uint32_t line = 0;
+  // If set, execution only pauses at this breakpoint when the condition is truthy.
+  std::shared_ptr<sq::CompiledExpression> condition;
 };
 
 class BreakpointMap {
@@ -30,7 +38,10 @@ class BreakpointMap {
    */
   FileNameHandle EnsureFileNameHandle(const std::string& fileName);
 
-  void Clear(const FileNameHandle& handle);
+  /**
+   * Removes all breakpoints in the given file, appending them to `removedBreakpoints`.
+   */
+  void Clear(const FileNameHandle& handle, std::vector<Breakpoint>& removedBreakpoints);
 
   /**
    * Adds all of the given breakpoints. If a breakpoint already exists on the given line, it will be replaced.
@@ -42,6 +53,9 @@ class BreakpointMap {
   // If a breakpoint is fund, it is assigned to `bp`
   bool ReadBreakpoint(const FileNameHandle& handle, uint32_t line, Breakpoint& bp) const;
 
+  // Calls func with every breakpoint, in no particular order.
+  void ForEach(const std::function<void(const Breakpoint&)>& func) const;
+
  private:
   std::vector<FileNameHandle> fileNames_;
   std::unordered_map<FileNameHandle, std::unordered_map<uint32_t, Breakpoint>> breakpoints_;
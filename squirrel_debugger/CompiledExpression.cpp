@@ -0,0 +1,1033 @@
+#include "CompiledExpression.h"
+
+#include <sdb/LogInterface.h>
+
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+using sdb::data::ReturnCode;
+
+namespace sdb::sq {
+namespace {
+const char* const kLogTag = "CompiledExpression";
+
+using OpCode = CompiledExpression::OpCode;
+using Instruction = CompiledExpression::Instruction;
+using Constant = CompiledExpression::Constant;
+
+std::string ReadString(std::string::const_iterator& pos, std::string::const_iterator end)
+{
+  const char enclosingChar = *(pos++);
+  const char* eofError =
+          enclosingChar == '\'' ? "Encountered EOF when looking for '" : "Encountered EOF when looking for \"";
+
+  const auto processStringEscape = [&](std::string& dest, const int maxDigits) {
+    char c = *(++pos);
+    if (pos == end) {
+      throw WatchParseError(eofError, pos);
+    }
+    if (0 == isxdigit(c)) {
+      throw WatchParseError("hexadecimal number expected", pos);
+    }
+    int n = 0;
+    while (0 != isxdigit(c) && n < maxDigits) {
+      dest[n] = c;
+      ++n;
+      c = *(++pos);
+      if (pos == end) {
+        throw WatchParseError(eofError, pos);
+      }
+    }
+  };
+
+  std::string output;
+  for (; pos != end; ++pos) {
+    switch (char c = *pos; c) {
+      case '\\':
+        c = *(++pos);
+        if (pos == end) {
+          throw WatchParseError(eofError, pos);
+        }
+        switch (c) {
+          case 't':
+            output += '\t';
+            break;
+          case 'a':
+            output += '\a';
+            break;
+          case 'b':
+            output += '\b';
+            break;
+          case 'n':
+            output += '\n';
+            break;
+          case 'r':
+            output += '\r';
+            break;
+          case 'v':
+            output += '\v';
+            break;
+          case 'f':
+            output += '\f';
+            break;
+          case '0':
+            output += '\0';
+            break;
+          case '\\':
+          case '"':
+          case '\'':
+            output += c;
+            break;
+          case 'x':
+          {
+            const size_t maxDigits = sizeof(SQChar) * 2;
+            std::string temp(maxDigits, '0');
+            processStringEscape(temp, maxDigits);
+            char* stemp;
+            output += static_cast<SQChar>(scstrtoul(temp.c_str(), &stemp, 16));
+            break;
+          }
+          case 'u':
+          case 'U':
+          {
+            const size_t maxDigits = c == 'u' ? 4 : 8;
+            std::string temp(maxDigits, '0');
+            processStringEscape(temp, 8);
+            char* stemp;
+#ifdef SQUNICODE
+#if WCHAR_SIZE == 2
+#error not implemented
+#else
+#error not implemented
+#endif
+#else
+            output += static_cast<SQChar>(scstrtoul(temp.c_str(), &stemp, 16));
+#endif
+            break;
+          }
+          default:
+            throw WatchParseError("unknown escape character", pos);
+        }
+        break;
+      case '"':
+      case '\'':
+        if (c == enclosingChar) {
+          ++pos;
+          return output;
+        }
+        output += c;
+        break;
+      case '\n':
+        throw WatchParseError("newline in an inline string", pos);
+      default:
+        output += c;
+    }
+  }
+
+  return output;
+}
+
+using UnsignedInteger = std::make_unsigned_t<SQInteger>;
+
+HSQOBJECT MakeInteger(const SQInteger value)
+{
+  HSQOBJECT obj;
+  sq_resetobject(&obj);
+  obj._type = OT_INTEGER;
+  obj._unVal.nInteger = value;
+  return obj;
+}
+
+HSQOBJECT MakeFloat(const SQFloat value)
+{
+  HSQOBJECT obj;
+  sq_resetobject(&obj);
+  obj._type = OT_FLOAT;
+  obj._unVal.fFloat = value;
+  return obj;
+}
+
+HSQOBJECT MakeBool(const bool value)
+{
+  HSQOBJECT obj;
+  sq_resetobject(&obj);
+  obj._type = OT_BOOL;
+  obj._unVal.nInteger = value ? 1 : 0;
+  return obj;
+}
+
+SQFloat ToFloat(const HSQOBJECT& obj)
+{
+  return sq_isfloat(obj) ? obj._unVal.fFloat : static_cast<SQFloat>(obj._unVal.nInteger);
+}
+
+bool IsTruthy(const HSQOBJECT& obj)
+{
+  if (sq_isnull(obj)) {
+    return false;
+  }
+  if (sq_isbool(obj) || sq_isinteger(obj)) {
+    return obj._unVal.nInteger != 0;
+  }
+  if (sq_isfloat(obj)) {
+    return obj._unVal.fFloat != 0;
+  }
+  return true;
+}
+
+// Expects a table, instance or array at the top of the stack. On success, pushes the value of the given key.
+// If keyIndex is given, the key's iterator is also found.
+ReturnCode PushMember(HSQUIRRELVM v, const HSQOBJECT& key, KeyIteratorIndex* keyIndex, uint32_t& iterator)
+{
+  switch (sq_gettype(v, -1)) {
+    case OT_ARRAY:
+      if (!sq_isinteger(key)) {
+        SDB_LOGD(kLogTag, "Failed to get from array, key is not an integer.");
+        return ReturnCode::InvalidParameter;
+      }
+      sq_pushobject(v, key);
+      if (!SQ_SUCCEEDED(sq_get(v, -2))) {
+        SDB_LOGD(kLogTag, "Failed to get array index %" PRId64, static_cast<int64_t>(key._unVal.nInteger));
+        return ReturnCode::InvalidParameter;
+      }
+      iterator = static_cast<uint32_t>(key._unVal.nInteger);
+      return ReturnCode::Success;
+    case OT_TABLE:
+    case OT_INSTANCE:
+      if (keyIndex != nullptr) {
+        return keyIndex->PushValue(v, key, iterator);
+      }
+      sq_pushobject(v, key);
+      if (!SQ_SUCCEEDED(sq_get(v, -2))) {
+        SDB_LOGD(kLogTag, "No matching key in table");
+        return ReturnCode::InvalidParameter;
+      }
+      return ReturnCode::Success;
+    default:
+      SDB_LOGD(kLogTag, "Accessor used on a non iterable type");
+      return ReturnCode::InvalidParameter;
+  }
+}
+
+// Values of a local slot, other than the nSeq that a local was found at.
+constexpr int32_t kUnresolvedSlot = -1;
+constexpr int32_t kNotLocalSlot = -2;
+
+// Returns the nSeq of the first local in stackFrame with the given name, or kNotLocalSlot if there is none.
+int32_t FindLocal(HSQUIRRELVM v, const int32_t stackFrame, const std::string& name, HSQOBJECT& value)
+{
+  for (SQUnsignedInteger nSeq = 0;; ++nSeq) {
+    const auto* const localName = sq_getlocal(v, stackFrame, nSeq);
+    if (localName == nullptr) {
+      break;
+    }
+    if (name == localName) {
+      sq_getstackobj(v, -1, &value);
+      sq_poptop(v);// pop local variable
+      return static_cast<int32_t>(nSeq);
+    }
+    sq_poptop(v);// pop local variable
+  }
+  return kNotLocalSlot;
+}
+
+// Reads the local at nSeq in stackFrame if it has the given name.
+bool ReadLocalIfNamed(
+        HSQUIRRELVM v, const int32_t stackFrame, const int32_t nSeq, const std::string& name, HSQOBJECT& value)
+{
+  const auto* const localName = sq_getlocal(v, stackFrame, static_cast<SQUnsignedInteger>(nSeq));
+  if (localName == nullptr) {
+    return false;
+  }
+  const bool isNamed = name == localName;
+  if (isNamed) {
+    sq_getstackobj(v, -1, &value);
+  }
+  sq_poptop(v);// pop local variable
+  return isNamed;
+}
+
+// Looks for a local, then a root table entry, with the given name.
+// When reading locals from stackFrame, localSlot (if given) remembers where the name was found: kUnresolvedSlot if it
+// hasn't been looked for yet, kNotLocalSlot if it isn't a local, otherwise its nSeq. The name at that nSeq is checked
+// before it is used, in case the function has different locals in scope at this point.
+ReturnCode LoadName(
+        HSQUIRRELVM v, const int32_t stackFrame, int32_t* localSlot, const StackLocals* locals, const Constant& name,
+        KeyIteratorIndex* keyIndex, data::ImmediateValue* pathValue, HSQOBJECT& value)
+{
+  if (locals != nullptr) {
+    const auto localPos = locals->indexByName.find(name.string);
+    if (localPos != locals->indexByName.end()) {
+      value = locals->locals[localPos->second].value;
+      if (pathValue != nullptr) {
+        pathValue->scope = data::VariableScope::Local;
+        pathValue->iteratorPath.push_back(localPos->second);
+      }
+      return ReturnCode::Success;
+    }
+  }
+  else if (stackFrame >= 0) {
+    auto nSeq = localSlot != nullptr ? *localSlot : kUnresolvedSlot;
+    if (nSeq >= 0 && !ReadLocalIfNamed(v, stackFrame, nSeq, name.string, value)) {
+      nSeq = kUnresolvedSlot;
+    }
+    if (nSeq == kUnresolvedSlot) {
+      nSeq = FindLocal(v, stackFrame, name.string, value);
+      if (localSlot != nullptr) {
+        *localSlot = nSeq;
+      }
+    }
+    if (nSeq >= 0) {
+      if (pathValue != nullptr) {
+        pathValue->scope = data::VariableScope::Local;
+        pathValue->iteratorPath.push_back(static_cast<uint32_t>(nSeq));
+      }
+      return ReturnCode::Success;
+    }
+  }
+
+  sq_pushroottable(v);
+  uint32_t iterator = 0;
+  const auto rc = PushMember(v, name.object, keyIndex, iterator);
+  if (rc == ReturnCode::Success) {
+    sq_getstackobj(v, -1, &value);
+    sq_poptop(v);// pop value
+    if (pathValue != nullptr) {
+      pathValue->scope = data::VariableScope::Global;
+      pathValue->iteratorPath.push_back(iterator);
+    }
+  }
+  else {
+    SDB_LOGD(kLogTag, "No local or global variable named %s", name.string.c_str());
+  }
+  sq_poptop(v);// pop root table
+  return rc;
+}
+
+ReturnCode Length(HSQUIRRELVM v, const HSQOBJECT& obj, HSQOBJECT& length)
+{
+  const auto type = sq_type(obj);
+  if (type != OT_STRING && type != OT_TABLE && type != OT_ARRAY) {
+    SDB_LOGD(kLogTag, "len() requires a string, table or array");
+    return ReturnCode::InvalidParameter;
+  }
+  sq_pushobject(v, obj);
+  length = MakeInteger(sq_getsize(v, -1));
+  sq_poptop(v);
+  return ReturnCode::Success;
+}
+
+ReturnCode Arithmetic(const OpCode op, const HSQOBJECT& a, const HSQOBJECT& b, HSQOBJECT& result)
+{
+  if (!sq_isnumeric(a) || !sq_isnumeric(b)) {
+    SDB_LOGD(kLogTag, "Arithmetic requires integer or float operands");
+    return ReturnCode::InvalidParameter;
+  }
+
+  if (sq_isinteger(a) && sq_isinteger(b)) {
+    // Wrap on overflow, as Squirrel does.
+    const auto x = a._unVal.nInteger;
+    const auto y = b._unVal.nInteger;
+    const auto ux = static_cast<UnsignedInteger>(x);
+    const auto uy = static_cast<UnsignedInteger>(y);
+    switch (op) {
+      case OpCode::Add:
+        result = MakeInteger(static_cast<SQInteger>(ux + uy));
+        return ReturnCode::Success;
+      case OpCode::Subtract:
+        result = MakeInteger(static_cast<SQInteger>(ux - uy));
+        return ReturnCode::Success;
+      case OpCode::Multiply:
+        result = MakeInteger(static_cast<SQInteger>(ux * uy));
+        return ReturnCode::Success;
+      default:
+        if (y == 0 || (y == -1 && x == std::numeric_limits<SQInteger>::min())) {
+          SDB_LOGD(kLogTag, "Integer division by zero or overflow");
+          return ReturnCode::InvalidParameter;
+        }
+        result = MakeInteger(op == OpCode::Divide ? x / y : x % y);
+        return ReturnCode::Success;
+    }
+  }
+
+  const auto x = ToFloat(a);
+  const auto y = ToFloat(b);
+  switch (op) {
+    case OpCode::Add:
+      result = MakeFloat(x + y);
+      break;
+    case OpCode::Subtract:
+      result = MakeFloat(x - y);
+      break;
+    case OpCode::Multiply:
+      result = MakeFloat(x * y);
+      break;
+    case OpCode::Divide:
+      result = MakeFloat(x / y);
+      break;
+    default:
+      result = MakeFloat(std::fmod(x, y));
+      break;
+  }
+  return ReturnCode::Success;
+}
+
+bool AreEqual(const HSQOBJECT& a, const HSQOBJECT& b)
+{
+  if (sq_isnumeric(a) && sq_isnumeric(b)) {
+    if (sq_isinteger(a) && sq_isinteger(b)) {
+      return a._unVal.nInteger == b._unVal.nInteger;
+    }
+    return ToFloat(a) == ToFloat(b);
+  }
+  if (sq_type(a) != sq_type(b)) {
+    return false;
+  }
+  if (sq_isnull(a)) {
+    return true;
+  }
+  if (sq_isbool(a)) {
+    return a._unVal.nInteger == b._unVal.nInteger;
+  }
+  // Strings are interned, so everything else can be compared by reference.
+  return a._unVal.raw == b._unVal.raw;
+}
+
+ReturnCode Compare(const OpCode op, const HSQOBJECT& a, const HSQOBJECT& b, HSQOBJECT& result)
+{
+  if (op == OpCode::Equal || op == OpCode::NotEqual) {
+    result = MakeBool(AreEqual(a, b) == (op == OpCode::Equal));
+    return ReturnCode::Success;
+  }
+
+  int order = 0;
+  if (sq_isinteger(a) && sq_isinteger(b)) {
+    order = a._unVal.nInteger < b._unVal.nInteger ? -1 : (a._unVal.nInteger > b._unVal.nInteger ? 1 : 0);
+  }
+  else if (sq_isnumeric(a) && sq_isnumeric(b)) {
+    const auto x = ToFloat(a);
+    const auto y = ToFloat(b);
+    if (std::isnan(x) || std::isnan(y)) {
+      result = MakeBool(false);
+      return ReturnCode::Success;
+    }
+    order = x < y ? -1 : (x > y ? 1 : 0);
+  }
+  else if (sq_isstring(a) && sq_isstring(b)) {
+    order = strcmp(sq_objtostring(&a), sq_objtostring(&b));
+  }
+  else {
+    SDB_LOGD(kLogTag, "Only numbers and strings can be ordered");
+    return ReturnCode::InvalidParameter;
+  }
+
+  switch (op) {
+    case OpCode::Less:
+      result = MakeBool(order < 0);
+      break;
+    case OpCode::LessEqual:
+      result = MakeBool(order <= 0);
+      break;
+    case OpCode::Greater:
+      result = MakeBool(order > 0);
+      break;
+    default:
+      result = MakeBool(order >= 0);
+      break;
+  }
+  return ReturnCode::Success;
+}
+
+// Recursive descent compiler. Each Parse method leaves its result in the register that was the first free one when it
+// was called, so registers are allocated like a stack. Parse methods return the indices of the LoadName and Get
+// instructions that make up the parsed expression if it is a path, or an empty list otherwise.
+class ExpressionCompiler {
+ public:
+  ExpressionCompiler(
+          const std::string& expression, std::vector<Instruction>& instructions, std::vector<Constant>& constants)
+      : pos_(expression.begin())
+      , end_(expression.end())
+      , instructions_(instructions)
+      , constants_(constants)
+  {}
+
+  void Compile()
+  {
+    const auto pathAccesses = ParseOr();
+    SkipWhitespace();
+    if (pos_ != end_) {
+      throw WatchParseError("Invalid content after the end of the parsed expression", pos_);
+    }
+    for (const auto instructionIndex : pathAccesses) {
+      instructions_[instructionIndex].isPathAccess = true;
+    }
+  }
+
+ private:
+  using PathAccesses = std::vector<size_t>;
+
+  PathAccesses ParseOr()
+  {
+    auto pathAccesses = ParseAnd();
+    while (Match("||")) {
+      EmitShortCircuit(OpCode::JumpIfTrue);
+      pathAccesses.clear();
+    }
+    return pathAccesses;
+  }
+
+  PathAccesses ParseAnd()
+  {
+    auto pathAccesses = ParseComparison();
+    while (Match("&&")) {
+      EmitShortCircuit(OpCode::JumpIfFalse);
+      pathAccesses.clear();
+    }
+    return pathAccesses;
+  }
+
+  PathAccesses ParseComparison()
+  {
+    auto pathAccesses = ParseAdditive();
+    for (;;) {
+      OpCode op;
+      if (Match("==")) {
+        op = OpCode::Equal;
+      }
+      else if (Match("!=")) {
+        op = OpCode::NotEqual;
+      }
+      else if (Match("<=")) {
+        op = OpCode::LessEqual;
+      }
+      else if (Match(">=")) {
+        op = OpCode::GreaterEqual;
+      }
+      else if (Match("<")) {
+        op = OpCode::Less;
+      }
+      else if (Match(">")) {
+        op = OpCode::Greater;
+      }
+      else {
+        return pathAccesses;
+      }
+      EmitBinary(op, &ExpressionCompiler::ParseAdditive);
+      pathAccesses.clear();
+    }
+  }
+
+  PathAccesses ParseAdditive()
+  {
+    auto pathAccesses = ParseMultiplicative();
+    for (;;) {
+      OpCode op;
+      if (Match("+")) {
+        op = OpCode::Add;
+      }
+      else if (Match("-")) {
+        op = OpCode::Subtract;
+      }
+      else {
+        return pathAccesses;
+      }
+      EmitBinary(op, &ExpressionCompiler::ParseMultiplicative);
+      pathAccesses.clear();
+    }
+  }
+
+  PathAccesses ParseMultiplicative()
+  {
+    auto pathAccesses = ParseUnary();
+    for (;;) {
+      OpCode op;
+      if (Match("*")) {
+        op = OpCode::Multiply;
+      }
+      else if (Match("/")) {
+        op = OpCode::Divide;
+      }
+      else if (Match("%")) {
+        op = OpCode::Modulo;
+      }
+      else {
+        return pathAccesses;
+      }
+      EmitBinary(op, &ExpressionCompiler::ParseUnary);
+      pathAccesses.clear();
+    }
+  }
+
+  PathAccesses ParseUnary()
+  {
+    OpCode op;
+    if (Match("-")) {
+      op = OpCode::Negate;
+    }
+    else if (Match("!")) {
+      op = OpCode::Not;
+    }
+    else {
+      return ParsePostfix();
+    }
+
+    ParseUnary();
+    const auto reg = TopRegister();
+    Emit({op, reg, reg});
+    return {};
+  }
+
+  PathAccesses ParsePostfix()
+  {
+    auto pathAccesses = ParsePrimary();
+    for (;;) {
+      const auto objectReg = TopRegister();
+      if (Match(".")) {
+        if (pos_ == end_ || (0 == isalpha(*pos_) && *pos_ != '_')) {
+          throw WatchParseError("Expected identifier character after .", pos_);
+        }
+        const auto keyReg = AllocateRegister();
+        Emit({OpCode::LoadConstant, keyReg, 0, 0, AddStringConstant(ReadIdentifier())});
+      }
+      else if (Match("[")) {
+        ParseOr();
+        Expect("]", "Expected ] after index expression");
+      }
+      else {
+        return pathAccesses;
+      }
+
+      const auto getIndex = Emit({OpCode::Get, objectReg, objectReg, static_cast<uint8_t>(objectReg + 1)});
+      FreeRegister();
+      if (!pathAccesses.empty()) {
+        pathAccesses.push_back(getIndex);
+      }
+    }
+  }
+
+  PathAccesses ParsePrimary()
+  {
+    SkipWhitespace();
+    if (pos_ == end_) {
+      throw WatchParseError("Expected an expression but got EOF", pos_);
+    }
+
+    const char c = *pos_;
+    if (c == '(') {
+      ++pos_;
+      ParseOr();
+      Expect(")", "Expected )");
+      return {};
+    }
+    if (c == '"' || c == '\'') {
+      auto str = ReadString(pos_, end_);
+      Emit({OpCode::LoadConstant, AllocateRegister(), 0, 0, AddStringConstant(std::move(str))});
+      return {};
+    }
+    if (0 != isdigit(c)) {
+      Emit({OpCode::LoadConstant, AllocateRegister(), 0, 0, AddConstant(ReadNumber())});
+      return {};
+    }
+    if (0 == isalpha(c) && c != '_') {
+      throw WatchParseError("Invalid character, expected an expression.", pos_);
+    }
+
+    auto identifier = ReadIdentifier();
+    if (identifier == "true" || identifier == "false") {
+      Emit({OpCode::LoadConstant, AllocateRegister(), 0, 0, AddConstant(MakeBool(identifier == "true"))});
+      return {};
+    }
+    if (identifier == "null") {
+      HSQOBJECT nullObject;
+      sq_resetobject(&nullObject);
+      Emit({OpCode::LoadConstant, AllocateRegister(), 0, 0, AddConstant(nullObject)});
+      return {};
+    }
+    if (identifier == "len" && Match("(")) {
+      ParseOr();
+      Expect(")", "Expected ) after len argument");
+      const auto reg = TopRegister();
+      Emit({OpCode::Length, reg, reg});
+      return {};
+    }
+
+    const auto loadIndex =
+            Emit({OpCode::LoadName, AllocateRegister(), 0, 0, AddStringConstant(std::move(identifier))});
+    return {loadIndex};
+  }
+
+  // Expects the left hand side in the top register.
+  void EmitBinary(const OpCode op, PathAccesses (ExpressionCompiler::*parseRight)())
+  {
+    const auto lhsReg = TopRegister();
+    (this->*parseRight)();
+    Emit({op, lhsReg, lhsReg, static_cast<uint8_t>(lhsReg + 1)});
+    FreeRegister();
+  }
+
+  // Expects the left hand side in the top register. The right hand side is written to the same register, and is only
+  // evaluated if the jump isn't taken.
+  void EmitShortCircuit(const OpCode jumpOp)
+  {
+    const auto lhsReg = TopRegister();
+    const auto jumpIndex = Emit({jumpOp, 0, lhsReg});
+    FreeRegister();
+    if (jumpOp == OpCode::JumpIfTrue) {
+      ParseAnd();
+    }
+    else {
+      ParseComparison();
+    }
+    instructions_[jumpIndex].operand = static_cast<uint32_t>(instructions_.size());
+  }
+
+  size_t Emit(const Instruction& instruction)
+  {
+    instructions_.push_back(instruction);
+    return instructions_.size() - 1;
+  }
+
+  uint8_t AllocateRegister()
+  {
+    if (registerCount_ >= CompiledExpression::kMaxRegisters) {
+      throw WatchParseError("Expression is too deeply nested", pos_);
+    }
+    return static_cast<uint8_t>(registerCount_++);
+  }
+
+  void FreeRegister() { --registerCount_; }
+
+  [[nodiscard]] uint8_t TopRegister() const { return static_cast<uint8_t>(registerCount_ - 1); }
+
+  uint32_t AddConstant(const HSQOBJECT& object)
+  {
+    auto& constant = constants_.emplace_back();
+    constant.object = object;
+    return static_cast<uint32_t>(constants_.size() - 1);
+  }
+
+  uint32_t AddStringConstant(std::string str)
+  {
+    for (size_t i = 0; i < constants_.size(); ++i) {
+      if (constants_[i].isString && constants_[i].string == str) {
+        return static_cast<uint32_t>(i);
+      }
+    }
+
+    auto& constant = constants_.emplace_back();
+    sq_resetobject(&constant.object);
+    constant.string = std::move(str);
+    constant.isString = true;
+    return static_cast<uint32_t>(constants_.size() - 1);
+  }
+
+  void SkipWhitespace()
+  {
+    while (pos_ != end_ && 0 != isspace(*pos_)) {
+      ++pos_;
+    }
+  }
+
+  // Consumes the token if it is next.
+  bool Match(const char* token)
+  {
+    SkipWhitespace();
+    const auto tokenLength = strlen(token);
+    if (static_cast<size_t>(end_ - pos_) < tokenLength || 0 != strncmp(&*pos_, token, tokenLength)) {
+      return false;
+    }
+    pos_ += static_cast<std::string::difference_type>(tokenLength);
+    return true;
+  }
+
+  void Expect(const char* token, const char* errorMessage)
+  {
+    if (!Match(token)) {
+      throw WatchParseError(errorMessage, pos_);
+    }
+  }
+
+  std::string ReadIdentifier()
+  {
+    const auto first = pos_;
+    while (pos_ != end_ && (0 != isalnum(*pos_) || *pos_ == '_')) {
+      ++pos_;
+    }
+    return std::string(first, pos_);
+  }
+
+  // Reads an integer, or a float if it has a fractional part or exponent.
+  HSQOBJECT ReadNumber()
+  {
+    const auto first = pos_;
+    const auto skipDigits = [this]() {
+      while (pos_ != end_ && 0 != isdigit(*pos_)) {
+        ++pos_;
+      }
+    };
+
+    bool isFloat = false;
+    skipDigits();
+    if (pos_ != end_ && *pos_ == '.' && pos_ + 1 != end_ && 0 != isdigit(*(pos_ + 1))) {
+      isFloat = true;
+      ++pos_;
+      skipDigits();
+    }
+    if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+      isFloat = true;
+      ++pos_;
+      if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+        ++pos_;
+      }
+      if (pos_ == end_ || 0 == isdigit(*pos_)) {
+        throw WatchParseError("Expected exponent digits", pos_);
+      }
+      skipDigits();
+    }
+
+    const std::string numberString(first, pos_);
+    errno = 0;
+    if (isFloat) {
+      const auto value = strtod(numberString.c_str(), nullptr);
+      if (errno == ERANGE) {
+        throw WatchParseError("Float literal is out of range", first);
+      }
+      return MakeFloat(static_cast<SQFloat>(value));
+    }
+
+    const auto value = strtoll(numberString.c_str(), nullptr, 10);
+    if (errno == ERANGE || value > std::numeric_limits<SQInteger>::max()) {
+      throw WatchParseError("Integer literal is out of range", first);
+    }
+    return MakeInteger(static_cast<SQInteger>(value));
+  }
+
+  std::string::const_iterator pos_;
+  const std::string::const_iterator end_;
+  std::vector<Instruction>& instructions_;
+  std::vector<Constant>& constants_;
+  uint32_t registerCount_ = 0;
+};
+}// namespace
+
+CompiledExpression::CompiledExpression(const std::string& expression)
+{
+  ExpressionCompiler(expression, instructions_, constants_).Compile();
+}
+
+ReturnCode CompiledExpression::Evaluate(
+        HSQUIRRELVM v, const StackLocals* locals, KeyIteratorIndex& keyIndex, data::ImmediateValue& value)
+{
+  value.scope = data::VariableScope::Evaluation;
+  value.iteratorPath.clear();
+
+  Registers registers{};
+  if (const auto rc = Run(v, -1, nullptr, locals, &keyIndex, &value, instructions_.size(), registers);
+      rc != ReturnCode::Success) {
+    return rc;
+  }
+
+  sq_pushobject(v, registers[0]);
+  const auto rc = CreateChildVariable(v, value.variable);
+  sq_poptop(v);
+  return rc;
+}
+
+ReturnCode CompiledExpression::EvaluateObject(HSQUIRRELVM v, const StackLocals* locals, HSQOBJECT& result)
+{
+  Registers registers{};
+  if (const auto rc = Run(v, -1, nullptr, locals, nullptr, nullptr, instructions_.size(), registers);
+      rc != ReturnCode::Success) {
+    return rc;
+  }
+  result = registers[0];
+  return ReturnCode::Success;
+}
+
+ReturnCode CompiledExpression::EvaluateCondition(
+        HSQUIRRELVM v, const int32_t stackFrame, const SQChar* functionName, bool& isTrue)
+{
+  auto slotsPos = localSlotsByFunction_.find(functionName);
+  if (slotsPos == localSlotsByFunction_.end()) {
+    if (localSlotsByFunction_.size() == kMaxLocalSlotFunctions) {
+      localSlotsByFunction_.clear();
+    }
+    slotsPos = localSlotsByFunction_.emplace(functionName, std::vector<int32_t>(constants_.size(), kUnresolvedSlot))
+                       .first;
+  }
+
+  Registers registers{};
+  if (const auto rc =
+              Run(v, stackFrame, &slotsPos->second, nullptr, nullptr, nullptr, instructions_.size(), registers);
+      rc != ReturnCode::Success) {
+    return rc;
+  }
+  isTrue = IsTruthy(registers[0]);
+  return ReturnCode::Success;
+}
+
+ReturnCode CompiledExpression::ResolveMember(
+        HSQUIRRELVM v, const StackLocals* locals, HSQOBJECT& container, HSQOBJECT& key)
+{
+  if (instructions_.empty() || instructions_.back().op != OpCode::Get || !instructions_.back().isPathAccess) {
+    SDB_LOGD(kLogTag, "Expression is not a path that ends in an accessor");
+    return ReturnCode::InvalidParameter;
+  }
+
+  Registers registers{};
+  if (const auto rc = Run(v, -1, nullptr, locals, nullptr, nullptr, instructions_.size() - 1, registers);
+      rc != ReturnCode::Success) {
+    return rc;
+  }
+
+  const auto& get = instructions_.back();
+  container = registers[get.a];
+  key = registers[get.b];
+  return ReturnCode::Success;
+}
+
+void CompiledExpression::ReleaseConstants(HSQUIRRELVM v)
+{
+  if (boundVm_ != v) {
+    return;
+  }
+
+  for (auto& constant : constants_) {
+    if (constant.isString) {
+      sq_release(v, &constant.object);
+      sq_resetobject(&constant.object);
+    }
+  }
+  boundVm_ = nullptr;
+}
+
+void CompiledExpression::ForgetVm()
+{
+  for (auto& constant : constants_) {
+    if (constant.isString) {
+      sq_resetobject(&constant.object);
+    }
+  }
+  // Keyed by function names owned by the VM's prototypes
+  localSlotsByFunction_.clear();
+  boundVm_ = nullptr;
+}
+
+void CompiledExpression::BindConstants(HSQUIRRELVM v)
+{
+  // If bound to a different VM, that one has been closed so there is nothing to release.
+  for (auto& constant : constants_) {
+    if (constant.isString) {
+      sq_pushstring(v, constant.string.c_str(), static_cast<SQInteger>(constant.string.size()));
+      sq_getstackobj(v, -1, &constant.object);
+      sq_addref(v, &constant.object);
+      sq_poptop(v);
+    }
+  }
+  boundVm_ = v;
+}
+
+ReturnCode CompiledExpression::Run(
+        HSQUIRRELVM v, const int32_t stackFrame, std::vector<int32_t>* localSlots, const StackLocals* locals,
+        KeyIteratorIndex* keyIndex, data::ImmediateValue* pathValue, const size_t instructionCount,
+        Registers& registers)
+{
+  ScopedVerifySqTop scopedVerify(v);
+
+  if (boundVm_ != v) {
+    BindConstants(v);
+  }
+
+  size_t pc = 0;
+  while (pc < instructionCount) {
+    const auto& instruction = instructions_[pc++];
+    const HSQOBJECT a = registers[instruction.a];
+    const HSQOBJECT b = registers[instruction.b];
+    auto& dst = registers[instruction.dst];
+    const bool recordPath = instruction.isPathAccess && pathValue != nullptr;
+
+    auto rc = ReturnCode::Success;
+    switch (instruction.op) {
+      case OpCode::LoadConstant:
+        dst = constants_[instruction.operand].object;
+        break;
+      case OpCode::LoadName:
+        rc = LoadName(
+                v, stackFrame, localSlots != nullptr ? &(*localSlots)[instruction.operand] : nullptr, locals,
+                constants_[instruction.operand], recordPath ? keyIndex : nullptr, recordPath ? pathValue : nullptr,
+                dst);
+        break;
+      case OpCode::Get:
+      {
+        uint32_t iterator = 0;
+        sq_pushobject(v, a);
+        rc = PushMember(v, b, recordPath ? keyIndex : nullptr, iterator);
+        if (rc == ReturnCode::Success) {
+          sq_getstackobj(v, -1, &dst);
+          sq_poptop(v);
+          if (recordPath) {
+            pathValue->iteratorPath.push_back(iterator);
+          }
+        }
+        sq_poptop(v);
+        break;
+      }
+      case OpCode::Length:
+        rc = Length(v, a, dst);
+        break;
+      case OpCode::Negate:
+        if (sq_isinteger(a)) {
+          dst = MakeInteger(static_cast<SQInteger>(0U - static_cast<UnsignedInteger>(a._unVal.nInteger)));
+        }
+        else if (sq_isfloat(a)) {
+          dst = MakeFloat(-a._unVal.fFloat);
+        }
+        else {
+          rc = ReturnCode::InvalidParameter;
+        }
+        break;
+      case OpCode::Not:
+        dst = MakeBool(!IsTruthy(a));
+        break;
+      case OpCode::Add:
+      case OpCode::Subtract:
+      case OpCode::Multiply:
+      case OpCode::Divide:
+      case OpCode::Modulo:
+        rc = Arithmetic(instruction.op, a, b, dst);
+        break;
+      case OpCode::Equal:
+      case OpCode::NotEqual:
+      case OpCode::Less:
+      case OpCode::LessEqual:
+      case OpCode::Greater:
+      case OpCode::GreaterEqual:
+        rc = Compare(instruction.op, a, b, dst);
+        break;
+      case OpCode::JumpIfFalse:
+        if (!IsTruthy(a)) {
+          pc = instruction.operand;
+        }
+        break;
+      case OpCode::JumpIfTrue:
+        if (IsTruthy(a)) {
+          pc = instruction.operand;
+        }
+        break;
+    }
+
+    if (rc != ReturnCode::Success) {
+      SDB_LOGD(kLogTag, "Failed to evaluate instruction %" PRIu64, static_cast<uint64_t>(pc - 1));
+      return rc;
+    }
+  }
+
+  return ReturnCode::Success;
+}
+}// namespace sdb::sq
@@ -0,0 +1,147 @@
+#pragma once
+
+#ifndef SDB_COMPILED_EXPRESSION_H
+#define SDB_COMPILED_EXPRESSION_H
+
+#include "SquirrelVmHelpers.h"
+
+#include <squirrel.h>
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb::sq {
+
+class WatchParseError : public std::runtime_error {
+ public:
+  WatchParseError(const char* msg, const std::string::const_iterator pos)
+      : std::runtime_error(msg)
+      , pos(pos)
+  {}
+  const std::string::const_iterator pos;
+};
+
+// A watch or breakpoint condition, compiled to a flat list of instructions that run on a small register machine.
+// Evaluation does not allocate, and does not execute any script code other than _get metamethods.
+//
+// Supported syntax, from lowest to highest precedence:
+//   a || b, a && b         Short circuiting; the result is one of the operands, as in Squirrel.
+//   ==, !=, <, <=, >, >=   Numbers compare by value, strings lexically, anything else by reference.
+//   a + b, a - b           Integers and floats only.
+//   a * b, a / b, a % b
+//   -a, !a
+//   a.b, a[b]              Table, instance and array access.
+//   len(a), (a)            len accepts strings, tables and arrays.
+//   Identifiers, integers, floats, strings, true, false and null.
+// Identifiers are looked up in the locals of the stack frame, then in the root table.
+class CompiledExpression {
+ public:
+  // Throws WatchParseError if the expression can't be compiled.
+  explicit CompiledExpression(const std::string& expression);
+  ~CompiledExpression() = default;
+
+  // Deleted methods
+  CompiledExpression(const CompiledExpression& other) = delete;
+  CompiledExpression(const CompiledExpression&& other) = delete;
+  CompiledExpression& operator=(const CompiledExpression&) = delete;
+  CompiledExpression& operator=(CompiledExpression&&) = delete;
+
+  // Must be called while the VM is paused. Identifiers are looked up in locals, if given, then in the root table.
+  // If the expression is a path (an identifier followed only by accessors), the scope and iterator path of the value
+  // are also returned; otherwise the scope is Evaluation.
+  [[nodiscard]] data::ReturnCode Evaluate(
+          HSQUIRRELVM v, const StackLocals* locals, KeyIteratorIndex& keyIndex, data::ImmediateValue& value);
+
+  // As above, but returns the resulting object itself. It is not referenced, so is only valid until the VM resumes.
+  [[nodiscard]] data::ReturnCode EvaluateObject(HSQUIRRELVM v, const StackLocals* locals, HSQOBJECT& result);
+
+  // Only returns whether the result is truthy (anything other than null, false or zero). Must only be called from the
+  // Squirrel Execution Thread, and reads the locals of stackFrame directly as they may change from line to line.
+  // functionName is the name the debug hook gives for the frame's function, which is owned by its prototype. Locals are
+  // found by name the first time the condition is evaluated in each function; after that, only their slots are checked.
+  [[nodiscard]] data::ReturnCode EvaluateCondition(
+          HSQUIRRELVM v, int32_t stackFrame, const SQChar* functionName, bool& isTrue);
+
+  // If the expression is a path that ends in an accessor (eg. player.health), evaluates all but that final accessor,
+  // returning the container and key that it would read from. Otherwise returns InvalidParameter.
+  // Must be called while the VM is paused; locals are as for Evaluate.
+  [[nodiscard]] data::ReturnCode ResolveMember(
+          HSQUIRRELVM v, const StackLocals* locals, HSQOBJECT& container, HSQOBJECT& key);
+
+  // String constants are created in the VM the first time the expression is evaluated, and are held until this is
+  // called. Must only be called from the Squirrel Execution Thread, or while it is paused.
+  void ReleaseConstants(HSQUIRRELVM v);
+
+  // Forgets everything that belongs to the VM the expression was last evaluated in, without releasing it, for when that
+  // VM is about to be closed. Otherwise a VM created later at the same address would be handed its freed constants.
+  void ForgetVm();
+
+  enum class OpCode : uint8_t {
+    LoadConstant,// dst = constants[operand]
+    LoadName,    // dst = local or global named constants[operand]
+    Get,         // dst = a[b]
+    Length,      // dst = len(a)
+    Negate,      // dst = -a
+    Not,         // dst = !a
+    Add,         // dst = a + b, and so on
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    JumpIfFalse,// if !a, jump to operand
+    JumpIfTrue, // if a, jump to operand
+  };
+
+  struct Instruction {
+    OpCode op = OpCode::LoadConstant;
+    uint8_t dst = 0;
+    uint8_t a = 0;
+    uint8_t b = 0;
+    uint32_t operand = 0;
+    // LoadName and Get instructions that make up a path expression; they record the scope and iterator path.
+    bool isPathAccess = false;
+  };
+
+  struct Constant {
+    HSQOBJECT object = {};
+    // Only set for string constants, whose object is created on first evaluation.
+    std::string string;
+    bool isString = false;
+  };
+
+  static constexpr uint32_t kMaxRegisters = 32;
+  // Beyond this many functions, the local slots found for conditions are forgotten and found again.
+  static constexpr size_t kMaxLocalSlotFunctions = 16;
+
+ private:
+  // The VM must be paused, or this must be called from the Squirrel Execution Thread.
+  // Locals are looked up in the locals cache if given, otherwise in stackFrame if it isn't negative. In that case
+  // localSlots, if given, holds where each name constant was last found in the frame's function (see LoadName).
+  // pathValue is only written to when the expression is a path. Only the first instructionCount instructions are run;
+  // the result of a full run is in registers[0].
+  using Registers = std::array<HSQOBJECT, kMaxRegisters>;
+  [[nodiscard]] data::ReturnCode Run(
+          HSQUIRRELVM v, int32_t stackFrame, std::vector<int32_t>* localSlots, const StackLocals* locals,
+          KeyIteratorIndex* keyIndex, data::ImmediateValue* pathValue, size_t instructionCount, Registers& registers);
+  void BindConstants(HSQUIRRELVM v);
+
+  std::vector<Instruction> instructions_;
+  std::vector<Constant> constants_;
+  // Local slots for conditions, per function name pointer.
+  std::unordered_map<const SQChar*, std::vector<int32_t>> localSlotsByFunction_;
+  // VM that string constants were created in, or nullptr if they haven't been.
+  HSQUIRRELVM boundVm_ = nullptr;
+};
+
+}// namespace sdb::sq
+
+#endif// SDB_COMPILED_EXPRESSION_H
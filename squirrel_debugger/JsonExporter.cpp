@@ -0,0 +1,269 @@
+#include "JsonExporter.h"
+
+#include "SquirrelVmHelpers.h"
+
+#include <sdb/LogInterface.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+using sdb::data::ReturnCode;
+
+namespace sdb::sq {
+namespace {
+const char* const kLogTag = "JsonExporter";
+
+// Slots pushed for each level of nesting: the iterator, key and value.
+constexpr SQInteger kStackSlotsPerDepth = 3;
+
+// Escapes a key for use as a JSON pointer reference token.
+void AppendPointerToken(const std::string_view token, std::string& pointer)
+{
+  pointer.push_back('/');
+  for (const auto c : token) {
+    if (c == '~') {
+      pointer.append("~0");
+    }
+    else if (c == '/') {
+      pointer.append("~1");
+    }
+    else {
+      pointer.push_back(c);
+    }
+  }
+}
+}// namespace
+
+JsonExporter::JsonExporter(const data::ExportOptions& options, const std::function<bool(std::string_view)>& writeFn)
+    : options_(options)
+    , writeFn_(writeFn)
+{
+  buffer_.reserve(kChunkSize + kChunkSize / 4U);
+}
+
+ReturnCode JsonExporter::Export(HSQUIRRELVM v, data::ExportResult& result)
+{
+  ScopedVerifySqTop scopedVerify(v);
+
+  WriteValue(v, 0U);
+  Flush();
+
+  result = result_;
+  result.byteCount = flushedBytes_;
+  if (writeFailed_) {
+    SDB_LOGD(kLogTag, "Export abandoned after %" PRIu64 " bytes, output could not be written", flushedBytes_);
+    return ReturnCode::ErrorInternal;
+  }
+  return ReturnCode::Success;
+}
+
+void JsonExporter::WriteValue(HSQUIRRELVM v, const uint32_t depth)
+{
+  ++result_.nodeCount;
+
+  const auto type = sq_gettype(v, -1);
+  switch (type) {
+    case OT_NULL:
+      Put("null");
+      break;
+    case OT_BOOL:
+    {
+      SQBool val = SQFalse;
+      sq_getbool(v, -1, &val);
+      Put(val == SQTrue ? "true" : "false");
+      break;
+    }
+    case OT_INTEGER:
+    {
+      SQInteger val = 0;
+      sq_getinteger(v, -1, &val);
+      std::array<char, 24> digits = {};
+      const auto convResult = std::to_chars(digits.data(), digits.data() + digits.size(), val);
+      Put(std::string_view(digits.data(), static_cast<size_t>(convResult.ptr - digits.data())));
+      break;
+    }
+    case OT_FLOAT:
+    {
+      SQFloat val = 0.0F;
+      sq_getfloat(v, -1, &val);
+      if (!std::isfinite(val)) {
+        // JSON has no representation for these
+        WriteString(std::isnan(val) ? "nan" : (val > 0 ? "inf" : "-inf"));
+        break;
+      }
+      // Enough digits that the value reads back exactly
+      std::array<char, 32> digits = {};
+      const auto len = std::snprintf(
+              digits.data(), digits.size(), "%.*g", std::numeric_limits<SQFloat>::max_digits10,
+              static_cast<double>(val));
+      Put(std::string_view(digits.data(), static_cast<size_t>(std::max(len, 0))));
+      break;
+    }
+    case OT_STRING:
+    {
+      const SQChar* str = nullptr;
+      SQInteger strLength = 0;
+      sq_getstringandsize(v, -1, &str, &strLength);
+      WriteString(std::string_view(str, static_cast<size_t>(strLength)));
+      break;
+    }
+    case OT_TABLE:
+    case OT_ARRAY:
+    case OT_INSTANCE:
+    case OT_CLASS:
+      WriteContainer(v, type, depth);
+      break;
+    default:
+      WriteString(ToString(v, -1));
+  }
+}
+
+void JsonExporter::WriteContainer(HSQUIRRELVM v, const SQObjectType type, const uint32_t depth)
+{
+  HSQOBJECT containerObj = {};
+  sq_getstackobj(v, -1, &containerObj);
+  if (const auto occurrencePos = firstOccurrences_.find(containerObj._unVal.raw);
+      occurrencePos != firstOccurrences_.end())
+  {
+    ++result_.sharedReferenceCount;
+    Put("{\"$ref\":");
+    WriteString(occurrencePos->second);
+    Put('}');
+    return;
+  }
+
+  if (depth > options_.maxDepth || SQ_FAILED(sq_reservestack(v, kStackSlotsPerDepth))) {
+    result_.truncated = true;
+    Put("{\"$truncated\":true}");
+    return;
+  }
+  firstOccurrences_.emplace(containerObj._unVal.raw, pointer_);
+
+  const bool isArray = type == OT_ARRAY;
+  Put(isArray ? '[' : '{');
+  bool isFirst = true;
+  if (type == OT_INSTANCE) {
+    Put("\"$class\":");
+    WriteString(GetClassName(v));
+    isFirst = false;
+  }
+
+  const auto pointerLength = pointer_.size();
+  sq_pushnull(v);
+  while (SQ_SUCCEEDED(sq_next(v, -2))) {
+    const auto valueType = sq_gettype(v, -1);
+    if (type == OT_INSTANCE && (valueType == OT_CLOSURE || valueType == OT_NATIVECLOSURE)) {
+      sq_pop(v, 2);// pop key and value
+      continue;
+    }
+    if (!CanWriteValue()) {
+      sq_pop(v, 2);// pop key and value
+      break;
+    }
+
+    if (!isFirst) {
+      Put(',');
+    }
+    isFirst = false;
+
+    if (isArray) {
+      SQInteger index = 0;
+      sq_getinteger(v, -2, &index);
+      AppendPointerToken(std::to_string(index), pointer_);
+    }
+    else {
+      WriteKey(v, -2);
+      Put(':');
+    }
+
+    WriteValue(v, depth + 1);
+    pointer_.resize(pointerLength);
+    sq_pop(v, 2);// pop key and value
+  }
+  sq_poptop(v);// pop iterator
+
+  Put(isArray ? ']' : '}');
+}
+
+void JsonExporter::WriteKey(HSQUIRRELVM v, const SQInteger idx)
+{
+  std::string keyStr;
+  if (sq_gettype(v, idx) == OT_STRING) {
+    const SQChar* str = nullptr;
+    SQInteger strLength = 0;
+    sq_getstringandsize(v, idx, &str, &strLength);
+    keyStr.assign(str, static_cast<size_t>(strLength));
+  }
+  else {
+    // Some types are only ever read from the top of the stack by ToString, so copy the key there.
+    sq_push(v, idx);
+    keyStr = ToString(v, -1);
+    sq_poptop(v);
+  }
+  WriteString(keyStr);
+  AppendPointerToken(keyStr, pointer_);
+}
+
+const std::string& JsonExporter::GetClassName(HSQUIRRELVM v)
+{
+  static const std::string kUnknownClass;
+  if (SQ_FAILED(sq_getclass(v, -1))) {
+    return kUnknownClass;
+  }
+
+  HSQOBJECT classObj = {};
+  sq_getstackobj(v, -1, &classObj);
+  auto classNamePos = classNames_.find(classObj._unVal.raw);
+  if (classNamePos == classNames_.end()) {
+    classNamePos = classNames_.emplace(classObj._unVal.raw, ToClassFullName(v, -1)).first;
+  }
+  sq_poptop(v);// pop class
+  return classNamePos->second;
+}
+
+bool JsonExporter::CanWriteValue()
+{
+  if (writeFailed_ || result_.nodeCount >= options_.maxNodes ||
+      flushedBytes_ + buffer_.size() >= options_.maxBytes)
+  {
+    result_.truncated = true;
+    return false;
+  }
+  return true;
+}
+
+void JsonExporter::WriteString(const std::string_view str)
+{
+  json::WriteString(*this, str);
+}
+
+void JsonExporter::Put(const char c)
+{
+  buffer_.push_back(c);
+}
+
+void JsonExporter::Put(const std::string_view str)
+{
+  buffer_.append(str);
+  if (buffer_.size() >= kChunkSize) {
+    Flush();
+  }
+}
+
+void JsonExporter::Flush()
+{
+  if (buffer_.empty()) {
+    return;
+  }
+  if (!writeFailed_ && !writeFn_(buffer_)) {
+    writeFailed_ = true;
+  }
+  flushedBytes_ += buffer_.size();
+  buffer_.clear();
+}
+
+}// namespace sdb::sq
@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef SDB_JSON_EXPORTER_H
+#define SDB_JSON_EXPORTER_H
+
+#include "sdb/JsonString.h"
+#include "sdb/MessageInterface.h"
+
+#include <squirrel.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace sdb::sq {
+
+// Writes a value, and everything reachable from it, as JSON in a single walk of the object graph.
+// Tables, instances and classes become objects (keys that aren't strings are converted to strings, and instances get
+// a "$class" member), arrays become arrays, and everything else that isn't a JSON primitive becomes a string.
+// Methods of instances are left out, as they belong to the class.
+// Each container is only written once; later occurrences are written as {"$ref": pointer}, where pointer is the
+// JSON pointer (RFC 6901) of the first. Containers beyond ExportOptions::maxDepth are written as {"$truncated": true}.
+class JsonExporter {
+ public:
+  static constexpr size_t kChunkSize = 64U * 1024U;
+
+  // writeFn is called with chunks of at most around kChunkSize bytes.
+  JsonExporter(const data::ExportOptions& options, const std::function<bool(std::string_view)>& writeFn);
+
+  // Expects the value to export at the top of the stack, and leaves the stack unchanged. Returns ErrorInternal if
+  // writeFn returned false.
+  [[nodiscard]] data::ReturnCode Export(HSQUIRRELVM v, data::ExportResult& result);
+
+ private:
+  // Expects the value at the top of the stack.
+  void WriteValue(HSQUIRRELVM v, uint32_t depth);
+  void WriteContainer(HSQUIRRELVM v, SQObjectType type, uint32_t depth);
+  void WriteString(std::string_view str);
+  void WriteKey(HSQUIRRELVM v, SQInteger idx);
+  // Expects an instance at the top of the stack.
+  [[nodiscard]] const std::string& GetClassName(HSQUIRRELVM v);
+
+  // Returns false, and marks the export as truncated, if another value would exceed the limits.
+  [[nodiscard]] bool CanWriteValue();
+
+  // Called by json::WriteString
+  template<typename TSink>
+  friend void json::WriteString(TSink& sink, std::string_view str);
+  void Put(char c);
+  void Put(std::string_view str);
+  void Flush();
+
+  const data::ExportOptions options_;
+  const std::function<bool(std::string_view)>& writeFn_;
+
+  std::string buffer_;
+  uint64_t flushedBytes_ = 0;
+  bool writeFailed_ = false;
+  data::ExportResult result_;
+
+  // JSON pointer of the value being written
+  std::string pointer_;
+  // JSON pointer of the first occurrence of each container, by raw address
+  std::unordered_map<SQRawObjectVal, std::string> firstOccurrences_;
+  // ToClassFullName walks the root table, so is only called once per class
+  std::unordered_map<SQRawObjectVal, std::string> classNames_;
+};
+
+}// namespace sdb::sq
+
+#endif// SDB_JSON_EXPORTER_H
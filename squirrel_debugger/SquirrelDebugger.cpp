@@ -2,7 +2,10 @@
 
 #include <sdb/LogInterface.h>
 
+#include "ArrayStatistics.h"
 #include "BreakpointMap.h"
+#include "CompiledExpression.h"
+#include "JsonExporter.h"
 #include "SquirrelVmHelpers.h"
 
 #include <squirrel.h>
@@ -10,8 +13,8 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdarg>
-#include <deque>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <unordered_map>
 #include <unordered_set>
@@ -25,13 +28,12 @@ using sdb::data::RunState;
 using sdb::data::StackEntry;
 using sdb::data::Status;
 using sdb::data::Variable;
+using sdb::data::VariableType;
 
 using sdb::sq::CreateChildVariable;
 using sdb::sq::CreateChildVariablesFromIterable;
 using sdb::sq::WithVariableAtPath;
-using sdb::sq::GetObjectFromExpression;
-using sdb::sq::ExpressionNode;
-using sdb::sq::ExpressionNodeType;
+using sdb::sq::CompiledExpression;
 using sdb::sq::ScopedVerifySqTop;
 using sdb::sq::WatchParseError;
 
@@ -43,6 +45,23 @@ const SQInteger kDefaultStackSize = 1024;
 const char* const kLogTag = "SquirrelDebugger";
 
 namespace sdb::internal {
+struct RegisteredWatch {
+  uint64_t id = 0;
+  std::string watch;
+  std::shared_ptr<CompiledExpression> expression;
+};
+
+struct DataBreakpoint {
+  uint64_t id = 0;
+  std::string watch;
+  // The watched slot. Both objects hold a reference, which is released when the breakpoint is removed.
+  HSQOBJECT container = {};
+  HSQOBJECT key = {};
+  // Type and raw value of the slot when it was last checked. The value itself is not referenced, only compared.
+  SQObjectType valueType = OT_NULL;
+  SQRawObjectVal valueRaw = 0;
+};
+
 struct PauseMutexDataImpl {
   bool isPaused = false;
 
@@ -54,76 +73,157 @@ struct PauseMutexDataImpl {
 
   // Loaded breakpoints
   BreakpointMap breakpoints = {};
+
+  // What to send along with the status each time the application pauses.
+  data::PauseBundleConfig pauseBundleConfig = {};
+
+  // Watches that are evaluated each time the application pauses.
+  std::vector<RegisteredWatch> watches;
+  uint64_t nextWatchId = 1;
+  // Removed watches and breakpoint conditions, whose string constants could not be released as the VM was running at
+  // the time. They are released on the next line hook.
+  std::vector<std::shared_ptr<CompiledExpression>> expressionsToRelease;
+
+  // Checked on every line, so kept as small as possible.
+  std::vector<DataBreakpoint> dataBreakpoints;
+  uint64_t nextDataBreakpointId = 1;
+  // As with expressionsToRelease, references held by removed data breakpoints that are released on the next line hook.
+  std::vector<HSQOBJECT> objectsToRelease;
+
+  // Incremented each time the application pauses. Page cursors are only valid for the epoch they were created in.
+  uint32_t pauseEpoch = 0;
+
+  // Used while evaluating expressions. Cleared each time the application resumes.
+  sq::KeyIteratorIndex keyIteratorIndex;
 };
 
 struct SquirrelVmDataImpl {
-  void PopulateStack(std::vector<StackEntry>& stack) const
+  // Reads at most count frames, starting at beginFrame.
+  void PopulateStack(const uint32_t beginFrame, const uint32_t count, std::vector<StackEntry>& stack) const
   {
     stack.clear();
 
     SQStackInfos si;
-    auto stackIdx = 0;
-    while (SQ_SUCCEEDED(sq_stackinfos(vm, stackIdx, &si))) {
+    for (auto stackIdx = static_cast<SQInteger>(beginFrame);
+         stack.size() < count && SQ_SUCCEEDED(sq_stackinfos(vm, stackIdx, &si)); ++stackIdx) {
       uint32_t line = 0;
 
       if (si.line > 0 && si.line <= INT32_MAX) {
         line = static_cast<uint32_t>(si.line);
       }
       stack.push_back({std::string(si.source), line, std::string(si.funcname)});
-      ++stackIdx;
     }
   }
 
+  // sq_stackinfos only has to check the level against the size of the call stack, so rather than walking every frame
+  // the depth is found with an exponential search followed by a binary search.
+  [[nodiscard]] uint32_t GetStackDepth() const
+  {
+    SQStackInfos si;
+    const auto hasFrame = [this, &si](const SQInteger level) { return SQ_SUCCEEDED(sq_stackinfos(vm, level, &si)); };
+    if (!hasFrame(0)) {
+      return 0U;
+    }
+
+    // hasFrame(low) is always true, and hasFrame(high) false.
+    SQInteger low = 0;
+    SQInteger high = 1;
+    while (hasFrame(high)) {
+      low = high;
+      high *= 2;
+    }
+    while (high - low > 1) {
+      const auto mid = low + (high - low) / 2;
+      if (hasFrame(mid)) {
+        low = mid;
+      }
+      else {
+        high = mid;
+      }
+    }
+    return static_cast<uint32_t>(high);
+  }
+
+  // nextPosition is set if there are more children after this page.
   ReturnCode PopulateStackVariables(
           uint32_t stackFrame, const std::string& path, const PaginationInfo& pagination,
-          std::vector<Variable>& stack) const
+          const data::VariableQueryOptions& options, std::vector<Variable>& stack,
+          std::optional<uint32_t>& nextPosition) const
   {
+    sq::VariableQueryContext context(options, pagination, &sortedKeysCache);
+    ReturnCode rc {};
     if (path.empty())
     {
       // List out locals and free variables
-      return WithStackRootVariables(stackFrame, path, pagination, stack, [vm = this->vm](Variable& variable) {
-        auto rc = CreateChildVariable(vm, variable);
-        // Can't edit locals and free variables right now.
-        variable.editable = false;
-        return rc;
-      });
+      rc = WithStackRootVariables(
+              stackFrame, pagination, context, stack, [vm = this->vm, &context](Variable& variable) {
+                auto rc = CreateChildVariable(vm, context, variable);
+                // Can't edit locals and free variables right now.
+                variable.editable = false;
+                return rc;
+              });
     }
     else
     {
-      return WithStackVariables(
+      rc = WithStackVariables(
               stackFrame, path,
-              [vm = this->vm, &pagination, &stack](const sq::PathPartConstIter& begin, const sq::PathPartConstIter& end) {
-                return sq::CreateChildVariablesFromIterable(vm, begin + 1, end, pagination, stack);
+              [vm = this->vm, &pagination, &context, &stack](
+                      const sq::PathPartConstIter& begin, const sq::PathPartConstIter& end) {
+                return sq::CreateChildVariablesFromIterable(vm, begin + 1, end, pagination, context, stack);
               });
     }
+    nextPosition = context.nextPosition;
+    return rc;
   }
 
-  ReturnCode WithStackRootVariables(uint32_t stackFrame, const std::string& path, const PaginationInfo& pagination, std::vector<Variable>& stack, const std::function<ReturnCode(Variable&)>& fn) const
+  ReturnCode WithStackRootVariables(
+          uint32_t stackFrame, const PaginationInfo& pagination, sq::VariableQueryContext& context,
+          std::vector<Variable>& stack, const std::function<ReturnCode(Variable&)>& fn) const
   {
     ReturnCode rc {};
-    const auto maxNSeq = pagination.beginIterator + pagination.count;
-    for (SQUnsignedInteger nSeq = pagination.beginIterator; nSeq < maxNSeq; ++nSeq) {
-      // Push local with given index to stack
-      const auto* const localName = sq_getlocal(vm, stackFrame, nSeq);
-      if (localName == nullptr) {
-        break;
+    const auto& locals = GetLocals(stackFrame).locals;
+    // As for the children of a container, a filtered page holds up to pagination.count matching locals
+    const bool filtered = !context.filter.IsEmpty();
+    uint32_t count = 0;
+    size_t nSeq = pagination.beginIterator;
+    for (; nSeq < locals.size() && count < pagination.count && context.nodesRemaining > 0; ++nSeq) {
+      const auto& local = locals[nSeq];
+      if (filtered) {
+        sq_pushstring(vm, local.name.c_str(), static_cast<SQInteger>(local.name.size()));
+        sq_pushobject(vm, local.value);
+        const bool matches = context.filter.Matches(vm);
+        sq_pop(vm, 2);
+        if (!matches) {
+          continue;
+        }
       }
+      ++count;
+
+      // Push local with given index to stack
+      sq_pushobject(vm, local.value);
 
       Variable variable;
       variable.pathIterator = nSeq;
-      variable.pathUiString = localName;
+      variable.pathUiString = local.name;
       rc = fn(variable);
 
-      // Remove local from stack
-      sq_poptop(vm);
-
       if (rc != ReturnCode::Success) {
+        // Remove local from stack
+        sq_poptop(vm);
         break;
       }
 
       // Can't edit root variables/globals right now
       variable.editable = false;
+      --context.nodesRemaining;
       stack.emplace_back(std::move(variable));
+      sq::ExpandChildVariable(vm, context, 1U, stack.size() - 1, stack);
+
+      // Remove local from stack
+      sq_poptop(vm);
+    }
+    if (rc == ReturnCode::Success && nSeq < locals.size()) {
+      context.nextPosition = static_cast<uint32_t>(nSeq);
     }
     return rc;
   }
@@ -147,11 +247,12 @@ struct SquirrelVmDataImpl {
 
     ReturnCode rc {};
     // Push local with given index to stack
-    const auto* const localName = sq_getlocal(vm, stackFrame, *pathParts.begin());
-    if (localName == nullptr) {
-      SDB_LOGD(kLogTag, "No local with given index: %d", *pathParts.begin());
+    const auto& locals = GetLocals(stackFrame).locals;
+    if (*pathParts.begin() >= locals.size()) {
+      SDB_LOGD(kLogTag, "No local with given index: %" PRIu64, *pathParts.begin());
       return ReturnCode::InvalidParameter;
     }
+    sq_pushobject(vm, locals[*pathParts.begin()].value);
 
     rc = fn(pathParts.begin(), pathParts.end());
     if (rc != ReturnCode::Success) {
@@ -164,11 +265,72 @@ struct SquirrelVmDataImpl {
     return rc;
   }
 
-  ReturnCode
-  PopulateGlobalVariables(const std::string& path, const PaginationInfo& pagination, std::vector<Variable>& stack) const
+  // nextPosition is set if there are more children after this page.
+  ReturnCode PopulateGlobalVariables(
+          const std::string& path, const PaginationInfo& pagination, const data::VariableQueryOptions& options,
+          std::vector<Variable>& stack, std::optional<uint32_t>& nextPosition) const
   {
     ScopedVerifySqTop scopedVerify(vm);
 
+    const auto pathParts = ParseGlobalPath(path);
+    sq::VariableQueryContext context(options, pagination, &sortedKeysCache);
+    sq_pushroottable(vm);
+    const ReturnCode rc =
+            CreateChildVariablesFromIterable(vm, pathParts.begin(), pathParts.end(), pagination, context, stack);
+    sq_poptop(vm);
+
+    nextPosition = context.nextPosition;
+    return rc;
+  }
+
+  ReturnCode PopulateStackVariable(uint32_t stackFrame, const std::string& path, Variable& variable) const
+  {
+    return WithStackVariables(
+            stackFrame, path, [vm = this->vm, &variable](sq::PathPartConstIter begin, sq::PathPartConstIter end) {
+              return sq::WithVariableAtPath(vm, begin + 1, end, [vm, &variable, end]() {
+                variable.pathIterator = *(end - 1);
+                return sq::CreateChildVariable(vm, variable);
+              });
+            });
+  }
+
+  ReturnCode PopulateGlobalVariable(const std::string& path, Variable& variable) const
+  {
+    ScopedVerifySqTop scopedVerify(vm);
+
+    const auto pathParts = ParseGlobalPath(path);
+    sq_pushroottable(vm);
+    const ReturnCode rc = sq::WithVariableAtPath(vm, pathParts.begin(), pathParts.end(), [this, &pathParts, &variable]() {
+      variable.pathIterator = pathParts.empty() ? 0U : pathParts.back();
+      return sq::CreateChildVariable(vm, variable);
+    });
+    sq_poptop(vm);
+
+    return rc;
+  }
+
+  // Calls fn with the variable at the given path on top of the stack. If stackFrame is -1, path is relative to the root
+  // table; otherwise the first part of the path is the index of a local in that frame.
+  ReturnCode WithVariable(int32_t stackFrame, const std::string& path, const std::function<ReturnCode()>& fn) const
+  {
+    if (stackFrame < 0) {
+      ScopedVerifySqTop scopedVerify(vm);
+
+      const auto pathParts = ParseGlobalPath(path);
+      sq_pushroottable(vm);
+      const ReturnCode rc = sq::WithVariableAtPath(vm, pathParts.begin(), pathParts.end(), fn);
+      sq_poptop(vm);
+      return rc;
+    }
+
+    return WithStackVariables(
+            stackFrame, path, [vm = this->vm, &fn](sq::PathPartConstIter begin, sq::PathPartConstIter end) {
+              return sq::WithVariableAtPath(vm, begin + 1, end, fn);
+            });
+  }
+
+  static std::vector<uint64_t> ParseGlobalPath(const std::string& path)
+  {
     std::vector<uint64_t> pathParts;
     if (!path.empty()) {
       // Convert comma-separated list to vector
@@ -179,12 +341,7 @@ struct SquirrelVmDataImpl {
         pathParts.emplace_back(stoi(substr));
       }
     }
-
-    sq_pushroottable(vm);
-    const ReturnCode rc = CreateChildVariablesFromIterable(vm, pathParts.begin(), pathParts.end(), pagination, stack);
-    sq_poptop(vm);
-
-    return rc;
+    return pathParts;
   }
 
   ReturnCode SetStackVariableValue(uint32_t stackFrame, const std::string& path, const std::string& newValueString, data::Variable& newValue) {
@@ -220,7 +377,17 @@ struct SquirrelVmDataImpl {
     });
   }
 
+  // Must only be called while paused, with the pause mutex held.
+  const sq::StackLocals& GetLocals(uint32_t stackFrame) const
+  {
+    return localsCache.GetFrame(vm, stackFrame);
+  }
+
   HSQUIRRELVM vm = nullptr;
+  // Locals of each frame that has been inspected during this pause. Cleared each time the application resumes.
+  mutable sq::StackLocalsCache localsCache;
+  // Sorted keys of tables listed during this pause. Cleared each time the application resumes, or a value is edited.
+  mutable sq::SortedKeysCache sortedKeysCache;
 
   struct StackInfo {
     BreakpointMap::FileNameHandle fileNameHandle;
@@ -271,6 +438,23 @@ void SquirrelDebugger::DetachVm(SQVM* const vm)
       pauseCv_.notify_all();
     }
 
+    // String constants still held by expressions, and objects held by data breakpoints, are owned by the VM and are
+    // freed when it is closed.
+    for (auto& watch : pauseMutexData_->watches) {
+      watch.expression->ForgetVm();
+    }
+    pauseMutexData_->breakpoints.ForEach([](const Breakpoint& bp) {
+      if (bp.condition != nullptr) {
+        bp.condition->ForgetVm();
+      }
+    });
+    pauseMutexData_->expressionsToRelease.clear();
+    pauseMutexData_->dataBreakpoints.clear();
+    pauseMutexData_->objectsToRelease.clear();
+    pauseMutexData_->keyIteratorIndex.Clear();
+    vmData_->localsCache.Clear();
+    vmData_->sortedKeysCache.Clear();
+
     vmData_->vm = nullptr;
     vmData_->currentStack.clear();
     vmData_->fileNameHandles.clear();
@@ -323,9 +507,37 @@ ReturnCode SquirrelDebugger::StepIn()
   return Step(PauseType::StepIn, -1);
 }
 
+namespace sdb::internal {
+// Cursors are opaque to clients. The upper half is the pause epoch that they were created in, and the lower half the
+// position that the next page starts at: an sq_next iterator, or an offset into the sorted keys of a small table.
+uint64_t CreatePageCursor(const uint32_t pauseEpoch, const std::optional<uint32_t>& nextPosition)
+{
+  if (!nextPosition.has_value()) {
+    return 0U;
+  }
+  return (static_cast<uint64_t>(pauseEpoch) << 32U) | nextPosition.value();
+}
+
+// Replaces pagination.beginIterator with the position stored in pagination.cursor, if there is one. Returns false if
+// the cursor was created during an earlier pause.
+bool ResolvePageCursor(const uint32_t pauseEpoch, const PaginationInfo& pagination, PaginationInfo& resolved)
+{
+  resolved = pagination;
+  if (pagination.cursor == 0U) {
+    return true;
+  }
+  if (static_cast<uint32_t>(pagination.cursor >> 32U) != pauseEpoch) {
+    SDB_LOGD(kLogTag, "Cursor has expired, the program has resumed since it was created.");
+    return false;
+  }
+  resolved.beginIterator = static_cast<uint32_t>(pagination.cursor & UINT32_MAX);
+  return true;
+}
+}// namespace sdb::internal
+
 ReturnCode SquirrelDebugger::GetStackVariables(
         const uint32_t stackFrame, const std::string& path, const PaginationInfo& pagination,
-        std::vector<Variable>& variables)
+        const data::VariableQueryOptions& options, std::vector<Variable>& variables, uint64_t& nextCursor)
 {
   SDB_LOGD(kLogTag, "GetStackVariables");
   std::lock_guard lock(pauseMutex_);
@@ -338,11 +550,23 @@ ReturnCode SquirrelDebugger::GetStackVariables(
     SDB_LOGD(kLogTag, "cannot retrieve stack variables, requested stack frame exceeds current stack depth");
     return ReturnCode::InvalidParameter;
   }
-  return vmData_->PopulateStackVariables(stackFrame, path, pagination, variables);
+
+  const auto pauseEpoch = pauseMutexData_->pauseEpoch;
+  PaginationInfo resolvedPagination;
+  if (!internal::ResolvePageCursor(pauseEpoch, pagination, resolvedPagination)) {
+    return ReturnCode::InvalidParameter;
+  }
+
+  std::optional<uint32_t> nextPosition;
+  const auto rc =
+          vmData_->PopulateStackVariables(stackFrame, path, resolvedPagination, options, variables, nextPosition);
+  nextCursor = internal::CreatePageCursor(pauseEpoch, nextPosition);
+  return rc;
 }
 
 ReturnCode SquirrelDebugger::GetGlobalVariables(
-        const std::string& path, const PaginationInfo& pagination, std::vector<Variable>& variables)
+        const std::string& path, const PaginationInfo& pagination, const data::VariableQueryOptions& options,
+        std::vector<Variable>& variables, uint64_t& nextCursor)
 {
   SDB_LOGD(kLogTag, "GetGlobalVariables");
   std::lock_guard lock(pauseMutex_);
@@ -351,75 +575,160 @@ ReturnCode SquirrelDebugger::GetGlobalVariables(
     return ReturnCode::InvalidNotPaused;
   }
 
-  return vmData_->PopulateGlobalVariables(path, pagination, variables);
+  const auto pauseEpoch = pauseMutexData_->pauseEpoch;
+  PaginationInfo resolvedPagination;
+  if (!internal::ResolvePageCursor(pauseEpoch, pagination, resolvedPagination)) {
+    return ReturnCode::InvalidParameter;
+  }
+
+  std::optional<uint32_t> nextPosition;
+  const auto rc = vmData_->PopulateGlobalVariables(path, resolvedPagination, options, variables, nextPosition);
+  nextCursor = internal::CreatePageCursor(pauseEpoch, nextPosition);
+  return rc;
 }
 
-ReturnCode SquirrelDebugger::SetStackVariableValue(uint32_t stackFrame, const std::string& path, const std::string& newValueString, data::Variable& newValue)
+ReturnCode SquirrelDebugger::GetStackVariable(
+        const uint32_t stackFrame, const std::string& path, Variable& variable)
 {
-  SDB_LOGD(kLogTag, "SetStackVariableValue");
+  SDB_LOGD(kLogTag, "GetStackVariable");
   std::lock_guard lock(pauseMutex_);
   if (!pauseMutexData_->isPaused) {
-    SDB_LOGD(kLogTag, "cannot set stack variable, not paused.");
+    SDB_LOGD(kLogTag, "cannot retrieve stack variable, not paused.");
     return ReturnCode::InvalidNotPaused;
   }
 
   if (stackFrame > vmData_->currentStack.size()) {
-    SDB_LOGD(kLogTag, "cannot retrieve stack variables, requested stack frame exceeds current stack depth");
+    SDB_LOGD(kLogTag, "cannot retrieve stack variable, requested stack frame exceeds current stack depth");
     return ReturnCode::InvalidParameter;
   }
-  return vmData_->SetStackVariableValue(stackFrame, path, newValueString, newValue);
+  if (path.empty()) {
+    SDB_LOGD(kLogTag, "cannot retrieve stack variable, path must not be empty");
+    return ReturnCode::InvalidParameter;
+  }
+  return vmData_->PopulateStackVariable(stackFrame, path, variable);
 }
 
-void PrintNode(ExpressionNode* node)
+ReturnCode SquirrelDebugger::GetGlobalVariable(const std::string& path, Variable& variable)
 {
-  while (node) {
-    if (node->accessorValue.empty()) {
-      SDB_LOGD(kLogTag, "[");
-      PrintNode(node->accessorExpression.get());
-      SDB_LOGD(kLogTag, "]");
-    }
-    else {
-      SDB_LOGD(kLogTag, "type: %d, value: %s", node->type, node->accessorValue.c_str());
-    }
-    node = node->next.get();
+  SDB_LOGD(kLogTag, "GetGlobalVariable");
+  std::lock_guard lock(pauseMutex_);
+  if (!pauseMutexData_->isPaused) {
+    SDB_LOGD(kLogTag, "cannot retrieve global variable, not paused.");
+    return ReturnCode::InvalidNotPaused;
   }
+
+  return vmData_->PopulateGlobalVariable(path, variable);
 }
 
-struct RefOwner {
-  RefOwner(HSQUIRRELVM vm)
-      : vm(vm)
-  {}
+ReturnCode SquirrelDebugger::GetArraySlice(
+        const int32_t stackFrame, const std::string& path, const PaginationInfo& range, data::ArraySlice& slice)
+{
+  SDB_LOGD(kLogTag, "GetArraySlice stackFrame=%" PRId32 " path=%s", stackFrame, path.c_str());
+  std::lock_guard lock(pauseMutex_);
+  if (!pauseMutexData_->isPaused) {
+    SDB_LOGD(kLogTag, "cannot read array slice, not paused.");
+    return ReturnCode::InvalidNotPaused;
+  }
+
+  if (stackFrame >= 0 && (static_cast<uint32_t>(stackFrame) > vmData_->currentStack.size() || path.empty())) {
+    SDB_LOGD(kLogTag, "cannot read array slice, invalid stack frame or path");
+    return ReturnCode::InvalidParameter;
+  }
+
+  const auto vm = vmData_->vm;
+  sq::NumericArrayValues values;
+  uint32_t arraySize = 0;
+  const auto rc = vmData_->WithVariable(stackFrame, path, [vm, &range, &arraySize, &values]() {
+    return sq::ReadNumericArray(vm, range, arraySize, values);
+  });
+  if (rc != ReturnCode::Success) {
+    return rc;
+  }
+
+  slice.beginIndex = range.beginIterator;
+  slice.arraySize = arraySize;
+  const auto copyToSlice = [&slice](const auto& elements, const VariableType elementType) {
+    if (elements.empty()) {
+      return;
+    }
+    slice.elementType = elementType;
+    slice.elementSize = sizeof(elements[0]);
+    const auto* const bytes = reinterpret_cast<const uint8_t*>(elements.data());
+    slice.data.assign(bytes, bytes + elements.size() * sizeof(elements[0]));
+  };
+  if (values.isFloat) {
+    copyToSlice(values.floats, VariableType::Float);
+  }
+  else {
+    copyToSlice(values.integers, VariableType::Integer);
+  }
+  return ReturnCode::Success;
+}
 
-  ~RefOwner()
+ReturnCode SquirrelDebugger::GetArrayStatistics(
+        const int32_t stackFrame, const std::string& path, const PaginationInfo& range,
+        const uint32_t histogramBinCount, data::ArrayStatistics& statistics)
+{
+  SDB_LOGD(kLogTag, "GetArrayStatistics stackFrame=%" PRId32 " path=%s", stackFrame, path.c_str());
+  sq::NumericArrayValues values;
+  uint32_t arraySize = 0;
   {
-    if (vm) {
-      for (auto po : objectsToCleanup) {
-        sq_release(vm, &po);
-      }
+    std::lock_guard lock(pauseMutex_);
+    if (!pauseMutexData_->isPaused) {
+      SDB_LOGD(kLogTag, "cannot compute array statistics, not paused.");
+      return ReturnCode::InvalidNotPaused;
+    }
+
+    if (stackFrame >= 0 && (static_cast<uint32_t>(stackFrame) > vmData_->currentStack.size() || path.empty())) {
+      SDB_LOGD(kLogTag, "cannot compute array statistics, invalid stack frame or path");
+      return ReturnCode::InvalidParameter;
+    }
+
+    const auto vm = vmData_->vm;
+    const auto rc = vmData_->WithVariable(stackFrame, path, [vm, &range, &arraySize, &values]() {
+      return sq::ReadNumericArray(vm, range, arraySize, values);
+    });
+    if (rc != ReturnCode::Success) {
+      return rc;
     }
   }
 
-  std::vector<HSQOBJECT> objectsToCleanup;
-  HSQUIRRELVM vm = nullptr;
-};
+  // The values are a copy, so there is no need to hold the VM paused while crunching them.
+  statistics.arraySize = arraySize;
+  if (values.isFloat) {
+    ComputeArrayStatistics(values.floats.data(), values.floats.size(), histogramBinCount, statistics);
+  }
+  else {
+    ComputeArrayStatistics(values.integers.data(), values.integers.size(), histogramBinCount, statistics);
+  }
+  return ReturnCode::Success;
+}
 
-ReturnCode SquirrelDebugger::GetImmediateValue(
-        const int32_t stackFrame, const std::string& watch, const PaginationInfo& pagination,
-        ImmediateValue& foundRootVariable)
+ReturnCode SquirrelDebugger::SetStackVariableValue(uint32_t stackFrame, const std::string& path, const std::string& newValueString, data::Variable& newValue)
 {
-  SDB_LOGD(kLogTag, "GetImmediateValue stackFrame=%" PRIu32 " watch=%s", stackFrame, watch.c_str());
-
-  // We run our own mini-lexer here as we don't want to allow full SQ execution. Just want to find a variable to inspect.
+  SDB_LOGD(kLogTag, "SetStackVariableValue");
+  std::lock_guard lock(pauseMutex_);
+  if (!pauseMutexData_->isPaused) {
+    SDB_LOGD(kLogTag, "cannot set stack variable, not paused.");
+    return ReturnCode::InvalidNotPaused;
+  }
 
-  // Parse the watch string before locking
+  if (stackFrame > vmData_->currentStack.size()) {
+    SDB_LOGD(kLogTag, "cannot retrieve stack variables, requested stack frame exceeds current stack depth");
+    return ReturnCode::InvalidParameter;
+  }
+  // Filters can match on values, so the sorted keys may no longer be right.
+  vmData_->sortedKeysCache.Clear();
+  return vmData_->SetStackVariableValue(stackFrame, path, newValueString, newValue);
+}
 
-  std::unique_ptr<ExpressionNode> expressionRoot;
+namespace sdb::internal {
+ReturnCode CompileWatch(const std::string& watch, std::shared_ptr<CompiledExpression>& expression)
+{
+  // We run our own mini compiler here as we don't want to allow full SQ execution; just simple, side effect free
+  // expressions.
   try {
-    auto pos = watch.begin();
-    expressionRoot = sq::ParseExpression(pos, watch.end());
-    if (pos != watch.end()) {
-      throw WatchParseError("Invalid content after the end of the parsed expression", pos);
-    }
+    expression = std::make_shared<CompiledExpression>(watch);
   }
   catch (const WatchParseError& err) {
     const auto offset = err.pos - watch.begin();
@@ -429,6 +738,76 @@ ReturnCode SquirrelDebugger::GetImmediateValue(
             watch.c_str(), underArrow.c_str());
     return ReturnCode::InvalidParameter;
   }
+  return ReturnCode::Success;
+}
+
+// Must only be called from the Squirrel Execution Thread, or while it is paused, with the pause mutex held.
+void ReleaseRemovedObjects(const SquirrelVmDataImpl& vmData, PauseMutexDataImpl& pauseMutexData)
+{
+  for (const auto& expression : pauseMutexData.expressionsToRelease) {
+    expression->ReleaseConstants(vmData.vm);
+  }
+  pauseMutexData.expressionsToRelease.clear();
+
+  for (auto& object : pauseMutexData.objectsToRelease) {
+    sq_release(vmData.vm, &object);
+  }
+  pauseMutexData.objectsToRelease.clear();
+}
+
+// Reads the current value of the watched slot, without invoking any metamethods. A missing slot reads as null.
+// Must only be called from the Squirrel Execution Thread, or while it is paused.
+void ReadDataBreakpointValue(HSQUIRRELVM v, const DataBreakpoint& dataBp, SQObjectType& type, SQRawObjectVal& raw)
+{
+  type = OT_NULL;
+  raw = 0;
+  sq_pushobject(v, dataBp.container);
+  sq_pushobject(v, dataBp.key);
+  if (SQ_SUCCEEDED(sq_rawget(v, -2))) {
+    HSQOBJECT value;
+    sq_getstackobj(v, -1, &value);
+    type = value._type;
+    raw = value._unVal.raw;
+    sq_poptop(v);// pop value
+  }
+  sq_poptop(v);// pop container
+}
+
+// Returns the ID of the first data breakpoint whose value has changed since it was last checked, or 0 if none have.
+// Every changed breakpoint is updated with its new value.
+// The public API gives no stable pointer to a slot (table nodes move when the table is resized), so each breakpoint
+// costs two pushes and a sq_rawget per line: a hash lookup for tables and instances, and an index for arrays.
+// Must only be called from the Squirrel Execution Thread, or while it is paused, with the pause mutex held.
+uint64_t CheckDataBreakpoints(const SquirrelVmDataImpl& vmData, PauseMutexDataImpl& pauseMutexData)
+{
+  uint64_t changedId = 0;
+  for (auto& dataBp : pauseMutexData.dataBreakpoints) {
+    SQObjectType type;
+    SQRawObjectVal raw;
+    ReadDataBreakpointValue(vmData.vm, dataBp, type, raw);
+    if (type != dataBp.valueType || raw != dataBp.valueRaw) {
+      dataBp.valueType = type;
+      dataBp.valueRaw = raw;
+      if (changedId == 0) {
+        changedId = dataBp.id;
+      }
+    }
+  }
+  return changedId;
+}
+}// namespace sdb::internal
+
+ReturnCode SquirrelDebugger::GetImmediateValue(
+        const int32_t stackFrame, const std::string& watch, const PaginationInfo& pagination,
+        ImmediateValue& foundRootVariable)
+{
+  SDB_LOGD(kLogTag, "GetImmediateValue stackFrame=%" PRIu32 " watch=%s", stackFrame, watch.c_str());
+
+  // Compile the watch string before locking
+  std::shared_ptr<CompiledExpression> expression;
+  if (const auto rc = internal::CompileWatch(watch, expression); rc != ReturnCode::Success) {
+    return rc;
+  }
 
   SDB_LOGD(kLogTag, "Parsed expression OK. Will now evaluate");
 
@@ -438,187 +817,213 @@ ReturnCode SquirrelDebugger::GetImmediateValue(
     return ReturnCode::InvalidNotPaused;
   }
 
-  // Stack of expression roots, that need to be evaluated by sq::GetObjectFromExpression
-  std::deque<ExpressionNode*> stack;
-  stack.push_back(expressionRoot.get());
+  const auto* const locals = stackFrame >= 0 ? &vmData_->GetLocals(static_cast<uint32_t>(stackFrame)) : nullptr;
+  const auto rc = expression->Evaluate(vmData_->vm, locals, pauseMutexData_->keyIteratorIndex, foundRootVariable);
+  expression->ReleaseConstants(vmData_->vm);
+  return rc;
+}
+
+ReturnCode SquirrelDebugger::ExportVariable(
+        const int32_t stackFrame, const std::string& watch, const data::ExportOptions& options,
+        const std::function<bool(std::string_view)>& writeFn, data::ExportResult& result)
+{
+  SDB_LOGD(kLogTag, "ExportVariable stackFrame=%" PRId32 " watch=%s", stackFrame, watch.c_str());
+
+  // Compile the watch string before locking
+  std::shared_ptr<CompiledExpression> expression;
+  if (const auto rc = internal::CompileWatch(watch, expression); rc != ReturnCode::Success) {
+    return rc;
+  }
+
+  std::lock_guard lock(pauseMutex_);
+  if (!pauseMutexData_->isPaused) {
+    SDB_LOGD(kLogTag, "cannot export variable, not paused.");
+    return ReturnCode::InvalidNotPaused;
+  }
 
   const auto vm = vmData_->vm;
-  auto refOwner = RefOwner(vm);
+  const auto* const locals = stackFrame >= 0 ? &vmData_->GetLocals(static_cast<uint32_t>(stackFrame)) : nullptr;
+  HSQOBJECT root = {};
+  auto rc = expression->EvaluateObject(vm, locals, root);
+  if (rc == ReturnCode::Success) {
+    sq_pushobject(vm, root);
+    sq::JsonExporter exporter(options, writeFn);
+    rc = exporter.Export(vm, result);
+    sq_poptop(vm);
+  }
+  expression->ReleaseConstants(vm);
+  return rc;
+}
 
-  // For each node in the expression tree:
-  // if it has an accessorExpression, need to evaluate that first: so put it on the stack
+ReturnCode SquirrelDebugger::SetPauseBundleConfig(const data::PauseBundleConfig& config)
+{
+  SDB_LOGD(kLogTag, "SetPauseBundleConfig enabled=%d", config.enabled);
 
-  //std::unordered_set<ExpressionNode*> treesWithResolvedAccessorExpressions;
-  struct ExpressionNodeState {
-    std::unique_ptr<sq::SqExpressionNode> sqNode;
-    std::vector<uint32_t> iteratorPath;
-    HSQOBJECT resolvedValue;
-    data::VariableScope scope;
-  };
-  std::unordered_map<ExpressionNode*, ExpressionNodeState> expressionResults;
+  std::lock_guard lock(pauseMutex_);
+  pauseMutexData_->pauseBundleConfig = config;
+  return ReturnCode::Success;
+}
 
-  while (!stack.empty()) {
-    ExpressionNode* node = stack.back();
+ReturnCode SquirrelDebugger::AddWatch(const std::string& watch, uint64_t& watchId)
+{
+  SDB_LOGD(kLogTag, "AddWatch watch=%s", watch.c_str());
 
-    // Look through the 'next' list and add any root expressions that need evaluating.
-    {
-      ExpressionNode* nextNode = node;
-      bool hasUnresolvedDependencies = false;
-      while (nextNode != nullptr) {
-        if (nextNode->accessorExpression != nullptr &&
-            expressionResults.find(nextNode->accessorExpression.get()) == expressionResults.end())
-        {
-          // If so, need to make sure that the next node's accessorExpression is resolved first.
-          stack.push_back(nextNode->accessorExpression.get());
-          hasUnresolvedDependencies = true;
-        }
-        nextNode = nextNode->next.get();
-      }
+  // Compile the watch string before locking
+  internal::RegisteredWatch registeredWatch;
+  if (const auto rc = internal::CompileWatch(watch, registeredWatch.expression); rc != ReturnCode::Success) {
+    return rc;
+  }
+  registeredWatch.watch = watch;
 
-      if (hasUnresolvedDependencies) {
-        continue;
-      }
-    }
+  std::lock_guard lock(pauseMutex_);
+  registeredWatch.id = pauseMutexData_->nextWatchId++;
+  watchId = registeredWatch.id;
+  pauseMutexData_->watches.emplace_back(std::move(registeredWatch));
+  return ReturnCode::Success;
+}
 
-    stack.pop_back();
+ReturnCode SquirrelDebugger::RemoveWatch(const uint64_t watchId)
+{
+  SDB_LOGD(kLogTag, "RemoveWatch watchId=%" PRIu64, watchId);
 
-    // Contains the execution results for this node.
+  std::lock_guard lock(pauseMutex_);
+  auto& watches = pauseMutexData_->watches;
+  const auto watchPos = std::find_if(
+          watches.begin(), watches.end(), [watchId](const auto& watch) { return watch.id == watchId; });
+  if (watchPos == watches.end()) {
+    return ReturnCode::InvalidParameter;
+  }
 
-    // Create HSQOBJECT representations of all nodes in this tree
-    ExpressionNodeState nodeResult;
-    {
-      ExpressionNode* nodeIter = node;
-      nodeResult.sqNode = std::make_unique<sq::SqExpressionNode>();
-      sq::SqExpressionNode* lastSqNode = nodeResult.sqNode.get();
-      while (nodeIter != nullptr) {
-        auto& targetSqObject = lastSqNode->accessorObject;
-        if (nodeIter->accessorExpression != nullptr) {
-          auto accessorExpressionResultPos = expressionResults.find(nodeIter->accessorExpression.get());
-          if (accessorExpressionResultPos == expressionResults.end()) {
-            SDB_LOGE(
-                    kLogTag,
-                    "Attempting to resolve a root expression where the accessor expression is not yet resolved.");
-            return ReturnCode::ErrorInternal;
-          }
-          targetSqObject = accessorExpressionResultPos->second.resolvedValue;
-        }
-        else
-        {
-          if (node->type == ExpressionNodeType::Number) {
-            errno = 0;
-            const int intVal = strtol(node->accessorValue.c_str(), nullptr, 10);
-            if (errno == ERANGE) {
-              SDB_LOGD(
-                      kLogTag, "expressionNode value %s exceeds maximum parsable integer.",
-                      node->accessorValue.c_str());
-              return ReturnCode::InvalidParameter;
-            }
-            sq_pushinteger(vm, intVal);
-            sq_getstackobj(vm, -1, &targetSqObject);
-            sq_poptop(vm);
-          }
-          else {
-            // It's a string, which is ref counted. So need to make sure we keep it alive, then clean up after ourselves later.
-            const SQChar* chars = node->accessorValue.c_str();
-            sq_pushstring(vm, chars, node->accessorValue.size());
-            sq_getstackobj(vm, -1, &targetSqObject);
-            sq_addref(vm, &targetSqObject);
-            refOwner.objectsToCleanup.push_back(targetSqObject);
-            sq_poptop(vm);
-          }
-        }
+  pauseMutexData_->expressionsToRelease.push_back(watchPos->expression);
+  watches.erase(watchPos);
 
-        nodeIter = nodeIter->next.get();
-        if (nodeIter != nullptr) {
-          lastSqNode->next = std::make_unique<sq::SqExpressionNode>();
-        }
-        lastSqNode = lastSqNode->next.get();
-      }
-    }
+  // While paused it is safe to release now, otherwise wait until the next line hook.
+  if (pauseMutexData_->isPaused) {
+    internal::ReleaseRemovedObjects(*vmData_, *pauseMutexData_);
+  }
+  return ReturnCode::Success;
+}
 
-    if (node->type == ExpressionNodeType::Identifier) {
-      auto& iteratorPath = nodeResult.iteratorPath;
-
-      // evaluate this expression accessor
-      const std::string& accessorValue = node->accessorValue;
-      if (stackFrame >= 0) {
-        ScopedVerifySqTop scopedVerify(vm);
-        // Is there a local by this name?
-        sq_newtable(vm);
-        for (SQUnsignedInteger nSeq = 0;; ++nSeq) {
-          // Push local with given index to stack
-          const auto* const localName = sq_getlocal(vm, stackFrame, nSeq);
-          if (localName == nullptr) {
-            break;
-          }
-          if (localName == accessorValue) {
-
-            sq_pushstring(vm, localName, accessorValue.size());
-            sq_push(vm, -2);
-            sq_rawset(vm, -4);
-            sq_poptop(vm);// pop local variable now so that the table is passed in to the expression
-            const auto rc = GetObjectFromExpression(
-                    vm, nodeResult.sqNode.get(), pagination, nodeResult.resolvedValue, iteratorPath);
-            if (rc != ReturnCode::Success) {
-              sq_poptop(vm);// pop temp table
-              SDB_LOGD(kLogTag, "Failed to read local variable: %s", accessorValue.c_str());
-              return rc;
-            }
-
-            // The first location in the iterator path will just be the iterator in the temporary table. Conveniently
-            // we can just replace this with the iterator to the local variable
-            iteratorPath[0] = static_cast<uint32_t>(nSeq);
-
-            nodeResult.scope = data::VariableScope::Local;
-            break;
-          }
-
-          sq_poptop(vm);// pop local variable
-        }
-        sq_poptop(vm);// pop temp table
-      }
+ReturnCode SquirrelDebugger::AddDataBreakpoint(
+        const int32_t stackFrame, const std::string& watch, uint64_t& dataBreakpointId)
+{
+  SDB_LOGD(kLogTag, "AddDataBreakpoint stackFrame=%" PRId32 " watch=%s", stackFrame, watch.c_str());
 
-      if (iteratorPath.empty()) {
-        sq_pushroottable(vm);
-        const auto rc = GetObjectFromExpression(
-                vm, nodeResult.sqNode.get(), pagination, nodeResult.resolvedValue, iteratorPath);
-        sq_poptop(vm);
-        if (rc != ReturnCode::Success) {
-          SDB_LOGD(kLogTag, "Failed to read variable from root table: %s", accessorValue.c_str());
-          return rc;
-        }
-        nodeResult.scope = data::VariableScope::Global;
-      }
-    }
-    else
-    {
-      nodeResult.resolvedValue = nodeResult.sqNode->accessorObject;
-      nodeResult.scope = data::VariableScope::Evaluation;
-    }
+  // Compile the watch string before locking
+  std::shared_ptr<CompiledExpression> expression;
+  if (const auto rc = internal::CompileWatch(watch, expression); rc != ReturnCode::Success) {
+    return rc;
+  }
 
-    expressionResults[node] = std::move(nodeResult);
+  std::lock_guard lock(pauseMutex_);
+  if (!pauseMutexData_->isPaused) {
+    SDB_LOGD(kLogTag, "cannot add data breakpoint, not paused.");
+    return ReturnCode::InvalidNotPaused;
   }
 
-  // Now convert the found SQOBJECT into a variable to return back
-  {
-    const auto rootResultPos = expressionResults.find(expressionRoot.get());
-    if (rootResultPos == expressionResults.end()) {
-      SDB_LOGD(kLogTag, "Expression must not be empty.");
-      return ReturnCode::InvalidParameter;
-    }
+  const auto vm = vmData_->vm;
+  internal::DataBreakpoint dataBp;
+  const auto* const locals = stackFrame >= 0 ? &vmData_->GetLocals(static_cast<uint32_t>(stackFrame)) : nullptr;
+  const auto rc = expression->ResolveMember(vm, locals, dataBp.container, dataBp.key);
+  if (rc != ReturnCode::Success) {
+    expression->ReleaseConstants(vm);
+    return rc;
+  }
 
-    auto& nodeState = rootResultPos->second;
+  // Take a reference to the container so that it outlives the stack frame it was found in. The key may be a string
+  // constant owned by the expression, which nothing else holds if the slot doesn't exist yet, so must be referenced
+  // before the expression releases its constants.
+  sq_addref(vm, &dataBp.container);
+  sq_addref(vm, &dataBp.key);
+  expression->ReleaseConstants(vm);
+
+  const auto containerType = sq_type(dataBp.container);
+  if (containerType != OT_TABLE && containerType != OT_ARRAY && containerType != OT_INSTANCE) {
+    SDB_LOGD(kLogTag, "cannot add data breakpoint, %s is not a container", sq::ToSqObjectTypeName(containerType));
+    sq_release(vm, &dataBp.container);
+    sq_release(vm, &dataBp.key);
+    return ReturnCode::InvalidParameter;
+  }
 
-    sq_pushobject(vm, nodeState.resolvedValue);
-    CreateChildVariable(vm, foundRootVariable.variable);
-    sq_poptop(vm);
+  dataBp.id = pauseMutexData_->nextDataBreakpointId++;
+  dataBp.watch = watch;
+  internal::ReadDataBreakpointValue(vm, dataBp, dataBp.valueType, dataBp.valueRaw);
+
+  dataBreakpointId = dataBp.id;
+  pauseMutexData_->dataBreakpoints.emplace_back(std::move(dataBp));
+  return ReturnCode::Success;
+}
 
-    foundRootVariable.iteratorPath = nodeState.iteratorPath;
-    foundRootVariable.scope = nodeState.scope;
+ReturnCode SquirrelDebugger::RemoveDataBreakpoint(const uint64_t dataBreakpointId)
+{
+  SDB_LOGD(kLogTag, "RemoveDataBreakpoint dataBreakpointId=%" PRIu64, dataBreakpointId);
 
-    return ReturnCode::Success;
+  std::lock_guard lock(pauseMutex_);
+  auto& dataBps = pauseMutexData_->dataBreakpoints;
+  const auto dataBpPos = std::find_if(dataBps.begin(), dataBps.end(), [dataBreakpointId](const auto& dataBp) {
+    return dataBp.id == dataBreakpointId;
+  });
+  if (dataBpPos == dataBps.end()) {
+    return ReturnCode::InvalidParameter;
+  }
+
+  pauseMutexData_->objectsToRelease.push_back(dataBpPos->container);
+  pauseMutexData_->objectsToRelease.push_back(dataBpPos->key);
+  dataBps.erase(dataBpPos);
+
+  // While paused it is safe to release now, otherwise wait until the next line hook.
+  if (pauseMutexData_->isPaused) {
+    internal::ReleaseRemovedObjects(*vmData_, *pauseMutexData_);
+  }
+  return ReturnCode::Success;
+}
+
+namespace sdb::internal {
+// Must be called from the Squirrel Execution Thread while paused, with the pause mutex held.
+void BuildPauseBundle(
+        const SquirrelVmDataImpl& vmData, const PauseMutexDataImpl& pauseMutexData, data::PauseBundle& pauseBundle)
+{
+  const auto& config = pauseMutexData.pauseBundleConfig;
+  const data::VariableQueryOptions options = {};
+  // The bundle is a single page; there's no way to continue it.
+  std::optional<uint32_t> nextPosition;
+
+  if (config.localsCount > 0U) {
+    const auto rc = vmData.PopulateStackVariables(
+            0U, "", {0U, config.localsCount}, options, pauseBundle.locals, nextPosition);
+    if (rc != ReturnCode::Success) {
+      SDB_LOGD(kLogTag, "BuildPauseBundle: failed to read locals");
+    }
+  }
+  if (config.globalsCount > 0U) {
+    const auto rc =
+            vmData.PopulateGlobalVariables("", {0U, config.globalsCount}, options, pauseBundle.globals, nextPosition);
+    if (rc != ReturnCode::Success) {
+      SDB_LOGD(kLogTag, "BuildPauseBundle: failed to read globals");
+    }
+  }
+}
+
+// Must be called from the Squirrel Execution Thread while paused, with the pause mutex held.
+void EvaluateRegisteredWatches(
+        const SquirrelVmDataImpl& vmData, PauseMutexDataImpl& pauseMutexData, std::vector<data::WatchResult>& results)
+{
+  results.clear();
+  results.reserve(pauseMutexData.watches.size());
+  if (pauseMutexData.watches.empty()) {
+    return;
+  }
+
+  const auto& locals = vmData.GetLocals(0);
+  for (auto& watch : pauseMutexData.watches) {
+    auto& watchResult = results.emplace_back();
+    watchResult.id = watch.id;
+    watchResult.watch = watch.watch;
+    watchResult.code =
+            watch.expression->Evaluate(vmData.vm, &locals, pauseMutexData.keyIteratorIndex, watchResult.value);
   }
 }
+}// namespace sdb::internal
 
 ReturnCode SquirrelDebugger::SetFileBreakpoints(
         const std::string& file, const std::vector<data::CreateBreakpoint>& createBps,
@@ -630,7 +1035,7 @@ ReturnCode SquirrelDebugger::SetFileBreakpoints(
 
   // First resolve the breakpoints against the script file.
   std::vector<Breakpoint> bps;
-  for (const auto& [id, line] : createBps) {
+  for (const auto& [id, line, condition] : createBps) {
     if (id == 0ULL) {
       SDB_LOGD(kLogTag, "SetFileBreakpoints Invalid field 'id', must be > 0");
     }
@@ -638,10 +1043,15 @@ ReturnCode SquirrelDebugger::SetFileBreakpoints(
       SDB_LOGD(kLogTag, "SetFileBreakpoints Invalid field 'line', must be > 0");
     }
     else {
-      bps.emplace_back(Breakpoint{id, line});
+      Breakpoint bp = {id, line};
+      // A breakpoint with a condition that doesn't compile is reported as unverified, and never hit.
+      const bool verified = condition.empty() || internal::CompileWatch(condition, bp.condition) == ReturnCode::Success;
+      if (verified) {
+        bps.emplace_back(std::move(bp));
+      }
 
       // todo: load file from disk, make sure line isn't empty.
-      resolvedBps.emplace_back(data::ResolvedBreakpoint{id, line, true});
+      resolvedBps.emplace_back(data::ResolvedBreakpoint{id, line, verified});
 
       continue;
     }
@@ -653,8 +1063,18 @@ ReturnCode SquirrelDebugger::SetFileBreakpoints(
     std::lock_guard lock(pauseMutex_);
 
     const auto handle = pauseMutexData_->breakpoints.EnsureFileNameHandle(file);
-    pauseMutexData_->breakpoints.Clear(handle);
+    std::vector<Breakpoint> removedBps;
+    pauseMutexData_->breakpoints.Clear(handle, removedBps);
     pauseMutexData_->breakpoints.AddAll(handle, bps);
+
+    for (auto& removedBp : removedBps) {
+      if (removedBp.condition != nullptr) {
+        pauseMutexData_->expressionsToRelease.emplace_back(std::move(removedBp.condition));
+      }
+    }
+    if (pauseMutexData_->isPaused) {
+      internal::ReleaseRemovedObjects(*vmData_, *pauseMutexData_);
+    }
   }
 
   return ReturnCode::Success;
@@ -705,6 +1125,37 @@ ReturnCode SquirrelDebugger::SendStatus()
   return ReturnCode::Success;
 }
 
+ReturnCode SquirrelDebugger::GetStack(
+        const PaginationInfo& range, std::vector<StackEntry>& stack, uint32_t& stackDepth)
+{
+  SDB_LOGD(kLogTag, "GetStack beginIterator=%" PRIu32 " count=%" PRIu32, range.beginIterator, range.count);
+  std::lock_guard lock(pauseMutex_);
+  if (!pauseMutexData_->isPaused) {
+    SDB_LOGD(kLogTag, "cannot retrieve stack, not paused.");
+    return ReturnCode::InvalidNotPaused;
+  }
+
+  stackDepth = vmData_->GetStackDepth();
+  if (range.beginIterator > stackDepth) {
+    SDB_LOGD(kLogTag, "cannot retrieve stack, requested stack frame exceeds current stack depth");
+    return ReturnCode::InvalidParameter;
+  }
+
+  vmData_->PopulateStack(range.beginIterator, range.count, stack);
+  return ReturnCode::Success;
+}
+
+ReturnCode SquirrelDebugger::GetPauseEpoch(uint32_t& pauseEpoch)
+{
+  std::lock_guard lock(pauseMutex_);
+  if (!pauseMutexData_->isPaused) {
+    return ReturnCode::InvalidNotPaused;
+  }
+
+  pauseEpoch = pauseMutexData_->pauseEpoch;
+  return ReturnCode::Success;
+}
+
 void SquirrelDebugger::SquirrelNativeDebugHook(
         SQVM* const /*v*/, const SQInteger type, const SQChar* sourceName, const SQInteger line,
         const SQChar* functionName)
@@ -757,31 +1208,75 @@ void SquirrelDebugger::SquirrelNativeDebugHook(
 
     std::unique_lock lock(pauseMutex_);
 
+    if (!pauseMutexData_->expressionsToRelease.empty() || !pauseMutexData_->objectsToRelease.empty()) {
+      internal::ReleaseRemovedObjects(*vmData_, *pauseMutexData_);
+    }
+
+    // Check for data breakpoints. A change made by the previous line is caught before this one runs.
+    uint64_t dataBpId = 0;
+    if (!pauseMutexData_->dataBreakpoints.empty()) {
+      dataBpId = internal::CheckDataBreakpoints(*vmData_, *pauseMutexData_);
+      if (dataBpId != 0) {
+        pauseMutexData_->returnsRequired = 0;
+        pauseRequested_ = PauseType::Pause;
+      }
+    }
+
     // Check for breakpoints
     if (line >= 0 && line < INT32_MAX && handle != nullptr &&
         pauseMutexData_->breakpoints.ReadBreakpoint(handle, static_cast<uint32_t>(line), bp))
     {
-      // right now, only support basic breakpoints so no further interrogation is needed.
-      pauseMutexData_->returnsRequired = 0;
-      pauseRequested_ = PauseType::Pause;
+      bool conditionMet = true;
+      if (bp.condition != nullptr) {
+        // Conditions that can't be evaluated (for example, they refer to a variable that isn't in scope) are not met.
+        const auto rc = bp.condition->EvaluateCondition(vmData_->vm, 0, functionName, conditionMet);
+        conditionMet = rc == ReturnCode::Success && conditionMet;
+      }
+
+      if (conditionMet) {
+        pauseMutexData_->returnsRequired = 0;
+        pauseRequested_ = PauseType::Pause;
+      }
+      else {
+        bp = {};
+      }
     }
 
     // Pause the thread if necessary
     if (pauseRequested_ != PauseType::None && pauseMutexData_->returnsRequired <= 0) {
       pauseMutexData_->isPaused = true;
+      // Skip 0, so that a cursor is never 0.
+      if (++pauseMutexData_->pauseEpoch == 0U) {
+        pauseMutexData_->pauseEpoch = 1U;
+      }
 
       auto& status = pauseMutexData_->status;
       status.runState = RunState::Paused;
       status.pausedAtBreakpointId = bp.id;
+      status.pausedAtDataBreakpointId = dataBpId;
 
-      vmData_->PopulateStack(status.stack);
+      status.stackDepth = vmData_->GetStackDepth();
+      vmData_->PopulateStack(0U, Status::kMaxStackFrames, status.stack);
+      internal::EvaluateRegisteredWatches(*vmData_, *pauseMutexData_, status.watches);
       if (eventInterface_) {
         eventInterface_->HandleStatusChanged(status);
+
+        if (pauseMutexData_->pauseBundleConfig.enabled) {
+          data::PauseBundle pauseBundle;
+          internal::BuildPauseBundle(*vmData_, *pauseMutexData_, pauseBundle);
+          eventInterface_->HandlePauseBundle(pauseBundle);
+        }
       }
 
       // This Cv will be signaled whenever the value of pauseRequested_ changes.
       pauseCv_.wait(lock);
       pauseMutexData_->isPaused = false;
+      pauseMutexData_->keyIteratorIndex.Clear();
+      vmData_->localsCache.Clear();
+      vmData_->sortedKeysCache.Clear();
+
+      // Values that were edited while paused shouldn't trigger a data breakpoint on resume.
+      internal::CheckDataBreakpoints(*vmData_, *pauseMutexData_);
     }
   }
 }
@@ -6,6 +6,10 @@
 
 #include <algorithm>
 #include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
 #include <mutex>
 #include <sstream>
 #include <unordered_map>
@@ -15,6 +19,9 @@ const char* const kLogTag = "SquirrelVmHelpers";
 
 const uint32_t kMaxTableSizeToSort = 1000;
 const uint32_t kMaxTableValueStringLength = 20;
+// Charged against a request's summary budget for each key that a summary reads, whether or not it's shown; so that
+// sorting the keys of large tables uses up the budget as well as the text they produce.
+const uint32_t kSummaryBytesPerKeyRead = 8;
 
 // Quirrel Reference Guide: https://quirrel.io/doc/reference/embedding_squirrel.html
 
@@ -70,16 +77,27 @@ struct WriteTableSummaryFieldHelper {
   SQVM* const vm;
   const bool isFirst;
 };
+// Like ToString, but doesn't summarize nested tables or instances; so the cost of a summary is bounded by the number of
+// fields it shows rather than the size of the whole object graph below it.
+std::string ToSummaryFieldString(SQVM* const v, const SQInteger idx)
+{
+  const auto type = sq_gettype(v, idx);
+  if (type == OT_TABLE || type == OT_INSTANCE) {
+    return "{...}";
+  }
+  return ToString(v, idx);
+}
+
 std::ostream& operator<<(std::ostream& ss, const WriteTableSummaryFieldHelper& helper)
 {
   auto* const v = helper.vm;
-  const auto valueStr = ToString(v, -1);
+  const auto valueStr = ToSummaryFieldString(v, -1);
   if (!valueStr.empty()) {
     if (!helper.isFirst) {
       ss << ", ";
     }
     sq_poptop(v);// pop val, so we can get the key
-    ss << ToString(v, -1) << ": " << valueStr;
+    ss << ToSummaryFieldString(v, -1) << ": " << valueStr;
     sq_poptop(v);// pop key
   }
   else {
@@ -132,20 +150,28 @@ void getClassesFullNameHelper(
   sq_pop(v, 1);//pops the null iterator
 }
 
-void CreateTableSummary(HSQUIRRELVM v, std::stringstream& ss)
+// Returns the number of keys that were read to build the summary. Tables with more than maxKeysToSort keys are
+// summarized in iteration order, even in Sorted mode.
+uint32_t CreateTableSummary(
+        HSQUIRRELVM v, const data::SummaryMode summaryMode, const uint32_t maxFieldCount, const uint32_t maxKeysToSort,
+        std::stringstream& ss)
 {
   ss << "{";
+  uint32_t keysRead = 0;
   // Table keys are not sorted alphabetically when iterating via sq_next.
   // If there aren't a large number of keys; get everything and perform a sort.
   const auto keyCount = sq_getsize(v, -1);
-  if (keyCount < kMaxTableSizeToSort) {
+  if (summaryMode == data::SummaryMode::Sorted && keyCount < kMaxTableSizeToSort &&
+      static_cast<uint32_t>(keyCount) <= maxKeysToSort)
+  {
+    keysRead += static_cast<uint32_t>(keyCount);
     using KeyToTableIter = std::pair<std::string, SQInteger>;
     std::vector<KeyToTableIter> tableKeyToIterator;
     SQInteger sqIter = 0;
     sq_pushinteger(v, sqIter);
     for (SQInteger i = 0; SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2)); ++i) {
       sq_poptop(v);// don't need the value.
-      tableKeyToIterator.emplace_back(KeyToTableIter{ToString(v, -1), sqIter});
+      tableKeyToIterator.emplace_back(KeyToTableIter{ToSummaryFieldString(v, -1), sqIter});
       sq_poptop(v);// pop key before next iteration
     }
     sq_poptop(v);
@@ -163,21 +189,29 @@ void CreateTableSummary(HSQUIRRELVM v, std::stringstream& ss)
         sq_poptop(v);// pop iterator
         break;
       }
+      ++keysRead;
       ss << WriteTableSummaryFieldHelper(v, ss.tellp() == initialSummarySize);
       sq_poptop(v);// pop iterator
     }
   }
   else {
-    // Render summary of first few elements
+    // Render summary of first few elements, in iteration order
+    const auto initialSummarySize = ss.tellp();
     sq_pushinteger(v, 0);
-    for (SQInteger i = 0; ss.tellp() < kMaxTableValueStringLength && SQ_SUCCEEDED(sq_next(v, -2)); ++i) {
-      ss << WriteTableSummaryFieldHelper(v, i == 0);
+    for (SQInteger i = 0; ss.tellp() - initialSummarySize < kMaxTableValueStringLength &&
+                          (summaryMode != data::SummaryMode::FirstFields || i < maxFieldCount) &&
+                          SQ_SUCCEEDED(sq_next(v, -2));
+         ++i)
+    {
+      ++keysRead;
+      ss << WriteTableSummaryFieldHelper(v, ss.tellp() == initialSummarySize);
     }
     sq_poptop(v);
   }
 
   ss << "}";
-};
+  return keysRead;
+}
 
 ReturnCode UpdateFromString(SQVM* const v, SQInteger objIdx, const std::string& value)
 {
@@ -246,41 +280,52 @@ ReturnCode UpdateFromString(SQVM* const v, SQInteger objIdx, const std::string&
 // Simple to_string of the var at the top of the stack.
 std::string ToString(SQVM* const v, const SQInteger idx)
 {
-  std::stringstream ss;
+  // Scalars are formatted without a stringstream, as they make up most of the keys and values in a large page. Short
+  // results fit in the small string buffer, so don't allocate at all. Output matches what the stringstream would give.
   const auto type = sq_gettype(v, idx);
   switch (type) {
     case OT_BOOL:
     {
       SQBool val = SQFalse;
       if (SQ_SUCCEEDED(sq_getbool(v, idx, &val))) {
-        ss << (val == SQTrue ? "true" : "false");
+        return val == SQTrue ? "true" : "false";
       }
-      break;
+      return {};
     }
     case OT_INTEGER:
     {
       SQInteger val = 0;
       if (SQ_SUCCEEDED(sq_getinteger(v, idx, &val))) {
-        ss << val;
+        std::array<char, 24> buffer = {};
+        const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), val);
+        return std::string(buffer.data(), result.ptr);
       }
-      break;
+      return {};
     }
     case OT_FLOAT:
     {
       SQFloat val = 0.0F;
       if (SQ_SUCCEEDED(sq_getfloat(v, idx, &val))) {
-        ss << val;
+        std::array<char, 32> buffer = {};
+        const auto len = std::snprintf(buffer.data(), buffer.size(), "%g", static_cast<double>(val));
+        return std::string(buffer.data(), static_cast<size_t>(std::max(len, 0)));
       }
-      break;
+      return {};
     }
     case OT_STRING:
     {
       const ::SQChar* val = nullptr;
       if (SQ_SUCCEEDED(sq_getstring(v, idx, &val))) {
-        ss << val;
+        return val;
       }
-      break;
+      return {};
     }
+    default:
+      break;
+  }
+
+  std::stringstream ss;
+  switch (type) {
     case OT_CLOSURE:
     {
       if (SQ_SUCCEEDED(sq_getclosurename(v, idx))) {
@@ -320,7 +365,7 @@ std::string ToString(SQVM* const v, const SQInteger idx)
     case OT_INSTANCE:
     case OT_TABLE:
     {
-      CreateTableSummary(v, ss);
+      CreateTableSummary(v, data::SummaryMode::Sorted, 0U, kMaxTableSizeToSort, ss);
     } break;
     default:
       ss << ToSqObjectTypeName(type);
@@ -329,9 +374,9 @@ std::string ToString(SQVM* const v, const SQInteger idx)
   return ss.str();
 }
 
-ReturnCode CreateChildVariable(SQVM* const v, Variable& variable)
+// Populates everything except for variable.value
+void CreateChildVariableDetails(SQVM* const v, Variable& variable)
 {
-  std::stringstream ss;
   const auto topIdx = sq_gettop(v);
   const auto type = sq_gettype(v, topIdx);
 
@@ -344,7 +389,6 @@ ReturnCode CreateChildVariable(SQVM* const v, Variable& variable)
   }
 
   variable.valueType = ToVariableType(sq_gettype(v, -1));
-  variable.value = ToString(v, -1);
 
   switch (variable.valueType) {
     case VariableType::Instance:
@@ -397,46 +441,318 @@ ReturnCode CreateChildVariable(SQVM* const v, Variable& variable)
   else {
     variable.editable = false;
   }
+}
 
+ReturnCode CreateChildVariable(SQVM* const v, Variable& variable)
+{
+  variable.value = ToString(v, -1);
+  CreateChildVariableDetails(v, variable);
   return ReturnCode::Success;
 }
 
-ReturnCode CreateChildVariables(SQVM* const v, const PaginationInfo& pagination, std::vector<Variable>& variables)
+ReturnCode CreateChildVariable(SQVM* const v, VariableQueryContext& context, Variable& variable)
 {
-  const auto createTableChildVariableFromIter = [vm = v](Variable& variable) -> ReturnCode {
-    const auto retVal = CreateChildVariable(vm, variable);
+  const auto type = sq_gettype(v, -1);
+  if (type != OT_TABLE && type != OT_INSTANCE) {
+    variable.value = ToString(v, -1);
+  }
+  else if (context.options.summaryMode != data::SummaryMode::None && context.summaryBytesRemaining > 0U) {
+    std::stringstream ss;
+    const auto keysRead = CreateTableSummary(
+            v, context.options.summaryMode, context.options.summaryFieldCount,
+            context.summaryBytesRemaining / kSummaryBytesPerKeyRead, ss);
+    variable.value = ss.str();
+    const auto cost = static_cast<uint64_t>(variable.value.size()) + uint64_t{keysRead} * kSummaryBytesPerKeyRead;
+    context.summaryBytesRemaining -=
+            static_cast<uint32_t>(std::min(uint64_t{context.summaryBytesRemaining}, cost));
+  }
+
+  CreateChildVariableDetails(v, variable);
+  return ReturnCode::Success;
+}
+
+namespace {
+bool EqualsIgnoreCase(const char lhs, const char rhs)
+{
+  return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs));
+}
+
+// Matches the whole of str against a pattern containing * and ? wildcards.
+bool GlobMatchIgnoreCase(const std::string_view str, const std::string_view pattern)
+{
+  size_t strPos = 0;
+  size_t patternPos = 0;
+  // Position to resume from when a match after the last * fails
+  size_t starPatternPos = std::string_view::npos;
+  size_t starStrPos = 0;
+  while (strPos < str.size()) {
+    if (patternPos < pattern.size() &&
+        (pattern[patternPos] == '?' || EqualsIgnoreCase(pattern[patternPos], str[strPos])))
+    {
+      ++strPos;
+      ++patternPos;
+    }
+    else if (patternPos < pattern.size() && pattern[patternPos] == '*') {
+      starPatternPos = patternPos++;
+      starStrPos = strPos;
+    }
+    else if (starPatternPos != std::string_view::npos) {
+      patternPos = starPatternPos + 1;
+      strPos = ++starStrPos;
+    }
+    else {
+      return false;
+    }
+  }
+  while (patternPos < pattern.size() && pattern[patternPos] == '*') {
+    ++patternPos;
+  }
+  return patternPos == pattern.size();
+}
+
+bool ContainsIgnoreCase(const std::string_view str, const std::string_view substr)
+{
+  return std::search(str.begin(), str.end(), substr.begin(), substr.end(), EqualsIgnoreCase) != str.end();
+}
+
+template<typename T>
+bool CompareWithOperator(const data::FilterOperator op, const T& lhs, const T& rhs)
+{
+  switch (op) {
+    case data::FilterOperator::Equal:
+      return lhs == rhs;
+    case data::FilterOperator::NotEqual:
+      return lhs != rhs;
+    case data::FilterOperator::Less:
+      return lhs < rhs;
+    case data::FilterOperator::Greater:
+      return lhs > rhs;
+    default:
+      return false;
+  }
+}
+}// namespace
+
+ChildFilter::ChildFilter(const data::VariableFilter& filter)
+    : keyPattern_(filter.keyPattern)
+    , keyPatternIsGlob_(filter.keyPattern.find_first_of("*?") != std::string::npos)
+    , valueOperator_(filter.valueOperator)
+    , value_(filter.value)
+{
+  for (const auto valueType : filter.valueTypes) {
+    valueTypeMask_ |= 1U << static_cast<uint32_t>(valueType);
+  }
+
+  if (valueOperator_ != data::FilterOperator::None && valueOperator_ != data::FilterOperator::Contains) {
+    const char* const begin = value_.c_str();
+    char* end = nullptr;
+    valueNumber_ = std::strtod(begin, &end);
+    valueIsNumber_ = !value_.empty() && end == begin + value_.size();
+  }
+
+  // The value is length prefixed, so that it can't run into the key pattern.
+  cacheKey_ = std::to_string(valueTypeMask_) + ':' + std::to_string(static_cast<int>(valueOperator_)) + ':' +
+              std::to_string(value_.size()) + ':' + value_ + keyPattern_;
+}
+
+bool ChildFilter::IsEmpty() const
+{
+  return keyPattern_.empty() && valueTypeMask_ == 0 && valueOperator_ == data::FilterOperator::None;
+}
+
+bool ChildFilter::Matches(HSQUIRRELVM v) const
+{
+  if (valueTypeMask_ != 0 && (valueTypeMask_ & (1U << static_cast<uint32_t>(ToVariableType(sq_gettype(v, -1))))) == 0)
+  {
+    return false;
+  }
+  return MatchesValue(v) && MatchesKey(v);
+}
+
+bool ChildFilter::MatchesKey(HSQUIRRELVM v) const
+{
+  if (keyPattern_.empty()) {
+    return true;
+  }
+
+  // Read string and integer keys in place, so that no string is allocated for keys that don't match.
+  switch (sq_gettype(v, -2)) {
+    case OT_STRING:
+    {
+      const SQChar* key = nullptr;
+      SQInteger keyLength = 0;
+      if (!SQ_SUCCEEDED(sq_getstringandsize(v, -2, &key, &keyLength))) {
+        return false;
+      }
+      return MatchesKeyPattern(std::string_view(key, static_cast<size_t>(keyLength)));
+    }
+    case OT_INTEGER:
+    {
+      SQInteger key = 0;
+      if (!SQ_SUCCEEDED(sq_getinteger(v, -2, &key))) {
+        return false;
+      }
+      std::array<char, 24> buffer = {};
+      const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), key);
+      return MatchesKeyPattern(std::string_view(buffer.data(), static_cast<size_t>(result.ptr - buffer.data())));
+    }
+    default:
+      return MatchesKeyPattern(ToString(v, -2));
+  }
+}
+
+bool ChildFilter::MatchesKeyPattern(const std::string_view key) const
+{
+  if (keyPatternIsGlob_) {
+    return GlobMatchIgnoreCase(key, keyPattern_);
+  }
+  return ContainsIgnoreCase(key, keyPattern_);
+}
+
+bool ChildFilter::MatchesValue(HSQUIRRELVM v) const
+{
+  if (valueOperator_ == data::FilterOperator::None) {
+    return true;
+  }
+
+  // Values that can't be compared with the filter value only match NotEqual
+  const bool incomparable = valueOperator_ == data::FilterOperator::NotEqual;
+  HSQOBJECT obj = {};
+  sq_getstackobj(v, -1, &obj);
+  switch (obj._type) {
+    case OT_INTEGER:
+    case OT_FLOAT:
+    {
+      if (!valueIsNumber_) {
+        return incomparable;
+      }
+      const auto number = obj._type == OT_INTEGER ? static_cast<double>(obj._unVal.nInteger)
+                                                  : static_cast<double>(obj._unVal.fFloat);
+      return CompareWithOperator(valueOperator_, number, valueNumber_);
+    }
+    case OT_BOOL:
+    {
+      SQBool val = SQFalse;
+      sq_getbool(v, -1, &val);
+      return CompareWithOperator(valueOperator_, std::string_view(val == SQTrue ? "true" : "false"),
+                                 std::string_view(value_));
+    }
+    case OT_STRING:
+    {
+      const SQChar* str = nullptr;
+      SQInteger strLength = 0;
+      if (!SQ_SUCCEEDED(sq_getstringandsize(v, -1, &str, &strLength))) {
+        return false;
+      }
+      const auto strView = std::string_view(str, static_cast<size_t>(strLength));
+      if (valueOperator_ == data::FilterOperator::Contains) {
+        return ContainsIgnoreCase(strView, value_);
+      }
+      return CompareWithOperator(valueOperator_, strView, std::string_view(value_));
+    }
+    default:
+      return incomparable;
+  }
+}
+
+// Expects a table or instance at the top of the stack. Fills keys with those of its children that match the filter, if
+// given, sorted by their string form.
+void ReadSortedKeys(HSQUIRRELVM v, const ChildFilter* filter, SortedKeysCache::SortedKeys& keys)
+{
+  keys.clear();
+  SQInteger sqIter = 0;
+  sq_pushinteger(v, sqIter);
+  while (SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2))) {
+    if (filter != nullptr && !filter->Matches(v)) {
+      sq_pop(v, 2);// pop key and value
+      continue;
+    }
+    sq_poptop(v);// don't need the value.
+    keys.emplace_back(ToString(v, -1), sqIter);
+    sq_poptop(v);// pop key before next iteration
+  }
+  sq_poptop(v);
+  std::sort(keys.begin(), keys.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+}
+
+ReturnCode CreateChildVariables(
+        SQVM* const v, const PaginationInfo& pagination, VariableQueryContext& context, const uint32_t depth,
+        const int32_t parentIndex, std::vector<Variable>& variables)
+{
+  // Expects 2 things to be on the stack. -1=value, -2=key. Will pop both from the stack.
+  const auto createTableChildVariableFromIter = [vm = v, &context, depth, parentIndex, &variables](
+                                                        const SQInteger sqIter) -> ReturnCode {
+    Variable variable;
+    variable.pathIterator = sqIter;
+    variable.parentIndex = parentIndex;
+    const auto retVal = CreateChildVariable(vm, context, variable);
     if (ReturnCode::Success != retVal) {
       sq_pop(vm, 2);
       return retVal;
     }
 
+    // Add the variable before expanding it, so that the list is in pre-order.
+    --context.nodesRemaining;
+    variables.emplace_back(std::move(variable));
+    const auto variableIndex = variables.size() - 1;
+    ExpandChildVariable(vm, context, depth + 1, variableIndex, variables);
+
     sq_poptop(vm);// pop val, so we can get the key
-    variable.pathUiString = ToString(vm, -1);
-    variable.pathTableKeyType = ToVariableType(sq_gettype(vm, -1));
+    variables[variableIndex].pathUiString = ToString(vm, -1);
+    variables[variableIndex].pathTableKeyType = ToVariableType(sq_gettype(vm, -1));
     sq_poptop(vm);// pop key before next iteration
 
     return ReturnCode::Success;
   };
 
+  // Only the direct children of the requested path are filtered. Children that don't match are skipped without
+  // counting towards pagination.count.
+  const bool filtered = depth == 0U && !context.filter.IsEmpty();
+
+  // Expects the iterator to be at the top of the stack, after the last child of the page was read. If there are more
+  // children of the requested path, records the iterator so that the next page resumes from it.
+  const auto recordNextPage = [v, &context, depth]() {
+    SQInteger nextIter = 0;
+    if (depth != 0U || !SQ_SUCCEEDED(sq_getinteger(v, -1, &nextIter))) {
+      return;
+    }
+    // sq_next skips unused slots, so peek to check that there is something after this one.
+    if (SQ_SUCCEEDED(sq_next(v, -2))) {
+      sq_pop(v, 2);// pop key and value
+      context.nextPosition = static_cast<uint32_t>(nextIter);
+    }
+  };
+
   switch (sq_gettype(v, -1)) {
     case OT_ARRAY:
     {
       SQInteger sqIter = pagination.beginIterator;
       sq_pushinteger(v, sqIter);
-      for (SQInteger i = 0;
-           i < pagination.count && SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2)); ++i)
+      for (SQInteger i = 0; i < pagination.count && context.nodesRemaining > 0 &&
+                            SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2));)
       {
+        if (filtered && !context.filter.Matches(v)) {
+          sq_pop(v, 2);// pop key and value
+          continue;
+        }
+        ++i;
+
         Variable childVar = {};
+        childVar.pathIterator = sqIter;
+        childVar.parentIndex = parentIndex;
+
+        CreateChildVariable(v, context, childVar);
 
-        CreateChildVariable(v, childVar);
+        --context.nodesRemaining;
+        variables.emplace_back(std::move(childVar));
+        const auto variableIndex = variables.size() - 1;
+        ExpandChildVariable(v, context, depth + 1, variableIndex, variables);
 
         sq_poptop(v);// pop val, so we can get the key
-        childVar.pathIterator = sqIter;
-        childVar.pathUiString = ToString(v, -1);
+        variables[variableIndex].pathUiString = ToString(v, -1);
         sq_poptop(v);// pop key before next iteration
-
-        variables.emplace_back(std::move(childVar));
       }
+      recordNextPage();
       sq_poptop(v);
     } break;
     case OT_INSTANCE:
@@ -447,55 +763,61 @@ ReturnCode CreateChildVariables(SQVM* const v, const PaginationInfo& pagination,
       // If there aren't a large number of keys; get everything and perform a sort.
       const auto keyCount = sq_getsize(v, -1);
       if (keyCount < kMaxTableSizeToSort) {
-        using KeyToTableIter = std::pair<std::string, SQInteger>;
-        std::vector<KeyToTableIter> tableKeyToIterator;
-        SQInteger sqIter = 0;
-        sq_pushinteger(v, sqIter);
-        for (SQInteger i = 0; SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2)); ++i) {
-          sq_poptop(v);// don't need the value.
-          tableKeyToIterator.emplace_back(KeyToTableIter{ToString(v, -1), sqIter});
-          sq_poptop(v);// pop key before next iteration
+        const auto* const filter = filtered ? &context.filter : nullptr;
+        std::shared_ptr<const SortedKeysCache::SortedKeys> sortedKeys;
+        if (context.sortedKeys != nullptr) {
+          sortedKeys = context.sortedKeys->GetKeys(v, filter);
         }
-        sq_poptop(v);
-        std::sort(
-                tableKeyToIterator.begin(), tableKeyToIterator.end(),
-                [](const KeyToTableIter& lhs, const KeyToTableIter& rhs) -> bool { return lhs.first < rhs.first; });
+        else {
+          auto uncachedKeys = std::make_shared<SortedKeysCache::SortedKeys>();
+          ReadSortedKeys(v, filter, *uncachedKeys);
+          sortedKeys = std::move(uncachedKeys);
+        }
+        const auto& tableKeyToIterator = *sortedKeys;
 
         // Now add children
-        auto childKeyIter = tableKeyToIterator.begin() + pagination.beginIterator;
-        for (uint32_t i = 0U; i < pagination.count && childKeyIter != tableKeyToIterator.end(); ++i, ++childKeyIter) {
+        auto childKeyIter = tableKeyToIterator.begin() +
+                            std::min<size_t>(pagination.beginIterator, tableKeyToIterator.size());
+        for (uint32_t i = 0U; i < pagination.count && context.nodesRemaining > 0 &&
+                              childKeyIter != tableKeyToIterator.end();
+             ++i, ++childKeyIter)
+        {
           sq_pushinteger(v, childKeyIter->second);
           if (!SQ_SUCCEEDED(sq_next(v, -2))) {
             sq_poptop(v);// pop iterator
             break;
           }
-          Variable variable;
-          variable.pathIterator = childKeyIter->second;
-          const auto retVal = createTableChildVariableFromIter(variable);
+          const auto retVal = createTableChildVariableFromIter(childKeyIter->second);
           if (ReturnCode::Success != retVal) {
             sq_poptop(v);// pop iterator
             return retVal;
           }
-          variables.emplace_back(std::move(variable));
           sq_poptop(v);// pop iterator
         }
+        if (depth == 0U && childKeyIter != tableKeyToIterator.end()) {
+          context.nextPosition = static_cast<uint32_t>(childKeyIter - tableKeyToIterator.begin());
+        }
       }
       else {
         // Now add children
         sq_pushinteger(v, pagination.beginIterator);
         SQInteger sqIter = 0;
-        for (SQInteger i = 0;
-             i < pagination.count && SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2)); ++i)
+        for (SQInteger i = 0; i < pagination.count && context.nodesRemaining > 0 &&
+                              SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2));)
         {
-          Variable variable;
-          variable.pathIterator = sqIter;
-          const auto retVal = createTableChildVariableFromIter(variable);
+          if (filtered && !context.filter.Matches(v)) {
+            sq_pop(v, 2);// pop key and value
+            continue;
+          }
+          ++i;
+
+          const auto retVal = createTableChildVariableFromIter(sqIter);
           if (ReturnCode::Success != retVal) {
             sq_poptop(v);// pop iterator
             return retVal;
           }
-          variables.emplace_back(std::move(variable));
         }
+        recordNextPage();
         // pop iterator
         sq_poptop(v);
       }
@@ -506,15 +828,106 @@ ReturnCode CreateChildVariables(SQVM* const v, const PaginationInfo& pagination,
   return ReturnCode::Success;
 }
 
+void ExpandChildVariable(
+        SQVM* const v, VariableQueryContext& context, const uint32_t depth, const size_t parentIndex,
+        std::vector<Variable>& variables)
+{
+  if (depth > context.options.expandDepth || context.nodesRemaining == 0) {
+    return;
+  }
+
+  const auto& parent = variables[parentIndex];
+  if (parent.childCount == 0 || parent.valueRawAddress == 0) {
+    return;
+  }
+  switch (parent.valueType) {
+    case VariableType::Array:
+    case VariableType::Table:
+    case VariableType::Instance:
+      break;
+    default:
+      return;
+  }
+
+  // Only expand each container once per request; this catches both cycles and shared references.
+  if (!context.expandedAddresses.insert(parent.valueRawAddress).second) {
+    return;
+  }
+
+  const PaginationInfo childPagination = {0U, context.nestedPageSize};
+  CreateChildVariables(v, childPagination, context, depth, static_cast<int32_t>(parentIndex), variables);
+}
+
 data::ReturnCode CreateChildVariablesFromIterable(
         HSQUIRRELVM vm, PathPartConstIter begin, PathPartConstIter end,
-        const data::PaginationInfo& pagination, std::vector<data::Variable>& variables)
+        const data::PaginationInfo& pagination, VariableQueryContext& context, std::vector<data::Variable>& variables)
 {
-  return WithVariableAtPath(vm, begin, end, [vm, &pagination, &variables]() {
-    return CreateChildVariables(vm, pagination, variables);
+  return WithVariableAtPath(vm, begin, end, [vm, &pagination, &context, &variables]() {
+    // Nested expansion may add more, but this covers the common case of a flat page in a single allocation.
+    variables.reserve(variables.size() + std::min(pagination.count, context.nodesRemaining));
+
+    HSQOBJECT rootObj = {};
+    if (ISREFCOUNTED(sq_gettype(vm, -1)) && SQ_SUCCEEDED(sq_getstackobj(vm, -1, &rootObj))) {
+      context.expandedAddresses.insert(rootObj._unVal.raw);
+    }
+    return CreateChildVariables(vm, pagination, context, 0U, -1, variables);
   });
 }
 
+ReturnCode ReadNumericArray(
+        SQVM* const v, const PaginationInfo& range, uint32_t& arraySize, NumericArrayValues& values)
+{
+  ScopedVerifySqTop scopedVerify(v);
+
+  if (sq_gettype(v, -1) != OT_ARRAY) {
+    SDB_LOGD(kLogTag, "ReadNumericArray: Value is not an array");
+    return ReturnCode::InvalidParameter;
+  }
+  arraySize = static_cast<uint32_t>(sq_getsize(v, -1));
+
+  const auto endIndex = std::min<uint64_t>(arraySize, static_cast<uint64_t>(range.beginIterator) + range.count);
+  if (range.beginIterator < endIndex) {
+    values.integers.reserve(endIndex - range.beginIterator);
+  }
+
+  // Walk the array with sq_next, and read each value straight out of the object rather than via the typed getters.
+  sq_pushinteger(v, range.beginIterator);
+  for (auto i = static_cast<uint64_t>(range.beginIterator); i < endIndex && SQ_SUCCEEDED(sq_next(v, -2)); ++i) {
+    HSQOBJECT obj = {};
+    sq_getstackobj(v, -1, &obj);
+    sq_pop(v, 2);// pop key and value
+
+    if (obj._type == OT_INTEGER) {
+      if (values.isFloat) {
+        values.floats.push_back(static_cast<SQFloat>(obj._unVal.nInteger));
+      }
+      else {
+        values.integers.push_back(obj._unVal.nInteger);
+      }
+    }
+    else if (obj._type == OT_FLOAT) {
+      if (!values.isFloat) {
+        // First float in the array; convert everything read so far.
+        values.isFloat = true;
+        values.floats.reserve(values.integers.capacity());
+        for (const auto integer : values.integers) {
+          values.floats.push_back(static_cast<SQFloat>(integer));
+        }
+        values.integers = {};
+      }
+      values.floats.push_back(obj._unVal.fFloat);
+    }
+    else {
+      SDB_LOGD(kLogTag, "ReadNumericArray: Array element %" PRIu64 " is not numeric", i);
+      sq_poptop(v);// pop iterator
+      return ReturnCode::InvalidParameter;
+    }
+  }
+  sq_poptop(v);// pop iterator
+
+  return ReturnCode::Success;
+}
+
 ReturnCode WithVariableAtPath(
         SQVM* const v, const PathPartConstIter pathBegin,
         const PathPartConstIter pathEnd, const std::function<ReturnCode()>& fn)
@@ -569,83 +982,131 @@ ReturnCode WithVariableAtPath(
   }
 }
 
-ReturnCode GetObjectFromExpression(
-        SQVM* const v, const SqExpressionNode* expressionNode, const PaginationInfo& pagination, HSQOBJECT& foundObject,
-        std::vector<uint32_t>& iteratorPath)
+ReturnCode KeyIteratorIndex::PushValue(HSQUIRRELVM v, const HSQOBJECT& key, uint32_t& iterator)
 {
-  ScopedVerifySqTop scopedVerify(v);
-
-  if (expressionNode == nullptr) {
-    // Add the variable at the top of the stack to the list.
-    if (!SQ_SUCCEEDED(sq_getstackobj(v, -1, &foundObject))) {
-      SDB_LOGD(kLogTag, "Failed to read object from the stack");
-      return ReturnCode::ErrorInternal;
+  HSQOBJECT container;
+  sq_getstackobj(v, -1, &container);
+  const ObjectId containerId = {sq_type(container), container._unVal.raw};
+  const ObjectId keyId = {sq_type(key), key._unVal.raw};
+
+  auto containerPos = containers_.find(containerId);
+  if (containerPos != containers_.end()) {
+    const auto keyPos = containerPos->second.find(keyId);
+    if (keyPos != containerPos->second.end() && PushValueAtIterator(v, keyId, keyPos->second)) {
+      iterator = keyPos->second;
+      return ReturnCode::Success;
     }
-    return ReturnCode::Success;
   }
 
-  std::stringstream ss;
+  // Either the container hasn't been indexed yet, or its index is stale. Make sure the key exists before rebuilding.
+  sq_pushobject(v, key);
+  if (!SQ_SUCCEEDED(sq_get(v, -2))) {
+    return ReturnCode::InvalidParameter;
+  }
+  sq_poptop(v);
+
+  auto& index = containers_[containerId];
+  index.clear();
+  SQInteger sqIter = 0;
+  sq_pushinteger(v, sqIter);
+  HSQOBJECT iterKey;
+  while (SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -2))) {
+    sq_getstackobj(v, -2, &iterKey);
+    index.emplace(ObjectId{sq_type(iterKey), iterKey._unVal.raw}, static_cast<uint32_t>(sqIter));
+    sq_pop(v, 2);// pop value and key
+  }
+  sq_poptop(v);// pop null iterator
 
-  // Push the indexed child on to the stack
-  const auto type = sq_gettype(v, -1);
-  switch (type) {
-    case OT_ARRAY:
-    {
-      if (!sq_isnumeric(expressionNode->accessorObject)) {
-        SDB_LOGD(kLogTag, "Failed to get from array, key is not numeric.");
-        return ReturnCode::InvalidParameter;
-      }
+  const auto keyPos = index.find(keyId);
+  if (keyPos == index.end() || !PushValueAtIterator(v, keyId, keyPos->second)) {
+    return ReturnCode::InvalidParameter;
+  }
+  iterator = keyPos->second;
+  return ReturnCode::Success;
+}
 
-      sq_pushobject(v, expressionNode->accessorObject);
-      SQInteger arrIndex;
-      sq_getinteger(v, -1, &arrIndex);
-      const auto sqRetVal = sq_get(v, -2);
-      if (!SQ_SUCCEEDED(sqRetVal)) {
-        SDB_LOGD(kLogTag, "Failed to get array index %d", arrIndex);
-        return ReturnCode::InvalidParameter;
-      }
+void KeyIteratorIndex::Clear()
+{
+  containers_.clear();
+}
 
-      iteratorPath.push_back(static_cast<uint32_t>(arrIndex));
-      const auto childRetVal =
-              GetObjectFromExpression(v, expressionNode->next.get(), pagination, foundObject, iteratorPath);
-      sq_poptop(v);// pop value
-      return childRetVal;
+bool KeyIteratorIndex::PushValueAtIterator(HSQUIRRELVM v, const ObjectId& key, const uint32_t iterator)
+{
+  sq_pushinteger(v, static_cast<SQInteger>(iterator));
+  if (SQ_SUCCEEDED(sq_next(v, -2))) {
+    HSQOBJECT iterKey;
+    sq_getstackobj(v, -2, &iterKey);
+    if (sq_type(iterKey) == key.type && iterKey._unVal.raw == key.raw) {
+      sq_remove(v, -2);// remove key
+      sq_remove(v, -2);// remove iterator
+      return true;
     }
-    case OT_TABLE:
-    case OT_INSTANCE:
-    {
-      // Get the object that we're looking for, so we can iterate through all keys to find the iterator we want.
-      sq_pushobject(v, expressionNode->accessorObject);
-      if (!SQ_SUCCEEDED(sq_get(v, -2))) {
-        SDB_LOGD(kLogTag, "Failed to read accessor");
-        return ReturnCode::InvalidParameter;
-      }
+    sq_pop(v, 2);// pop value and key
+  }
+  sq_poptop(v);// pop iterator
+  return false;
+}
 
-      SQInteger sqIter = 0;
-      sq_pushinteger(v, sqIter);
-      HSQOBJECT iterKey;
-      while (SQ_SUCCEEDED(sq_getinteger(v, -1, &sqIter)) && SQ_SUCCEEDED(sq_next(v, -3))) {
-        sq_getstackobj(v, -2, &iterKey);
-        if (iterKey._unVal.raw == expressionNode->accessorObject._unVal.raw) {
-          iteratorPath.push_back(static_cast<uint32_t>(sqIter));
-          const auto childRetVal =
-                  GetObjectFromExpression(v, expressionNode->next.get(), pagination, foundObject, iteratorPath);
-          sq_pop(v, 4);// pop value, key, null iterator, initially found value
-          return childRetVal;
-        }
-        sq_pop(v, 2);// pop value and key
-      }
-      sq_poptop(v);// pop null iterator
-      sq_poptop(v);// pop initially found value
+const StackLocals& StackLocalsCache::GetFrame(HSQUIRRELVM v, const uint32_t stackFrame)
+{
+  auto [framePos, inserted] = frames_.try_emplace(stackFrame);
+  auto& frame = framePos->second;
+  if (!inserted) {
+    return frame;
+  }
 
-      // Didn't find anything
-      SDB_LOGD(kLogTag, "No matching key in table");
-      return ReturnCode::InvalidParameter;
+  for (SQUnsignedInteger nSeq = 0;; ++nSeq) {
+    const auto* const localName = sq_getlocal(v, stackFrame, nSeq);
+    if (localName == nullptr) {
+      break;
     }
-    default:
-      SDB_LOGD(kLogTag, "Iterator points to non iterable type: %d", type);
-      return ReturnCode::InvalidParameter;
+    auto& local = frame.locals.emplace_back();
+    local.name = localName;
+    sq_getstackobj(v, -1, &local.value);
+    sq_poptop(v);// pop local variable
+  }
+
+  // Names are only referenced once locals has stopped growing.
+  frame.indexByName.reserve(frame.locals.size());
+  for (uint32_t nSeq = 0; nSeq < frame.locals.size(); ++nSeq) {
+    frame.indexByName.emplace(frame.locals[nSeq].name, nSeq);
   }
+  return frame;
+}
+
+void StackLocalsCache::Clear()
+{
+  frames_.clear();
+}
+
+std::shared_ptr<const SortedKeysCache::SortedKeys> SortedKeysCache::GetKeys(HSQUIRRELVM v, const ChildFilter* filter)
+{
+  HSQOBJECT container;
+  sq_getstackobj(v, -1, &container);
+  static const std::string kUnfilteredKey;
+  const auto& filterKey = filter != nullptr ? filter->GetCacheKey() : kUnfilteredKey;
+
+  auto& byFilter = containers_[{sq_type(container), container._unVal.raw}];
+  const auto keysPos = byFilter.find(filterKey);
+  if (keysPos != byFilter.end()) {
+    return keysPos->second;
+  }
+
+  auto keys = std::make_shared<SortedKeys>();
+  ReadSortedKeys(v, filter, *keys);
+  if (keyCount_ + keys->size() > kMaxKeyCount) {
+    containers_.clear();
+    keyCount_ = 0;
+  }
+  keyCount_ += keys->size();
+  containers_[{sq_type(container), container._unVal.raw}].emplace(filterKey, keys);
+  return keys;
+}
+
+void SortedKeysCache::Clear()
+{
+  containers_.clear();
+  keyCount_ = 0;
 }
 
 std::string ToClassFullName(SQVM* const v, const SQInteger idx)
@@ -708,243 +1169,4 @@ std::string ToClassFullName(SQVM* const v, const SQInteger idx)
   throw std::runtime_error("Unknown class");
 }
 
-
-std::string ReadString(std::string::const_iterator& pos, std::string::const_iterator end)
-{
-  const char enclosingChar = *(pos++);
-  const char* eofError =
-          enclosingChar == '\'' ? "Encountered EOF when looking for '" : "Encountered EOF when looking for \"";
-
-  const auto processStringEscape = [&](std::string& dest, const int maxDigits) {
-    char c = *(++pos);
-    if (pos == end) {
-      throw WatchParseError(eofError, pos);
-    }
-    if (0 == isxdigit(c)) {
-      throw WatchParseError("hexadecimal number expected", pos);
-    }
-    int n = 0;
-    while (0 != isxdigit(c) && n < maxDigits) {
-      dest[n] = c;
-      ++n;
-      c = *(++pos);
-      if (pos == end) {
-        throw WatchParseError(eofError, pos);
-      }
-    }
-  };
-
-  std::string output;
-  for (; pos != end; ++pos) {
-    switch (char c = *pos; c) {
-      case '\\':
-        c = *(++pos);
-        if (pos == end) {
-          throw WatchParseError(eofError, pos);
-        }
-        switch (c) {
-          case 't':
-            output += '\t';
-            break;
-          case 'a':
-            output += '\a';
-            break;
-          case 'b':
-            output += '\b';
-            break;
-          case 'n':
-            output += '\n';
-            break;
-          case 'r':
-            output += '\r';
-            break;
-          case 'v':
-            output += '\v';
-            break;
-          case 'f':
-            output += '\f';
-            break;
-          case '0':
-            output += '\0';
-            break;
-          case '\\':
-          case '"':
-          case '\'':
-            output += c;
-            break;
-          case 'x':
-          {
-            const size_t maxDigits = sizeof(SQChar) * 2;
-            std::string temp(maxDigits, '0');
-            processStringEscape(temp, maxDigits);
-            char* stemp;
-            output += static_cast<SQChar>(scstrtoul(temp.c_str(), &stemp, 16));
-            break;
-          }
-          case 'u':
-          case 'U':
-          {
-            const size_t maxDigits = c == 'u' ? 4 : 8;
-            std::string temp(maxDigits, '0');
-            processStringEscape(temp, 8);
-            char* stemp;
-#ifdef SQUNICODE
-#if WCHAR_SIZE == 2
-#error not implemented
-#else
-#error not implemented
-#endif
-#else
-            output += static_cast<SQChar>(scstrtoul(temp.c_str(), &stemp, 16));
-#endif
-            break;
-          }
-          default:
-            throw WatchParseError("unknown escape character", pos);
-        }
-        break;
-      case '"':
-      case '\'':
-        if (c == enclosingChar) {
-          ++pos;
-          return output;
-        }
-        output += c;
-        break;
-      case '\n':
-        throw WatchParseError("newline in an inline string", pos);
-      default:
-        output += c;
-    }
-  }
-
-  return output;
-}
-
-std::string ReadNumber(std::string::const_iterator& pos, const std::string::const_iterator end)
-{
-  const auto first = pos;
-  for (; pos != end; ++pos) {
-    const char c = *pos;
-    if (0 == isdigit(c)) {
-      break;
-    }
-  }
-
-  return std::string(first, pos);
-}
-
-std::string ReadIdentifier(std::string::const_iterator& pos, const std::string::const_iterator end)
-{
-  const auto first = pos;
-  for (; pos != end; ++pos) {
-    const char c = *pos;
-    if (0 == isalnum(c) && c != '_') {
-      break;
-    }
-  }
-
-  return std::string(first, pos);
-}
-
-std::unique_ptr<ExpressionNode> ParseExpression(std::string::const_iterator& pos, const std::string::const_iterator end)
-{
-  auto rootExpression = std::make_unique<ExpressionNode>();
-  auto currentExpression = rootExpression.get();
-  for (; pos != end;) {
-    switch (const char c = *pos; c) {
-      case ' ':
-        ++pos;
-        break;
-      case '.':
-      {
-        if (currentExpression->type != ExpressionNodeType::Identifier) {
-          throw WatchParseError("Attempted to access field of a non-identifier", pos);
-        }
-
-        currentExpression->next = std::make_unique<ExpressionNode>();
-        currentExpression = currentExpression->next.get();
-        ++pos;
-
-        // Peek at the next character to make sure it's a valid identifier character
-        if (pos == end) {
-          throw WatchParseError("Expected identifier character after . but got EOF", pos);
-        }
-
-        if (0 == isalpha(*pos) && *pos != '_') {
-          throw WatchParseError("Expected identifier character after .", pos);
-        }
-
-        break;
-      }
-      case '[':
-      {
-        if (currentExpression->type != ExpressionNodeType::String &&
-            currentExpression->type != ExpressionNodeType::Identifier) {
-          throw WatchParseError("[ must follow an identifier or string", pos);
-        }
-
-        ++pos;
-        currentExpression->next = std::make_unique<ExpressionNode>();
-        currentExpression = currentExpression->next.get();
-        currentExpression->type = ExpressionNodeType::Identifier;
-
-        currentExpression->accessorExpression = ParseExpression(pos, end);
-        if (currentExpression->accessorExpression->type == ExpressionNodeType::Undefined) {
-          throw WatchParseError("Could not create accessor expression", pos);
-        }
-
-        // The call to ReadExpression will also consume the ] so we don't need to increment it.
-        break;
-      }
-      case ']':
-      {
-        if (currentExpression->type == ExpressionNodeType::Undefined) {
-          throw WatchParseError("Closing square bracket without a contained expression", pos);
-        }
-
-        ++pos;
-        return rootExpression;
-      }
-      case '"':
-      case '\'':
-      {
-        if (currentExpression->type != ExpressionNodeType::Undefined) {
-          throw WatchParseError("String must not follow another expression", pos);
-        }
-
-        currentExpression->accessorValue = ReadString(pos, end);
-        currentExpression->type = ExpressionNodeType::String;
-
-        // ReadString will increment `pos` past the end of the expression
-        // so we don't need to increment it.
-        break;
-      }
-      default:
-        if (currentExpression->type != ExpressionNodeType::Undefined) {
-          throw WatchParseError("Identifier or number must not directly follow another expression", pos);
-        }
-
-        if (0 != isdigit(c)) {
-          // read a number
-          currentExpression->type = ExpressionNodeType::Number;
-          currentExpression->accessorValue = ReadNumber(pos, end);
-        }
-        else if (0 != isalpha(c) || c == '_') {
-          // read an identifier
-          currentExpression->type = ExpressionNodeType::Identifier;
-          currentExpression->accessorValue = ReadIdentifier(pos, end);
-        }
-        else {
-          throw WatchParseError("Invalid character, expected alphanumeric or underscore.", pos);
-        }
-
-        // ReadNumber and ReadIdentifier will increment `pos` past the end of the expression
-        // so we don't need to increment it.
-        break;
-    }
-  }
-
-  return rootExpression;
-}
 }// namespace sdb::sq
\ No newline at end of file
@@ -13,21 +13,18 @@
 #include <stdexcept>
 
 #include <string>
+#include <string_view>
 #include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace sdb::sq {
 
 using PathPartConstIter = std::vector<uint64_t>::const_iterator;
 
-enum class ExpressionNodeType { Undefined, String, Number, Identifier };
-
-struct ExpressionNode {
-  std::unique_ptr<ExpressionNode> next;
-  std::string accessorValue;
-  std::unique_ptr<ExpressionNode> accessorExpression;
-  ExpressionNodeType type = ExpressionNodeType::Undefined;
-};
-
 const char* ToSqObjectTypeName(SQObjectType sqType);
 data::VariableType ToVariableType(SQObjectType sqType);
 
@@ -36,19 +33,185 @@ std::string ToString(HSQUIRRELVM v, SQInteger idx);
 
 data::ReturnCode UpdateFromString(SQVM* const v, SQInteger objIdx, const std::string& value);
 
+// Pre-processed form of a data::VariableFilter.
+class ChildFilter {
+ public:
+  explicit ChildFilter(const data::VariableFilter& filter);
+
+  [[nodiscard]] bool IsEmpty() const;
+  // Equal for filters that match the same children.
+  [[nodiscard]] const std::string& GetCacheKey() const { return cacheKey_; }
+
+  // Expects 2 things to be on the stack. -1=value, -2=key. Leaves the stack unchanged.
+  [[nodiscard]] bool Matches(HSQUIRRELVM v) const;
+
+ private:
+  [[nodiscard]] bool MatchesKey(HSQUIRRELVM v) const;
+  [[nodiscard]] bool MatchesKeyPattern(std::string_view key) const;
+  [[nodiscard]] bool MatchesValue(HSQUIRRELVM v) const;
+
+  std::string keyPattern_;
+  bool keyPatternIsGlob_ = false;
+  // Bit per data::VariableType; 0 if any type is allowed.
+  uint32_t valueTypeMask_ = 0;
+  data::FilterOperator valueOperator_ = data::FilterOperator::None;
+  std::string value_;
+  bool valueIsNumber_ = false;
+  double valueNumber_ = 0.0;
+  std::string cacheKey_;
+};
+
+class SortedKeysCache;
+
+// State that is shared across all levels of a single (possibly recursive) variables request.
+struct VariableQueryContext {
+  VariableQueryContext(
+          const data::VariableQueryOptions& options, const data::PaginationInfo& pagination,
+          SortedKeysCache* sortedKeys)
+      : options(options)
+      , filter(options.filter)
+      , sortedKeys(sortedKeys)
+      , nestedPageSize(pagination.count)
+      , nodesRemaining(options.maxNodes)
+      , summaryBytesRemaining(options.summaryBudgetBytes)
+  {}
+
+  const data::VariableQueryOptions options;
+  // Only applied to the direct children of the requested path
+  const ChildFilter filter;
+  // Sorted keys of the tables listed during this pause, if they are cached.
+  SortedKeysCache* const sortedKeys;
+
+  // Maximum number of children listed for each expanded (non-root) variable
+  const uint32_t nestedPageSize;
+  uint32_t nodesRemaining;
+  uint32_t summaryBytesRemaining;
+
+  // valueRawAddress of every container that has been expanded by this request; used to detect cycles and shared refs.
+  std::unordered_set<uint64_t> expandedAddresses;
+
+  // Set if the direct children of the requested path didn't all fit in the page; the position that the next page
+  // starts at, in the same form as pagination.beginIterator.
+  std::optional<uint32_t> nextPosition;
+};
+
 data::ReturnCode CreateChildVariable(HSQUIRRELVM v, data::Variable& variable);
+// As above, but the value of tables and instances is summarized according to the query options and summary budget.
+data::ReturnCode CreateChildVariable(HSQUIRRELVM v, VariableQueryContext& context, data::Variable& variable);
 data::ReturnCode CreateChildVariablesFromIterable(
         HSQUIRRELVM v, PathPartConstIter pathBegin, PathPartConstIter pathEnd,
-        const data::PaginationInfo& pagination, std::vector<data::Variable>& variables);
+        const data::PaginationInfo& pagination, VariableQueryContext& context, std::vector<data::Variable>& variables);
+
+// Expects the value of variables[parentIndex] to be at the top of the stack. If the query context allows for it, appends
+// the children of that value to the end of `variables`.
+void ExpandChildVariable(
+        HSQUIRRELVM v, VariableQueryContext& context, uint32_t depth, size_t parentIndex,
+        std::vector<data::Variable>& variables);
+// Values read from an array that contains only integers and floats. If any float is found, all values are floats.
+struct NumericArrayValues {
+  bool isFloat = false;
+  std::vector<SQInteger> integers;
+  std::vector<SQFloat> floats;
+};
+
+// Expects an array at the top of the stack. Returns InvalidParameter if any value in the range is not numeric.
+data::ReturnCode ReadNumericArray(
+        HSQUIRRELVM v, const data::PaginationInfo& range, uint32_t& arraySize, NumericArrayValues& values);
+
 data::ReturnCode WithVariableAtPath(SQVM* v, PathPartConstIter pathBegin, PathPartConstIter pathEnd, const std::function<data::ReturnCode()>& fn);
 
-struct SqExpressionNode {
-  std::unique_ptr<SqExpressionNode> next;
-  HSQOBJECT accessorObject = {};
+// Objects of different types can share a raw value (eg. 1 and true), so both are needed to identify an object.
+struct ObjectId {
+  SQObjectType type = OT_NULL;
+  SQRawObjectVal raw = 0;
+
+  [[nodiscard]] bool operator==(const ObjectId& other) const { return type == other.type && raw == other.raw; }
+};
+struct ObjectIdHash {
+  [[nodiscard]] size_t operator()(const ObjectId& id) const
+  {
+    return std::hash<SQRawObjectVal>()(id.raw) ^ static_cast<size_t>(id.type);
+  }
+};
+
+// Maps the keys of tables and instances to the iterator that sq_next returns them at. Each container is indexed the
+// first time one of its keys is looked up, so repeated lookups are O(1) rather than a walk over every key.
+// Entries are only valid while the VM stays paused; Clear() must be called before it resumes. Lookups are verified
+// against the container, and a stale index is rebuilt.
+class KeyIteratorIndex {
+ public:
+  // Expects a table or instance at the top of the stack. On success, pushes the value of the given key.
+  [[nodiscard]] data::ReturnCode PushValue(HSQUIRRELVM v, const HSQOBJECT& key, uint32_t& iterator);
+
+  void Clear();
+
+ private:
+  // Pushes the value at the given iterator if its key matches, otherwise leaves the stack unchanged.
+  [[nodiscard]] static bool PushValueAtIterator(HSQUIRRELVM v, const ObjectId& key, uint32_t iterator);
+
+  // Key to iterator, per container.
+  std::unordered_map<ObjectId, std::unordered_map<ObjectId, uint32_t, ObjectIdHash>, ObjectIdHash> containers_;
+};
+
+// The keys of tables and instances that are small enough to list in order, sorted by their string form, with the
+// iterator that sq_next returns each at. Built the first time a container is listed with a given filter, so that later
+// pages don't read, stringify, filter and sort every key again. Entries are only valid while the VM stays paused and
+// nothing is edited (filters can match values); Clear() must be called before it resumes, and after an edit.
+class SortedKeysCache {
+ public:
+  using SortedKeys = std::vector<std::pair<std::string, SQInteger>>;
+
+  // Once this many keys are cached, everything is discarded before more are added.
+  static constexpr size_t kMaxKeyCount = 64U * 1024U;
+
+  // Expects a table or instance at the top of the stack. filter is null if every key is listed.
+  // Shared, as listing a page can list nested tables and so evict the keys it is iterating over.
+  [[nodiscard]] std::shared_ptr<const SortedKeys> GetKeys(HSQUIRRELVM v, const ChildFilter* filter);
+
+  void Clear();
+
+ private:
+  // Sorted keys per filter cache key, per container.
+  std::unordered_map<ObjectId, std::unordered_map<std::string, std::shared_ptr<const SortedKeys>>, ObjectIdHash>
+          containers_;
+  size_t keyCount_ = 0;
+};
+
+// The names and values of the locals in a single stack frame, as returned by sq_getlocal. Values are not referenced.
+// Not copyable, as indexByName refers to the names held in locals.
+struct StackLocals {
+  struct Local {
+    std::string name;
+    HSQOBJECT value = {};
+  };
+
+  StackLocals() = default;
+  ~StackLocals() = default;
+
+  // Deleted methods
+  StackLocals(const StackLocals& other) = delete;
+  StackLocals(const StackLocals&& other) = delete;
+  StackLocals& operator=(const StackLocals&) = delete;
+  StackLocals& operator=(StackLocals&&) = delete;
+
+  // Indexed by nSeq
+  std::vector<Local> locals;
+  // nSeq of the first local with each name, which is the one that is in scope.
+  std::unordered_map<std::string_view, uint32_t> indexByName;
+};
+
+// The locals of each stack frame, read from the VM the first time they are requested during a pause, so that listing
+// them and resolving names doesn't walk sq_getlocal each time. Entries are only valid while the VM stays paused;
+// Clear() must be called before it resumes.
+class StackLocalsCache {
+ public:
+  [[nodiscard]] const StackLocals& GetFrame(HSQUIRRELVM v, uint32_t stackFrame);
+
+  void Clear();
+
+ private:
+  std::unordered_map<uint32_t, StackLocals> frames_;
 };
-data::ReturnCode GetObjectFromExpression(
-        SQVM* v, const SqExpressionNode* expressionNode, const data::PaginationInfo& pagination, HSQOBJECT& foundObject,
-        std::vector<uint32_t>& iteratorPath);
 
 class ScopedVerifySqTop {
  public:
@@ -74,17 +237,6 @@ class ScopedVerifySqTop {
   SQInteger initialDepth_;
 };
 
-
-class WatchParseError : public std::runtime_error {
- public:
-  WatchParseError(const char* msg, const std::string::const_iterator pos)
-      : std::runtime_error(msg)
-      , pos(pos)
-  {}
-  const std::string::const_iterator pos;
-};
-std::unique_ptr<ExpressionNode> ParseExpression(std::string::const_iterator& pos, std::string::const_iterator end);
-
 }// namespace sdb::sq
 
 #endif// SDB_SQUIRREL_VM_HELPERS_H
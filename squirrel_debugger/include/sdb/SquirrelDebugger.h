@@ -45,13 +45,30 @@ class SquirrelDebugger final : public MessageCommandInterface {
   [[nodiscard]] data::ReturnCode StepOver() override;
   [[nodiscard]] data::ReturnCode StepIn() override;
   [[nodiscard]] data::ReturnCode SendStatus() override;
+  [[nodiscard]] data::ReturnCode GetStack(
+          const data::PaginationInfo& range, std::vector<data::StackEntry>& stack, uint32_t& stackDepth) override;
+  [[nodiscard]] data::ReturnCode GetPauseEpoch(uint32_t& pauseEpoch) override;
   [[nodiscard]] data::ReturnCode GetStackVariables(
           uint32_t stackFrame, const std::string& path, const data::PaginationInfo& pagination,
-          std::vector<data::Variable>& variables) override;
+          const data::VariableQueryOptions& options, std::vector<data::Variable>& variables,
+          uint64_t& nextCursor) override;
 
   [[nodiscard]] data::ReturnCode GetGlobalVariables(
-          const std::string& path, const data::PaginationInfo& pagination,
-          std::vector<data::Variable>& variables) override;
+          const std::string& path, const data::PaginationInfo& pagination, const data::VariableQueryOptions& options,
+          std::vector<data::Variable>& variables, uint64_t& nextCursor) override;
+
+  [[nodiscard]] data::ReturnCode GetStackVariable(
+          uint32_t stackFrame, const std::string& path, data::Variable& variable) override;
+
+  [[nodiscard]] data::ReturnCode GetGlobalVariable(const std::string& path, data::Variable& variable) override;
+
+  [[nodiscard]] data::ReturnCode GetArraySlice(
+          int32_t stackFrame, const std::string& path, const data::PaginationInfo& range,
+          data::ArraySlice& slice) override;
+
+  [[nodiscard]] data::ReturnCode GetArrayStatistics(
+          int32_t stackFrame, const std::string& path, const data::PaginationInfo& range, uint32_t histogramBinCount,
+          data::ArrayStatistics& statistics) override;
 
   [[nodiscard]] data::ReturnCode SetStackVariableValue(
           uint32_t stackFrame, const std::string& path, const std::string& newValueString, data::Variable& newValue) override;
@@ -64,6 +81,21 @@ class SquirrelDebugger final : public MessageCommandInterface {
           int32_t stackFrame, const std::string& watch, const data::PaginationInfo& pagination,
           data::ImmediateValue& variable) override;
 
+  [[nodiscard]] data::ReturnCode ExportVariable(
+          int32_t stackFrame, const std::string& watch, const data::ExportOptions& options,
+          const std::function<bool(std::string_view)>& writeFn, data::ExportResult& result) override;
+
+  [[nodiscard]] data::ReturnCode SetPauseBundleConfig(const data::PauseBundleConfig& config) override;
+
+  [[nodiscard]] data::ReturnCode AddWatch(const std::string& watch, uint64_t& watchId) override;
+
+  [[nodiscard]] data::ReturnCode RemoveWatch(uint64_t watchId) override;
+
+  [[nodiscard]] data::ReturnCode AddDataBreakpoint(
+          int32_t stackFrame, const std::string& watch, uint64_t& dataBreakpointId) override;
+
+  [[nodiscard]] data::ReturnCode RemoveDataBreakpoint(uint64_t dataBreakpointId) override;
+
   // The following methods should be called from the scripting engine (VM) thread in response to Squirrel Debug Hooks.
   void SquirrelNativeDebugHook(
           HSQUIRRELVM v, SQInteger type, const SQChar* sourceName, SQInteger line, const SQChar* functionName);
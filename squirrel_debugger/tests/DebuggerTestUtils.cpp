@@ -20,6 +20,7 @@ class MessageEventInterfaceImpl : public sdb::MessageEventInterface {
   void ResetWaitForStatus()
   {
     receivedStatus_ = false;
+    receivedPauseBundle_ = false;
   }
   // Returns true if status was found without timeout being reached
   bool WaitForStatus(RunState runState)
@@ -46,12 +47,35 @@ class MessageEventInterfaceImpl : public sdb::MessageEventInterface {
     statusCv_.notify_all();
   }
   void HandleOutputLine(const sdb::data::OutputLine& outputLine) {}
+  void HandlePauseBundle(const sdb::data::PauseBundle& pauseBundle)
+  {
+    std::unique_lock<std::mutex> lock(statusMutex_);
+    receivedPauseBundle_ = true;
+    lastPauseBundle_ = pauseBundle;
+    statusCv_.notify_all();
+  }
+  // The pause bundle is sent after the status event, so wait for it to arrive.
+  bool GetLastPauseBundle(sdb::data::PauseBundle& pauseBundle)
+  {
+    std::unique_lock<std::mutex> lock(statusMutex_);
+    while (!receivedPauseBundle_) {
+      auto cvStatus = statusCv_.wait_for(lock, std::chrono::seconds(1));
+      if (cvStatus == std::cv_status::timeout) {
+        GTEST_NONFATAL_FAILURE_("Reached timeout before pause bundle was received.");
+        return false;
+      }
+    }
+    pauseBundle = lastPauseBundle_;
+    return true;
+  }
 
  private:
   std::mutex statusMutex_;
   std::condition_variable statusCv_;
   sdb::data::Status lastStatus_;
+  sdb::data::PauseBundle lastPauseBundle_;
   bool receivedStatus_ = false;
+  bool receivedPauseBundle_ = false;
 };
 
 SQInteger SquirrelFileLexFeedAscii(SQUserPointer file);
@@ -189,6 +213,10 @@ void SquirrelDebuggerTest::GetLastStatus(sdb::data::Status& status)
 {
   eventInterface_->GetLastStatus(status);
 }
+bool SquirrelDebuggerTest::GetLastPauseBundle(sdb::data::PauseBundle& pauseBundle)
+{
+  return eventInterface_->GetLastPauseBundle(pauseBundle);
+}
 
 SQInteger SquirrelFileLexFeedAscii(SQUserPointer file)
 {
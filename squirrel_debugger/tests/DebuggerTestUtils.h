@@ -24,6 +24,7 @@ class SquirrelDebuggerTest : public testing::Test
  public:
 
   static constexpr const sdb::data::PaginationInfo kPagination {0,100};
+  inline static const sdb::data::VariableQueryOptions kQueryOptions {};
 
   static SquirrelDebuggerTest& Instance() { return *gInstance; }
 
@@ -51,6 +52,8 @@ class SquirrelDebuggerTest : public testing::Test
 
   void GetLastStatus(sdb::data::Status& status);
 
+  bool GetLastPauseBundle(sdb::data::PauseBundle& pauseBundle);
+
  private:
 
   std::unique_ptr<SquirrelDebugger> debugger_;
@@ -33,12 +33,12 @@ local class Vector3 extends BaseVector {
         ::print($"{x}, {y}, {z}\n")
     }
 }
-
+local intArr = [5, 6, 7]
 local v0 = Vector3(1,2,3)
 local v1 = Vector3(11,12,13)
 local v2 = v0 + v1
 v2.Print()
-
+local numberArr = [1, 2.5, -3, 4]
 ::FakeNamespace <- {
     Utils = {}
 }
@@ -66,4 +66,21 @@ local mytable = {
     e="longstring",
     f=9
 }
-local testy = FakeNamespace.Utils.SuperClass("asdf", 123, lambdaExp, ["I'm a string", [1,2,3,4,5,6,7,8]], mytable, BaseVector)
\ No newline at end of file
+local testy = FakeNamespace.Utils.SuperClass("asdf", 123, lambdaExp, ["I'm a string", [1,2,3,4,5,6,7,8]], mytable, BaseVector)
+intArr[1] = 60
+::print("intArr changed\n")
+local shared = [1]
+local graph = {a=shared, b=shared}
+graph.self <- graph
+::print("graph built\n")
+function Recurse(depth)
+{
+    if (depth > 0) {
+        local result = Recurse(depth - 1)
+        return result
+    }
+    return depth
+}
+Recurse(40)
+local mixedKeys = {[1]=10, [true]=20, [0]=30, [false]=40}
+::print("mixed keys\n")
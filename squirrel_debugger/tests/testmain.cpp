@@ -3,6 +3,7 @@
 #include <sdb/SquirrelDebugger.h>
 
 #include <array>
+#include <cstring>
 #include <thread>
 
 using sdb::SquirrelDebugger;
@@ -45,7 +46,10 @@ TEST_F(SquirrelDebuggerVariablesTest, GetLocalVariableTest)
 
   // Check local variable
   std::vector<sdb::data::Variable> variables;
-  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, variables));
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
 
   auto pos = std::find_if(variables.begin(), variables.end(), [](const sdb::data::Variable& var) {
     return var.pathUiString == "strExp";
@@ -60,7 +64,10 @@ TEST_F(SquirrelDebuggerVariablesTest, SetStackStringVariableTest)
 
   // Check root local variable
   std::vector<sdb::data::Variable> variables;
-  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, variables));
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
 
   //////////
   // Local string variable
@@ -89,7 +96,10 @@ TEST_F(SquirrelDebuggerVariablesTest, SetStackInstanceVariableTest)
 
   // Check root local variable
   std::vector<sdb::data::Variable> variables;
-  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, variables));
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
 
   //////////
   // Local class instance variable
@@ -100,7 +110,9 @@ TEST_F(SquirrelDebuggerVariablesTest, SetStackInstanceVariableTest)
 
   std::vector<sdb::data::Variable> v0variables;
   std::string v0path = std::to_string(v0Pos->pathIterator);
-  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, v0path, kPagination, v0variables));
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, v0path, kPagination, kQueryOptions, v0variables, nextCursor));
   ASSERT_EQ(v0Pos->childCount, 5);
   ASSERT_EQ(v0variables.size(), 5);
   // Will be sorted: Class methods/fields sorted a-z, then Parent class methods/fields sorted a-z
@@ -134,4 +146,668 @@ TEST_F(SquirrelDebuggerVariablesTest, SetStackInstanceVariableTest)
     ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().SetStackVariableValue(0, v0path, newValueString, newValueOut));
   }
 }
+
+TEST_F(SquirrelDebuggerVariablesTest, GetExpandedStackVariablesTest)
+{
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  sdb::data::VariableQueryOptions options;
+  options.expandDepth = 1;
+  std::vector<sdb::data::Variable> variables;
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, options, variables, nextCursor));
+
+  auto v0Pos = std::find_if(variables.begin(), variables.end(), [](const sdb::data::Variable& var) {
+    return var.pathUiString == "v0" && var.parentIndex == -1;
+  });
+  ASSERT_NE(v0Pos, variables.end());
+
+  // Children of v0 directly follow it in the flattened list.
+  const auto v0Index = static_cast<int32_t>(v0Pos - variables.begin());
+  const auto v0ChildCount = std::count_if(variables.begin(), variables.end(), [v0Index](const auto& var) {
+    return var.parentIndex == v0Index;
+  });
+  ASSERT_EQ(v0ChildCount, v0Pos->childCount);
+  ASSERT_EQ(variables[v0Index + 1].parentIndex, v0Index);
+
+  // Nothing is expanded past the requested depth.
+  for (const auto& var : variables) {
+    if (var.parentIndex >= 0) {
+      ASSERT_EQ(variables[var.parentIndex].parentIndex, -1);
+    }
+  }
+
+  // The total number of returned variables is capped by maxNodes
+  options.maxNodes = 3;
+  variables.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, options, variables, nextCursor));
+  ASSERT_EQ(variables.size(), 3);
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, PauseBundleTest)
+{
+  sdb::data::PauseBundleConfig config;
+  config.enabled = true;
+  config.globalsCount = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().SetPauseBundleConfig(config));
+
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  sdb::data::PauseBundle pauseBundle;
+  ASSERT_TRUE(GetLastPauseBundle(pauseBundle));
+  ASSERT_TRUE(pauseBundle.globals.empty());
+
+  auto strExpPos = std::find_if(pauseBundle.locals.begin(), pauseBundle.locals.end(), [](const sdb::data::Variable& var) {
+    return var.pathUiString == "strExp";
+  });
+  ASSERT_NE(strExpPos, pauseBundle.locals.end());
+  ASSERT_EQ(strExpPos->value, kStrExpValue);
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, RegisteredWatchesTest)
+{
+  uint64_t strExpWatchId = 0;
+  uint64_t v0XWatchId = 0;
+  uint64_t missingWatchId = 0;
+  uint64_t invalidWatchId = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().AddWatch("strExp", strExpWatchId));
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().AddWatch("v0.x", v0XWatchId));
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().AddWatch("doesNotExist", missingWatchId));
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().AddWatch("v0[", invalidWatchId));
+  ASSERT_NE(strExpWatchId, v0XWatchId);
+
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  sdb::data::Status status;
+  GetLastStatus(status);
+  ASSERT_EQ(status.watches.size(), 3);
+  ASSERT_EQ(status.watches[0].id, strExpWatchId);
+  ASSERT_EQ(status.watches[0].code, ReturnCode::Success);
+  ASSERT_EQ(status.watches[0].value.variable.value, kStrExpValue);
+  ASSERT_EQ(status.watches[1].id, v0XWatchId);
+  ASSERT_EQ(status.watches[1].code, ReturnCode::Success);
+  ASSERT_EQ(status.watches[1].value.variable.value, kv0XValue);
+  ASSERT_EQ(status.watches[2].id, missingWatchId);
+  ASSERT_NE(status.watches[2].code, ReturnCode::Success);
+
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().RemoveWatch(v0XWatchId));
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().RemoveWatch(v0XWatchId));
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, ImmediateValueTest)
+{
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  sdb::data::ImmediateValue value;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, "v0.x", kPagination, value));
+  ASSERT_EQ(value.variable.value, kv0XValue);
+  ASSERT_EQ(value.scope, sdb::data::VariableScope::Local);
+  ASSERT_EQ(value.iteratorPath.size(), 2);
+
+  // The second lookup of the same key is served from the key index, and must resolve to the same iterator.
+  sdb::data::ImmediateValue secondValue;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, "v0['x']", kPagination, secondValue));
+  ASSERT_EQ(secondValue.variable.value, kv0XValue);
+  ASSERT_EQ(secondValue.iteratorPath, value.iteratorPath);
+
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, "intArr[1]", kPagination, value));
+  ASSERT_EQ(value.variable.value, "6");
+
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().GetImmediateValue(0, "v0.doesNotExist", kPagination, value));
+
+  // Computed expressions have no iterator path
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, "v0.x * 2 + intArr[2]", kPagination, value));
+  ASSERT_EQ(value.variable.value, "9");
+  ASSERT_EQ(value.scope, sdb::data::VariableScope::Evaluation);
+  ASSERT_TRUE(value.iteratorPath.empty());
+
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, "len(strExp) == 11 && !false", kPagination, value));
+  ASSERT_EQ(value.variable.value, "true");
+
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().GetImmediateValue(0, "intArr[0] +", kPagination, value));
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, MixedTypeKeysTest)
+{
+  // After a table whose keys share raw values across types (1 and true, 0 and false), at the end of the test file
+  constexpr int kMixedKeysLine = 86;
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kMixedKeysLine});
+
+  // Each key is looked up twice, so that the second lookup is served from the key index
+  const std::pair<const char*, const char*> kExpected[] = {
+          {"mixedKeys[1]", "10"}, {"mixedKeys[true]", "20"}, {"mixedKeys[0]", "30"}, {"mixedKeys[false]", "40"}};
+  for (int pass = 0; pass < 2; ++pass) {
+    for (const auto& [expression, expectedValue] : kExpected) {
+      sdb::data::ImmediateValue value;
+      ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, expression, kPagination, value));
+      ASSERT_EQ(value.variable.value, expectedValue) << expression;
+    }
+  }
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, LocalsLookupTest)
+{
+  RunAndPauseTestFile(kTestFileName);
+
+  std::vector<sdb::data::Variable> variables;
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
+  ASSERT_FALSE(variables.empty());
+
+  // Names resolve to the same local that is listed
+  for (const auto& variable : variables) {
+    sdb::data::ImmediateValue value;
+    ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, variable.pathUiString, kPagination, value));
+    ASSERT_EQ(value.scope, sdb::data::VariableScope::Local);
+    ASSERT_EQ(value.iteratorPath.size(), 1);
+    ASSERT_EQ(value.iteratorPath[0], variable.pathIterator);
+  }
+
+  // Paging past the last local is empty, rather than an error
+  std::vector<sdb::data::Variable> pastEnd;
+  const sdb::data::PaginationInfo pastEndPagination = {static_cast<uint32_t>(variables.size()), 10};
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", pastEndPagination, kQueryOptions, pastEnd, nextCursor));
+  ASSERT_TRUE(pastEnd.empty());
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, PaginationCursorTest)
+{
+  RunAndPauseTestFile(kTestFileName);
+
+  std::vector<sdb::data::Variable> allGlobals;
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetGlobalVariables("", kPagination, kQueryOptions, allGlobals, nextCursor));
+  ASSERT_EQ(nextCursor, 0);
+  ASSERT_GT(allGlobals.size(), 2);
+
+  // Walking the root table a page at a time returns the same children, in the same order.
+  std::vector<sdb::data::Variable> pagedGlobals;
+  sdb::data::PaginationInfo pagination = {0, 2};
+  do {
+    std::vector<sdb::data::Variable> page;
+    ASSERT_EQ(ReturnCode::Success, GetDebugger().GetGlobalVariables("", pagination, kQueryOptions, page, nextCursor));
+    ASSERT_LE(page.size(), 2);
+    pagedGlobals.insert(pagedGlobals.end(), page.begin(), page.end());
+    pagination.cursor = nextCursor;
+  } while (nextCursor != 0);
+
+  ASSERT_EQ(pagedGlobals.size(), allGlobals.size());
+  for (size_t i = 0; i < allGlobals.size(); ++i) {
+    ASSERT_EQ(pagedGlobals[i].pathUiString, allGlobals[i].pathUiString);
+    ASSERT_EQ(pagedGlobals[i].pathIterator, allGlobals[i].pathIterator);
+  }
+
+  // Cursors expire once the program resumes
+  std::vector<sdb::data::Variable> page;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetGlobalVariables("", {0, 1}, kQueryOptions, page, nextCursor));
+  ASSERT_NE(nextCursor, 0);
+  pagination.cursor = nextCursor;
+
+  ResetWaitForStatus();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().StepOver());
+  WaitForStatus(RunState::Paused);
+
+  ASSERT_EQ(
+          ReturnCode::InvalidParameter,
+          GetDebugger().GetGlobalVariables("", pagination, kQueryOptions, page, nextCursor));
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, DataBreakpointTest)
+{
+  // Line after intArr[1] is assigned to, near the end of the test file
+  constexpr uint32_t kLineAfterChange = 71;
+  RunAndPauseTestFile(kTestFileName);
+
+  uint64_t unchangedId = 0;
+  uint64_t changedId = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().AddDataBreakpoint(0, "v0.x", unchangedId));
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().AddDataBreakpoint(0, "intArr[1]", changedId));
+  ASSERT_NE(unchangedId, changedId);
+
+  // Must be a member of a container
+  uint64_t invalidId = 0;
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().AddDataBreakpoint(0, "strExp", invalidId));
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().AddDataBreakpoint(0, "intArr[1] + 1", invalidId));
+
+  ResetWaitForStatus();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ContinueExecution());
+  WaitForStatus(RunState::Paused);
+
+  sdb::data::Status status;
+  GetLastStatus(status);
+  ASSERT_EQ(status.pausedAtDataBreakpointId, changedId);
+  ASSERT_EQ(status.pausedAtBreakpointId, 0);
+  ASSERT_FALSE(status.stack.empty());
+  ASSERT_EQ(status.stack[0].line, kLineAfterChange);
+
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().RemoveDataBreakpoint(changedId));
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().RemoveDataBreakpoint(changedId));
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, DataBreakpointNewSlotTest)
+{
+  // graph.self is added by this line
+  constexpr int kAddSlotLine = 74;
+  constexpr uint32_t kLineAfterAddSlot = 75;
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kAddSlotLine});
+
+  // Slots that don't exist yet can be watched. No script refers to notYetAdded, so the breakpoint holds the only
+  // reference to its key.
+  uint64_t addedId = 0;
+  uint64_t notAddedId = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().AddDataBreakpoint(0, "graph.self", addedId));
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().AddDataBreakpoint(0, "graph.notYetAdded", notAddedId));
+
+  ResetWaitForStatus();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ContinueExecution());
+  WaitForStatus(RunState::Paused);
+
+  sdb::data::Status status;
+  GetLastStatus(status);
+  ASSERT_EQ(status.pausedAtDataBreakpointId, addedId);
+  ASSERT_FALSE(status.stack.empty());
+  ASSERT_EQ(status.stack[0].line, kLineAfterAddSlot);
+
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().RemoveDataBreakpoint(notAddedId));
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().RemoveDataBreakpoint(addedId));
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, ExportVariableTest)
+{
+  // Line after the graph of shared references is built, at the end of the test file
+  constexpr int kGraphBuiltLine = 75;
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kGraphBuiltLine});
+
+  std::string json;
+  const auto appendFn = [&json](const std::string_view chunk) {
+    json.append(chunk);
+    return true;
+  };
+
+  sdb::data::ExportResult result;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ExportVariable(0, "mytable", {}, appendFn, result));
+  ASSERT_NE(json.find(R"("c":[9,8,7,6,5,4,3,2,1])"), std::string::npos);
+  ASSERT_NE(json.find(R"("d":"cat")"), std::string::npos);
+  ASSERT_NE(json.find(R"("string expr":["one","two","three"])"), std::string::npos);
+  ASSERT_EQ(result.byteCount, json.size());
+  ASSERT_EQ(result.sharedReferenceCount, 0);
+  ASSERT_FALSE(result.truncated);
+
+  // The array is shared by two keys, and the table contains itself
+  json.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ExportVariable(0, "graph", {}, appendFn, result));
+  ASSERT_NE(json.find(R"("self":{"$ref":""})"), std::string::npos);
+  ASSERT_TRUE(
+          json.find(R"("b":{"$ref":"/a"})") != std::string::npos ||
+          json.find(R"("a":{"$ref":"/b"})") != std::string::npos);
+  ASSERT_EQ(result.sharedReferenceCount, 2);
+  ASSERT_FALSE(result.truncated);
+
+  json.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ExportVariable(0, "v0", {}, appendFn, result));
+  ASSERT_NE(json.find(R"("$class":"Vector3")"), std::string::npos);
+  ASSERT_NE(json.find(R"("x":1)"), std::string::npos);
+  ASSERT_EQ(json.find("Print"), std::string::npos);
+
+  // Limits
+  sdb::data::ExportOptions options;
+  options.maxDepth = 0;
+  json.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ExportVariable(0, "mytable", options, appendFn, result));
+  ASSERT_NE(json.find(R"("c":{"$truncated":true})"), std::string::npos);
+  ASSERT_TRUE(result.truncated);
+
+  options = {};
+  options.maxNodes = 3;
+  json.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ExportVariable(0, "mytable", options, appendFn, result));
+  ASSERT_EQ(result.nodeCount, 3);
+  ASSERT_TRUE(result.truncated);
+
+  // Failing to write abandons the export
+  const auto failFn = [](const std::string_view) { return false; };
+  ASSERT_EQ(ReturnCode::ErrorInternal, GetDebugger().ExportVariable(0, "mytable", {}, failFn, result));
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().ExportVariable(0, "doesNotExist", {}, appendFn, result));
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, ConditionalBreakpointTest)
+{
+  RunAndPauseTestFile(kTestFileName);
+
+  // The first breakpoint's condition is never met, and the third doesn't compile.
+  const uint64_t skippedBpId = kBpId + 1;
+  const uint64_t invalidBpId = kBpId + 2;
+  std::vector<sdb::data::CreateBreakpoint> createBps;
+  createBps.push_back({skippedBpId, kBpLineNumber - 1, "intArr[0] == 6"});
+  createBps.push_back({kBpId, kBpLineNumber, "len(intArr) == 3 && v0.x + 1 > 1.5"});
+  createBps.push_back({invalidBpId, kBpLineNumber + 1, "intArr["});
+  std::vector<sdb::data::ResolvedBreakpoint> resolvedBps;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().SetFileBreakpoints(kTestFileName, createBps, resolvedBps));
+  ASSERT_EQ(resolvedBps.size(), 3);
+  ASSERT_TRUE(resolvedBps.at(0).verified);
+  ASSERT_TRUE(resolvedBps.at(1).verified);
+  ASSERT_FALSE(resolvedBps.at(2).verified);
+
+  ResetWaitForStatus();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ContinueExecution());
+  WaitForStatus(RunState::Paused);
+
+  sdb::data::Status status;
+  GetLastStatus(status);
+  ASSERT_EQ(status.pausedAtBreakpointId, kBpId);
+  ASSERT_FALSE(status.stack.empty());
+  ASSERT_EQ(status.stack[0].line, kBpLineNumber);
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, RecursiveConditionTest)
+{
+  // The first line of Recurse, whose condition is evaluated in each call until it is met
+  constexpr int kRecurseFirstLine = 78;
+  RunAndPauseTestFile(kTestFileName);
+
+  std::vector<sdb::data::CreateBreakpoint> createBps;
+  createBps.push_back({kBpId, kRecurseFirstLine, "depth == 3"});
+  std::vector<sdb::data::ResolvedBreakpoint> resolvedBps;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().SetFileBreakpoints(kTestFileName, createBps, resolvedBps));
+  ASSERT_EQ(resolvedBps.size(), 1);
+  ASSERT_TRUE(resolvedBps.at(0).verified);
+
+  ResetWaitForStatus();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().ContinueExecution());
+  WaitForStatus(RunState::Paused);
+
+  sdb::data::Status status;
+  GetLastStatus(status);
+  ASSERT_EQ(status.pausedAtBreakpointId, kBpId);
+  ASSERT_FALSE(status.stack.empty());
+  ASSERT_EQ(status.stack[0].line, kRecurseFirstLine);
+
+  sdb::data::ImmediateValue value;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetImmediateValue(0, "depth", kPagination, value));
+  ASSERT_EQ(value.variable.value, "3");
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, LazyTableSummaryTest)
+{
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  std::vector<sdb::data::Variable> variables;
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
+  auto v0Pos = std::find_if(variables.begin(), variables.end(), [](const sdb::data::Variable& var) {
+    return var.pathUiString == "v0";
+  });
+  ASSERT_NE(v0Pos, variables.end());
+  ASSERT_FALSE(v0Pos->value.empty());
+  const auto v0Summary = v0Pos->value;
+  const auto v0Path = std::to_string(v0Pos->pathIterator);
+
+  // Summaries are skipped entirely when not requested
+  sdb::data::VariableQueryOptions options;
+  options.summaryMode = sdb::data::SummaryMode::None;
+  variables.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, options, variables, nextCursor));
+  v0Pos = std::find_if(variables.begin(), variables.end(), [](const sdb::data::Variable& var) {
+    return var.pathUiString == "v0";
+  });
+  ASSERT_NE(v0Pos, variables.end());
+  ASSERT_TRUE(v0Pos->value.empty());
+  ASSERT_EQ(v0Pos->childCount, 5);
+
+  // ... and can then be fetched individually
+  sdb::data::Variable v0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariable(0, v0Path, v0));
+  ASSERT_EQ(v0.value, v0Summary);
+  ASSERT_EQ(v0.childCount, 5);
+
+  // A zero budget also skips summaries
+  options.summaryMode = sdb::data::SummaryMode::FirstFields;
+  options.summaryBudgetBytes = 0;
+  variables.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, options, variables, nextCursor));
+  v0Pos = std::find_if(variables.begin(), variables.end(), [](const sdb::data::Variable& var) {
+    return var.pathUiString == "v0";
+  });
+  ASSERT_NE(v0Pos, variables.end());
+  ASSERT_TRUE(v0Pos->value.empty());
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, ArraySliceTest)
+{
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  std::vector<sdb::data::Variable> variables;
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
+  const auto findLocalPath = [&variables](const char* name) {
+    const auto pos = std::find_if(variables.begin(), variables.end(), [name](const sdb::data::Variable& var) {
+      return var.pathUiString == name;
+    });
+    return pos == variables.end() ? std::string() : std::to_string(pos->pathIterator);
+  };
+
+  // Integer only array
+  {
+    const auto intArrPath = findLocalPath("intArr");
+    ASSERT_FALSE(intArrPath.empty());
+    sdb::data::ArraySlice slice;
+    ASSERT_EQ(ReturnCode::Success, GetDebugger().GetArraySlice(0, intArrPath, {0, 100}, slice));
+    ASSERT_EQ(slice.elementType, sdb::data::VariableType::Integer);
+    ASSERT_EQ(slice.elementSize, sizeof(SQInteger));
+    ASSERT_EQ(slice.arraySize, 3);
+    ASSERT_EQ(slice.data.size(), 3 * sizeof(SQInteger));
+    std::array<SQInteger, 3> values = {};
+    std::memcpy(values.data(), slice.data.data(), slice.data.size());
+    ASSERT_EQ(values[0], 5);
+    ASSERT_EQ(values[2], 7);
+  }
+
+  // Mixed integers and floats are returned as floats
+  {
+    const auto numberArrPath = findLocalPath("numberArr");
+    ASSERT_FALSE(numberArrPath.empty());
+    sdb::data::ArraySlice slice;
+    ASSERT_EQ(ReturnCode::Success, GetDebugger().GetArraySlice(0, numberArrPath, {1, 2}, slice));
+    ASSERT_EQ(slice.elementType, sdb::data::VariableType::Float);
+    ASSERT_EQ(slice.elementSize, sizeof(SQFloat));
+    ASSERT_EQ(slice.beginIndex, 1);
+    ASSERT_EQ(slice.arraySize, 4);
+    ASSERT_EQ(slice.data.size(), 2 * sizeof(SQFloat));
+    std::array<SQFloat, 2> values = {};
+    std::memcpy(values.data(), slice.data.data(), slice.data.size());
+    ASSERT_FLOAT_EQ(values[0], 2.5F);
+    ASSERT_FLOAT_EQ(values[1], -3.0F);
+  }
+
+  // Not an array
+  {
+    sdb::data::ArraySlice slice;
+    ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().GetArraySlice(0, findLocalPath("strExp"), {0, 100}, slice));
+  }
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, ArrayStatisticsTest)
+{
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  std::vector<sdb::data::Variable> variables;
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
+  const auto numberArrPos = std::find_if(variables.begin(), variables.end(), [](const sdb::data::Variable& var) {
+    return var.pathUiString == "numberArr";
+  });
+  ASSERT_NE(numberArrPos, variables.end());
+  const auto numberArrPath = std::to_string(numberArrPos->pathIterator);
+
+  // numberArr = [1, 2.5, -3, 4]
+  sdb::data::ArrayStatistics statistics;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetArrayStatistics(0, numberArrPath, {0, 100}, 2, statistics));
+  ASSERT_EQ(statistics.arraySize, 4);
+  ASSERT_EQ(statistics.count, 4);
+  ASSERT_EQ(statistics.nanCount, 0);
+  ASSERT_DOUBLE_EQ(statistics.min, -3.0);
+  ASSERT_DOUBLE_EQ(statistics.max, 4.0);
+  ASSERT_DOUBLE_EQ(statistics.mean, 1.125);
+  ASSERT_EQ(statistics.histogram.size(), 2);
+  ASSERT_EQ(statistics.histogram[0], 1);
+  ASSERT_EQ(statistics.histogram[1], 3);
+
+  // Range is respected
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetArrayStatistics(0, numberArrPath, {1, 2}, 0, statistics));
+  ASSERT_EQ(statistics.count, 2);
+  ASSERT_DOUBLE_EQ(statistics.min, -3.0);
+  ASSERT_DOUBLE_EQ(statistics.max, 2.5);
+  ASSERT_TRUE(statistics.histogram.empty());
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, FilterVariablesTest)
+{
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kBpLineNumber});
+
+  std::vector<sdb::data::Variable> variables;
+  uint64_t nextCursor = 0;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, "", kPagination, kQueryOptions, variables, nextCursor));
+  const auto v0Pos = std::find_if(variables.begin(), variables.end(), [](const sdb::data::Variable& var) {
+    return var.pathUiString == "v0";
+  });
+  ASSERT_NE(v0Pos, variables.end());
+  const auto v0Path = std::to_string(v0Pos->pathIterator);
+
+  // Unfiltered: Print, constructor, x, y, z
+  std::vector<sdb::data::Variable> v0Variables;
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, v0Path, kPagination, kQueryOptions, v0Variables, nextCursor));
+  ASSERT_EQ(v0Variables.size(), 5);
+
+  // Glob on key
+  sdb::data::VariableQueryOptions options;
+  options.filter.keyPattern = "?";
+  variables.clear();
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, v0Path, kPagination, options, variables, nextCursor));
+  ASSERT_EQ(variables.size(), 3);
+  ASSERT_EQ(variables[0].pathUiString, "x");
+  ASSERT_EQ(variables[0].pathIterator, v0Variables[2].pathIterator);
+
+  // Substring on key, case insensitive
+  options.filter.keyPattern = "STRUCT";
+  variables.clear();
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, v0Path, kPagination, options, variables, nextCursor));
+  ASSERT_EQ(variables.size(), 1);
+  ASSERT_EQ(variables[0].pathUiString, "constructor");
+
+  // Value type and predicate; v0 = Vector3(1,2,3)
+  options.filter.keyPattern.clear();
+  options.filter.valueTypes = {sdb::data::VariableType::Integer};
+  options.filter.valueOperator = sdb::data::FilterOperator::Greater;
+  options.filter.value = "1";
+  variables.clear();
+  ASSERT_EQ(
+          ReturnCode::Success,
+          GetDebugger().GetStackVariables(0, v0Path, kPagination, options, variables, nextCursor));
+  ASSERT_EQ(variables.size(), 2);
+  ASSERT_EQ(variables[0].pathUiString, "y");
+  ASSERT_EQ(variables[1].pathUiString, "z");
+
+  // Locals are filtered by name and value too
+  options.filter = {};
+  options.filter.keyPattern = "v?";
+  variables.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, options, variables, nextCursor));
+  std::vector<std::string> names;
+  for (const auto& variable : variables) {
+    names.push_back(variable.pathUiString);
+    if (variable.pathUiString == "v0") {
+      ASSERT_EQ(std::to_string(variable.pathIterator), v0Path);
+    }
+  }
+  std::sort(names.begin(), names.end());
+  ASSERT_EQ(names, std::vector<std::string>({"v0", "v1", "v2"}));
+
+  options.filter = {};
+  options.filter.valueTypes = {sdb::data::VariableType::String};
+  variables.clear();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStackVariables(0, "", kPagination, options, variables, nextCursor));
+  ASSERT_EQ(variables.size(), 1);
+  ASSERT_EQ(variables[0].pathUiString, "strExp");
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, PauseEpochTest)
+{
+  RunAndPauseTestFile(kTestFileName);
+
+  uint32_t pauseEpoch = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetPauseEpoch(pauseEpoch));
+  ASSERT_NE(pauseEpoch, 0);
+
+  // Stays the same for as long as the program is paused
+  uint32_t samePauseEpoch = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetPauseEpoch(samePauseEpoch));
+  ASSERT_EQ(samePauseEpoch, pauseEpoch);
+
+  ResetWaitForStatus();
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().StepOver());
+  WaitForStatus(RunState::Paused);
+
+  uint32_t nextPauseEpoch = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetPauseEpoch(nextPauseEpoch));
+  ASSERT_NE(nextPauseEpoch, pauseEpoch);
+}
+
+TEST_F(SquirrelDebuggerVariablesTest, DeepStackTest)
+{
+  // Inside Recurse(40), at the innermost call
+  static constexpr int kRecurseBottomLine = 82;
+  static constexpr int kRecurseCallLine = 84;
+  static constexpr uint32_t kRecurseFrameCount = 41;
+  RunAndPauseTestFileAtLine(kTestFileName, {kBpId, kRecurseBottomLine});
+
+  // The status only holds the top of the stack
+  sdb::data::Status status;
+  GetLastStatus(status);
+  ASSERT_EQ(status.pausedAtBreakpointId, kBpId);
+  ASSERT_GT(status.stackDepth, kRecurseFrameCount);
+  ASSERT_EQ(status.stack.size(), sdb::data::Status::kMaxStackFrames);
+  ASSERT_EQ(status.stack[0].line, kRecurseBottomLine);
+
+  std::vector<sdb::data::StackEntry> stack;
+  uint32_t stackDepth = 0;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStack({0, UINT32_MAX}, stack, stackDepth));
+  ASSERT_EQ(stackDepth, status.stackDepth);
+  ASSERT_EQ(stack.size(), stackDepth);
+  for (size_t i = 0; i < status.stack.size(); ++i) {
+    ASSERT_EQ(stack[i].line, status.stack[i].line);
+    ASSERT_EQ(stack[i].function, status.stack[i].function);
+  }
+  ASSERT_EQ(stack[kRecurseFrameCount].line, kRecurseCallLine);
+
+  // Ranges
+  std::vector<sdb::data::StackEntry> page;
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStack({sdb::data::Status::kMaxStackFrames, 5}, page, stackDepth));
+  ASSERT_EQ(page.size(), 5);
+  ASSERT_EQ(page[0].line, stack[sdb::data::Status::kMaxStackFrames].line);
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStack({stackDepth - 1, 100}, page, stackDepth));
+  ASSERT_EQ(page.size(), 1);
+  ASSERT_EQ(ReturnCode::Success, GetDebugger().GetStack({stackDepth, 100}, page, stackDepth));
+  ASSERT_TRUE(page.empty());
+  ASSERT_EQ(ReturnCode::InvalidParameter, GetDebugger().GetStack({stackDepth + 1, 100}, page, stackDepth));
+}
 }// namespace sdb::tests
\ No newline at end of file